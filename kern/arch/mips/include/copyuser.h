@@ -0,0 +1,27 @@
+#ifndef _MIPS_COPYUSER_H_
+#define _MIPS_COPYUSER_H_
+
+/*
+ * Fault-safe copy primitives used by copyin/copyout (copyuser-mips1.S).
+ *
+ * copyuser returns 0, or -1 if it faulted.
+ * copyuserstr returns the string length including the NUL, 0 if no
+ * NUL was found within len bytes, or -1 if it faulted.
+ */
+int copyuser(void *dst, const void *src, size_t len);
+int copyuserstr(char *dst, const char *src, size_t len);
+
+/*
+ * Fault table consulted by the trap handler: a fatal kernel-mode fault
+ * with the PC in [cf_start, cf_end) resumes at cf_fixup instead.
+ */
+struct copyuser_fixup {
+	vaddr_t cf_start;
+	vaddr_t cf_end;
+	vaddr_t cf_fixup;
+};
+
+extern const struct copyuser_fixup copyuser_fixups[];
+extern const unsigned copyuser_nfixups;
+
+#endif /* _MIPS_COPYUSER_H_ */
@@ -32,6 +32,7 @@
 #include <lib.h>
 #include <mips/specialreg.h>
 #include <mips/trapframe.h>
+#include <mips/copyuser.h>
 #include <cpu.h>
 #include <spl.h>
 #include <thread.h>
@@ -129,6 +130,7 @@ mips_trap(struct trapframe *tf)
 	/*bool isutlb; -- not used */
 	bool iskern;
 	int spl;
+	unsigned i;
 
 	/* The trap frame is supposed to be 35 registers long. */
 	KASSERT(sizeof(struct trapframe)==(35*4));
@@ -156,6 +158,7 @@ mips_trap(struct trapframe *tf)
 
 		old_in = curthread->t_in_interrupt;
 		curthread->t_in_interrupt = 1;
+		curthread->t_intr_user = !iskern;
 
 		/*
 		 * The processor has turned interrupts off; if the
@@ -303,6 +306,20 @@ mips_trap(struct trapframe *tf)
 		goto done;
 	}
 
+	/*
+	 * The copyin/copyout primitives don't use badfaultfunc; instead
+	 * they're listed in a table of PCs that are allowed to fault,
+	 * with where to resume. They're leaf routines, so resuming at
+	 * the fixup is enough to return EFAULT (well, -1) to the caller.
+	 */
+	for (i=0; i<copyuser_nfixups; i++) {
+		if (tf->tf_epc >= copyuser_fixups[i].cf_start &&
+		    tf->tf_epc < copyuser_fixups[i].cf_end) {
+			tf->tf_epc = copyuser_fixups[i].cf_fixup;
+			goto done;
+		}
+	}
+
 	/*
 	 * Really fatal kernel-mode fault.
 	 */
@@ -36,6 +36,7 @@
 #include <current.h>
 #include <syscall.h>
 #include <copyinout.h>
+#include <trace.h>
 
 
 /*
@@ -89,11 +90,16 @@ syscall(struct trapframe *tf)
 	int64_t pos;
 	int whence;
 
+	// For mmap
+	int mmap_fd;
+	off_t mmap_offset;
+
 	KASSERT(curthread != NULL);
 	KASSERT(curthread->t_curspl == 0);
 	KASSERT(curthread->t_iplhigh_count == 0);
 
 	callno = tf->tf_v0;
+	TRACE(TRACE_SYSCALL, callno, tf->tf_a0);
 
 	/*
 	 * Initialize retval to 0. Many of the system calls don't
@@ -119,6 +125,11 @@ syscall(struct trapframe *tf)
 		err = sys___time((userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1);
 		break;
 
+	    case SYS_nanosleep:
+		err = sys_nanosleep((const_userptr_t)tf->tf_a0,
+				    (userptr_t)tf->tf_a1);
+		break;
+
 	    /* File syscalls */
 
 	    case SYS_open:
@@ -151,8 +162,66 @@ syscall(struct trapframe *tf)
 	    break;
 
 	    case SYS_dup2:
-	    err = 0;
-	    //err = sys_dup2(tf->tf_a0, tf->tf_a1, &retval);
+	    err = sys_dup2(tf->tf_a0, tf->tf_a1, &retval);
+	    break;
+
+	    case SYS_pipe:
+	    err = sys_pipe((userptr_t)tf->tf_a0, &retval);
+	    break;
+
+	    case SYS_copy_file_range:
+	    err = sys_copy_file_range(tf->tf_a0, tf->tf_a1, tf->tf_a2, &retval);
+	    break;
+
+	    /* Memory-mapped files */
+
+	    case SYS_mmap:
+	    /* fd and the (aligned) 64-bit offset are on the stack */
+	    err = copyin((const_userptr_t)(tf->tf_sp + 16), &mmap_fd, sizeof(mmap_fd));
+	    if (err) {
+	    	break;
+	    }
+	    err = copyin((const_userptr_t)(tf->tf_sp + 24), &mmap_offset, sizeof(mmap_offset));
+	    if (err) {
+	    	break;
+	    }
+	    err = sys_mmap((userptr_t)tf->tf_a0, tf->tf_a1, tf->tf_a2, tf->tf_a3, mmap_fd, mmap_offset, &retval);
+	    break;
+
+	    case SYS_munmap:
+	    err = sys_munmap((userptr_t)tf->tf_a0, tf->tf_a1, &retval);
+	    break;
+
+	    case SYS_msync:
+	    err = sys_msync((userptr_t)tf->tf_a0, tf->tf_a1, tf->tf_a2, &retval);
+	    break;
+
+	    /* Heap */
+
+	    case SYS_sbrk:
+	    err = sys_sbrk((intptr_t)tf->tf_a0, &retval);
+	    break;
+
+	    /* Futexes */
+
+	    case SYS_futex_wait:
+	    err = sys_futex_wait((userptr_t)tf->tf_a0, tf->tf_a1, &retval);
+	    break;
+
+	    case SYS_futex_wake:
+	    err = sys_futex_wake((userptr_t)tf->tf_a0, tf->tf_a1, &retval);
+	    break;
+
+	    /* Semaphores */
+
+	    case SYS_sem_op:
+	    err = sys_sem_op(tf->tf_a0, tf->tf_a1, &retval);
+	    break;
+
+	    /* Resource usage */
+
+	    case SYS_getrusage:
+	    err = sys_getrusage(tf->tf_a0, (userptr_t)tf->tf_a1, &retval);
 	    break;
 
 	    /* Process syscalls */
@@ -197,6 +266,8 @@ syscall(struct trapframe *tf)
 
 	tf->tf_epc += 4;
 
+	TRACE(TRACE_SYSRET, callno, err);
+
 	/* Make sure the syscall code didn't forget to lower spl */
 	KASSERT(curthread->t_curspl == 0);
 	/* ...or leak any spinlocks */
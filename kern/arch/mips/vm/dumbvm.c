@@ -38,6 +38,12 @@
 #include <mips/tlb.h>
 #include <addrspace.h>
 #include <vm.h>
+#include <trace.h>
+#include <vnode.h>
+#include <uio.h>
+#include <kern/iovec.h>
+#include <kern/mman.h>
+#include <kern/stat.h>
 
 /*
  * Dumb MIPS-only "VM system" that is intended to only be just barely
@@ -64,6 +70,14 @@
  */
 static struct spinlock stealmem_lock = SPINLOCK_INITIALIZER;
 
+/*
+ * Single pages given back by user address spaces (heap and mmap
+ * pages), linked through their first word and handed out again by
+ * getppages(1). Protected by stealmem_lock. Kernel memory passed to
+ * free_kpages is still leaked, since we don't know how big it is.
+ */
+static paddr_t dumbvm_freepages;
+
 void
 vm_bootstrap(void)
 {
@@ -98,12 +112,34 @@ getppages(unsigned long npages)
 
 	spinlock_acquire(&stealmem_lock);
 
-	addr = ram_stealmem(npages);
+	if (npages == 1 && dumbvm_freepages != 0) {
+		addr = dumbvm_freepages;
+		dumbvm_freepages = *(paddr_t *)PADDR_TO_KVADDR(addr);
+	}
+	else {
+		addr = ram_stealmem(npages);
+	}
 
 	spinlock_release(&stealmem_lock);
 	return addr;
 }
 
+/*
+ * Give back a single page that came from getppages(1).
+ */
+static
+void
+putppage(paddr_t addr)
+{
+	KASSERT(addr != 0);
+	KASSERT((addr & PAGE_FRAME) == addr);
+
+	spinlock_acquire(&stealmem_lock);
+	*(paddr_t *)PADDR_TO_KVADDR(addr) = dumbvm_freepages;
+	dumbvm_freepages = addr;
+	spinlock_release(&stealmem_lock);
+}
+
 /* Allocate/free some kernel-space virtual pages */
 vaddr_t
 alloc_kpages(unsigned npages)
@@ -142,24 +178,330 @@ vm_tlbshootdown(const struct tlbshootdown *ts)
 	panic("dumbvm tried to do tlb shootdown?!\n");
 }
 
+/*
+ * Invalidate this CPU's TLB. dumbvm doesn't support shootdown, so this
+ * is only right for single-threaded processes, which is all we have.
+ */
+static
+void
+dumbvm_tlb_flush(void)
+{
+	int i, spl;
+
+	spl = splhigh();
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+	splx(spl);
+}
+
+////////////////////////////////////////////////////////////
+// File mappings
+
+static
+struct dumbvm_mmap *
+mmap_create(vaddr_t vbase, size_t npages, struct vnode *vn, off_t offset,
+	    int prot, int flags)
+{
+	struct dumbvm_mmap *mm;
+	size_t i;
+
+	mm = kmalloc(sizeof(*mm));
+	if (mm == NULL) {
+		return NULL;
+	}
+	mm->mm_pages = kmalloc(npages * sizeof(paddr_t));
+	if (mm->mm_pages == NULL) {
+		kfree(mm);
+		return NULL;
+	}
+	mm->mm_dirty = kmalloc(npages * sizeof(bool));
+	if (mm->mm_dirty == NULL) {
+		kfree(mm->mm_pages);
+		kfree(mm);
+		return NULL;
+	}
+	for (i=0; i<npages; i++) {
+		mm->mm_pages[i] = 0;
+		mm->mm_dirty[i] = false;
+	}
+
+	VOP_INCREF(vn);
+	mm->mm_vbase = vbase;
+	mm->mm_npages = npages;
+	mm->mm_vnode = vn;
+	mm->mm_offset = offset;
+	mm->mm_prot = prot;
+	mm->mm_flags = flags;
+	return mm;
+}
+
+/*
+ * Free a mapping and whatever pages it still holds. Dirty pages must
+ * already have been written back.
+ */
+static
+void
+mmap_destroy(struct dumbvm_mmap *mm)
+{
+	size_t i;
+
+	for (i=0; i<mm->mm_npages; i++) {
+		if (mm->mm_pages[i] != 0) {
+			putppage(mm->mm_pages[i]);
+		}
+	}
+	VOP_DECREF(mm->mm_vnode);
+	kfree(mm->mm_dirty);
+	kfree(mm->mm_pages);
+	kfree(mm);
+}
+
+/*
+ * Make a new mapping out of pages [first, first+count) of MM. The
+ * pages move to the new mapping; MM no longer refers to them.
+ */
+static
+struct dumbvm_mmap *
+mmap_carve(struct dumbvm_mmap *mm, size_t first, size_t count)
+{
+	struct dumbvm_mmap *piece;
+	size_t i;
+
+	KASSERT(first + count <= mm->mm_npages);
+
+	piece = mmap_create(mm->mm_vbase + first * PAGE_SIZE, count,
+			    mm->mm_vnode,
+			    mm->mm_offset + (off_t)first * PAGE_SIZE,
+			    mm->mm_prot, mm->mm_flags);
+	if (piece == NULL) {
+		return NULL;
+	}
+	for (i=0; i<count; i++) {
+		piece->mm_pages[i] = mm->mm_pages[first + i];
+		piece->mm_dirty[i] = mm->mm_dirty[first + i];
+		mm->mm_pages[first + i] = 0;
+		mm->mm_dirty[first + i] = false;
+	}
+	return piece;
+}
+
+static
+struct dumbvm_mmap *
+mmap_lookup(struct addrspace *as, vaddr_t vaddr, int *slot)
+{
+	struct dumbvm_mmap *mm;
+	int i;
+
+	for (i=0; i<DUMBVM_MAXMMAPS; i++) {
+		mm = as->as_mmaps[i];
+		if (mm != NULL && vaddr >= mm->mm_vbase &&
+		    vaddr < mm->mm_vbase + mm->mm_npages * PAGE_SIZE) {
+			if (slot != NULL) {
+				*slot = i;
+			}
+			return mm;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Write back the dirty pages in [first, first+count). Only the part of
+ * each page that lies inside the file is written; mappings never extend
+ * the file.
+ */
+static
+int
+mmap_writeback(struct dumbvm_mmap *mm, size_t first, size_t count)
+{
+	struct stat st;
+	struct iovec iov;
+	struct uio ku;
+	off_t pos;
+	size_t i, len;
+	int result;
+
+	if ((mm->mm_flags & MAP_TYPE) != MAP_SHARED) {
+		return 0;
+	}
+
+	result = VOP_STAT(mm->mm_vnode, &st);
+	if (result) {
+		return result;
+	}
+
+	for (i=first; i<first+count; i++) {
+		if (!mm->mm_dirty[i]) {
+			continue;
+		}
+		KASSERT(mm->mm_pages[i] != 0);
+
+		pos = mm->mm_offset + (off_t)i * PAGE_SIZE;
+		if (pos < st.st_size) {
+			len = PAGE_SIZE;
+			if (st.st_size - pos < (off_t)len) {
+				len = st.st_size - pos;
+			}
+			uio_kinit(&iov, &ku,
+				  (void *)PADDR_TO_KVADDR(mm->mm_pages[i]),
+				  len, pos, UIO_WRITE);
+			result = VOP_WRITE(mm->mm_vnode, &ku);
+			if (result) {
+				return result;
+			}
+		}
+		mm->mm_dirty[i] = false;
+	}
+
+	/* Drop the dirty bits from the TLB so the next store is noticed. */
+	dumbvm_tlb_flush();
+	return 0;
+}
+
+/*
+ * Read page INDEX of a mapping in from the file. Anything past EOF
+ * reads as zero. If the fault came from inside a read or write of
+ * the same file, the filesystem refuses the nested read and the fault
+ * fails; see sfs_rwio.
+ */
+static
+int
+mmap_pagein(struct dumbvm_mmap *mm, size_t index)
+{
+	struct iovec iov;
+	struct uio ku;
+	paddr_t pa;
+	int result;
+
+	KASSERT(mm->mm_pages[index] == 0);
+
+	pa = getppages(1);
+	if (pa == 0) {
+		return ENOMEM;
+	}
+	bzero((void *)PADDR_TO_KVADDR(pa), PAGE_SIZE);
+
+	uio_kinit(&iov, &ku, (void *)PADDR_TO_KVADDR(pa), PAGE_SIZE,
+		  mm->mm_offset + (off_t)index * PAGE_SIZE, UIO_READ);
+	result = VOP_READ(mm->mm_vnode, &ku);
+	if (result) {
+		putppage(pa);
+		return result;
+	}
+
+	mm->mm_pages[index] = pa;
+	return 0;
+}
+
+/*
+ * Resolve a fault on a mapped page. Pages of writable MAP_SHARED
+ * mappings are entered read-only until the first store, so that we
+ * know which ones to write back.
+ */
+static
+int
+mmap_fault(struct dumbvm_mmap *mm, int faulttype, vaddr_t faultaddress,
+	   paddr_t *paddr, uint32_t *dirtybit)
+{
+	size_t index;
+	bool shared;
+	int result;
+
+	index = (faultaddress - mm->mm_vbase) / PAGE_SIZE;
+	shared = (mm->mm_flags & MAP_TYPE) == MAP_SHARED;
+
+	if ((mm->mm_prot & PROT_READ) == 0) {
+		return EFAULT;
+	}
+	if (faulttype != VM_FAULT_READ && (mm->mm_prot & PROT_WRITE) == 0) {
+		return EFAULT;
+	}
+
+	if (mm->mm_pages[index] == 0) {
+		result = mmap_pagein(mm, index);
+		if (result) {
+			return result;
+		}
+	}
+
+	if (faulttype != VM_FAULT_READ && shared) {
+		mm->mm_dirty[index] = true;
+	}
+
+	*paddr = mm->mm_pages[index];
+	if ((mm->mm_prot & PROT_WRITE) == 0) {
+		*dirtybit = 0;
+	}
+	else if (shared && !mm->mm_dirty[index]) {
+		*dirtybit = 0;
+	}
+	else {
+		*dirtybit = TLBLO_DIRTY;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// Heap
+
+/* Number of pages spanned by a heap ending at BRK. */
+static
+size_t
+heap_npages(struct addrspace *as, vaddr_t brk)
+{
+	return (brk - as->as_heapbase + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+/*
+ * Back a heap page on first touch with a zero-filled page.
+ */
+static
+int
+heap_fault(struct addrspace *as, vaddr_t faultaddress, paddr_t *paddr)
+{
+	size_t index;
+	paddr_t pa;
+
+	index = (faultaddress - as->as_heapbase) / PAGE_SIZE;
+	KASSERT(index < as->as_heapslots);
+
+	if (as->as_heappages[index] == 0) {
+		pa = getppages(1);
+		if (pa == 0) {
+			return ENOMEM;
+		}
+		bzero((void *)PADDR_TO_KVADDR(pa), PAGE_SIZE);
+		as->as_heappages[index] = pa;
+	}
+	*paddr = as->as_heappages[index];
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+
 int
 vm_fault(int faulttype, vaddr_t faultaddress)
 {
 	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop;
+	vaddr_t heaptop;
 	paddr_t paddr;
 	int i;
 	uint32_t ehi, elo;
 	struct addrspace *as;
+	struct dumbvm_mmap *mm;
+	uint32_t dirtybit;
+	int result;
 	int spl;
 
 	faultaddress &= PAGE_FRAME;
 
+	TRACE(TRACE_FAULT, faulttype, faultaddress);
 	DEBUG(DB_VM, "dumbvm: fault: 0x%x\n", faultaddress);
 
 	switch (faulttype) {
 	    case VM_FAULT_READONLY:
-		/* We always create pages read-write, so we can't get this */
-		panic("dumbvm: got VM_FAULT_READONLY\n");
+		/* Only mmap'd pages are ever read-only; see below */
 	    case VM_FAULT_READ:
 	    case VM_FAULT_WRITE:
 		break;
@@ -185,6 +527,8 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 		return EFAULT;
 	}
 
+	curthread->t_usage.tu_faults++;
+
 	/* Assert that the address space has been set up properly. */
 	KASSERT(as->as_vbase1 != 0);
 	KASSERT(as->as_pbase1 != 0);
@@ -205,8 +549,22 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
 	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
 	stacktop = USERSTACK;
-
-	if (faultaddress >= vbase1 && faultaddress < vtop1) {
+	heaptop = as->as_heapbase + heap_npages(as, as->as_heapend) * PAGE_SIZE;
+	dirtybit = TLBLO_DIRTY;
+
+	mm = mmap_lookup(as, faultaddress, NULL);
+	if (mm != NULL) {
+		result = mmap_fault(mm, faulttype, faultaddress,
+				    &paddr, &dirtybit);
+		if (result) {
+			return result;
+		}
+	}
+	else if (faulttype == VM_FAULT_READONLY) {
+		/* We always create other pages read-write */
+		panic("dumbvm: got VM_FAULT_READONLY\n");
+	}
+	else if (faultaddress >= vbase1 && faultaddress < vtop1) {
 		paddr = (faultaddress - vbase1) + as->as_pbase1;
 	}
 	else if (faultaddress >= vbase2 && faultaddress < vtop2) {
@@ -215,6 +573,12 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	else if (faultaddress >= stackbase && faultaddress < stacktop) {
 		paddr = (faultaddress - stackbase) + as->as_stackpbase;
 	}
+	else if (faultaddress >= as->as_heapbase && faultaddress < heaptop) {
+		result = heap_fault(as, faultaddress, &paddr);
+		if (result) {
+			return result;
+		}
+	}
 	else {
 		return EFAULT;
 	}
@@ -225,13 +589,23 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	/* Disable interrupts on this CPU while frobbing the TLB. */
 	spl = splhigh();
 
+	if (faulttype == VM_FAULT_READONLY) {
+		/* First store to a shared page: make its entry writable. */
+		i = tlb_probe(faultaddress, 0);
+		if (i >= 0) {
+			tlb_write(faultaddress, paddr | dirtybit | TLBLO_VALID, i);
+			splx(spl);
+			return 0;
+		}
+	}
+
 	for (i=0; i<NUM_TLB; i++) {
 		tlb_read(&ehi, &elo, i);
 		if (elo & TLBLO_VALID) {
 			continue;
 		}
 		ehi = faultaddress;
-		elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
+		elo = paddr | dirtybit | TLBLO_VALID;
 		DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
 		tlb_write(ehi, elo, i);
 		splx(spl);
@@ -246,6 +620,7 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 struct addrspace *
 as_create(void)
 {
+	int i;
 	struct addrspace *as = kmalloc(sizeof(struct addrspace));
 	if (as==NULL) {
 		return NULL;
@@ -258,6 +633,15 @@ as_create(void)
 	as->as_pbase2 = 0;
 	as->as_npages2 = 0;
 	as->as_stackpbase = 0;
+	for (i=0; i<DUMBVM_MAXMMAPS; i++) {
+		as->as_mmaps[i] = NULL;
+	}
+	/* Leave an unmapped guard page under the stack. */
+	as->as_mmapbase = USERSTACK - (DUMBVM_STACKPAGES + 1) * PAGE_SIZE;
+	as->as_heapbase = 0;
+	as->as_heapend = 0;
+	as->as_heappages = NULL;
+	as->as_heapslots = 0;
 
 	return as;
 }
@@ -265,7 +649,27 @@ as_create(void)
 void
 as_destroy(struct addrspace *as)
 {
+	struct dumbvm_mmap *mm;
+	size_t j;
+	int i;
+
 	dumbvm_can_sleep();
+
+	for (i=0; i<DUMBVM_MAXMMAPS; i++) {
+		mm = as->as_mmaps[i];
+		if (mm != NULL) {
+			/* Nobody to report a write-back error to. */
+			(void)mmap_writeback(mm, 0, mm->mm_npages);
+			mmap_destroy(mm);
+			as->as_mmaps[i] = NULL;
+		}
+	}
+	for (j=0; j<as->as_heapslots; j++) {
+		if (as->as_heappages[j] != 0) {
+			putppage(as->as_heappages[j]);
+		}
+	}
+	kfree(as->as_heappages);
 	kfree(as);
 }
 
@@ -378,8 +782,15 @@ as_prepare_load(struct addrspace *as)
 int
 as_complete_load(struct addrspace *as)
 {
+	vaddr_t top1, top2;
+
 	dumbvm_can_sleep();
-	(void)as;
+
+	/* The heap starts out empty, just above whichever region is higher. */
+	top1 = as->as_vbase1 + as->as_npages1 * PAGE_SIZE;
+	top2 = as->as_vbase2 + as->as_npages2 * PAGE_SIZE;
+	as->as_heapbase = top1 > top2 ? top1 : top2;
+	as->as_heapend = as->as_heapbase;
 	return 0;
 }
 
@@ -396,6 +807,9 @@ int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
 	struct addrspace *new;
+	struct dumbvm_mmap *omm, *nmm;
+	size_t j;
+	int i, result;
 
 	dumbvm_can_sleep();
 
@@ -431,6 +845,353 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 		(const void *)PADDR_TO_KVADDR(old->as_stackpbase),
 		DUMBVM_STACKPAGES*PAGE_SIZE);
 
+	/*
+	 * Private mappings get a copy of every page touched so far.
+	 * Shared mappings are written back and the child pages them in
+	 * again from the file, which is where the two meet up.
+	 */
+	for (i=0; i<DUMBVM_MAXMMAPS; i++) {
+		omm = old->as_mmaps[i];
+		if (omm == NULL) {
+			continue;
+		}
+		result = mmap_writeback(omm, 0, omm->mm_npages);
+		if (result) {
+			as_destroy(new);
+			return result;
+		}
+		nmm = mmap_create(omm->mm_vbase, omm->mm_npages,
+				  omm->mm_vnode, omm->mm_offset,
+				  omm->mm_prot, omm->mm_flags);
+		if (nmm == NULL) {
+			as_destroy(new);
+			return ENOMEM;
+		}
+		new->as_mmaps[i] = nmm;
+		if ((omm->mm_flags & MAP_TYPE) == MAP_SHARED) {
+			continue;
+		}
+		for (j=0; j<omm->mm_npages; j++) {
+			if (omm->mm_pages[j] == 0) {
+				continue;
+			}
+			nmm->mm_pages[j] = getppages(1);
+			if (nmm->mm_pages[j] == 0) {
+				as_destroy(new);
+				return ENOMEM;
+			}
+			memmove((void *)PADDR_TO_KVADDR(nmm->mm_pages[j]),
+				(const void *)PADDR_TO_KVADDR(omm->mm_pages[j]),
+				PAGE_SIZE);
+		}
+	}
+	new->as_mmapbase = old->as_mmapbase;
+
+	/* Copy the heap pages that have been touched. */
+	new->as_heapbase = old->as_heapbase;
+	new->as_heapend = old->as_heapend;
+	if (old->as_heapslots > 0) {
+		new->as_heappages = kmalloc(old->as_heapslots * sizeof(paddr_t));
+		if (new->as_heappages == NULL) {
+			as_destroy(new);
+			return ENOMEM;
+		}
+		new->as_heapslots = old->as_heapslots;
+		for (j=0; j<old->as_heapslots; j++) {
+			new->as_heappages[j] = 0;
+		}
+		for (j=0; j<old->as_heapslots; j++) {
+			if (old->as_heappages[j] == 0) {
+				continue;
+			}
+			new->as_heappages[j] = getppages(1);
+			if (new->as_heappages[j] == 0) {
+				as_destroy(new);
+				return ENOMEM;
+			}
+			memmove((void *)PADDR_TO_KVADDR(new->as_heappages[j]),
+				(const void *)PADDR_TO_KVADDR(old->as_heappages[j]),
+				PAGE_SIZE);
+		}
+	}
+
 	*ret = new;
 	return 0;
 }
+
+/*
+ * Map a file. Mappings are handed out downward from below the stack;
+ * address space freed by munmap is not reused.
+ */
+int
+as_map_file(struct addrspace *as, size_t len, int prot, int flags,
+	    struct vnode *vn, off_t offset, vaddr_t *ret)
+{
+	struct dumbvm_mmap *mm;
+	vaddr_t vbase, datatop;
+	size_t npages;
+	int i;
+
+	dumbvm_can_sleep();
+
+	KASSERT(len > 0);
+	KASSERT(offset % PAGE_SIZE == 0);
+
+	npages = (len + PAGE_SIZE - 1) / PAGE_SIZE;
+	datatop = as->as_heapbase + heap_npages(as, as->as_heapend) * PAGE_SIZE;
+	if (npages > (as->as_mmapbase - datatop) / PAGE_SIZE) {
+		return ENOMEM;
+	}
+	vbase = as->as_mmapbase - npages * PAGE_SIZE;
+
+	for (i=0; i<DUMBVM_MAXMMAPS; i++) {
+		if (as->as_mmaps[i] == NULL) {
+			break;
+		}
+	}
+	if (i == DUMBVM_MAXMMAPS) {
+		return ENOMEM;
+	}
+
+	mm = mmap_create(vbase, npages, vn, offset, prot, flags);
+	if (mm == NULL) {
+		return ENOMEM;
+	}
+
+	as->as_mmaps[i] = mm;
+	as->as_mmapbase = vbase;
+	*ret = vbase;
+	return 0;
+}
+
+/*
+ * Remove [vaddr, vaddr+len) from every mapping it overlaps. A mapping
+ * that loses only its middle is split in two, which needs a free slot;
+ * if there isn't one we fail before touching anything.
+ */
+int
+as_unmap(struct addrspace *as, vaddr_t vaddr, size_t len)
+{
+	struct dumbvm_mmap *mm, *head, *tail;
+	vaddr_t start, end, mtop, cut_start, cut_end;
+	size_t first, count;
+	int i, j, result;
+
+	dumbvm_can_sleep();
+
+	start = vaddr & PAGE_FRAME;
+	end = (vaddr + len + PAGE_SIZE - 1) & PAGE_FRAME;
+
+	for (i=0; i<DUMBVM_MAXMMAPS; i++) {
+		mm = as->as_mmaps[i];
+		if (mm == NULL) {
+			continue;
+		}
+		mtop = mm->mm_vbase + mm->mm_npages * PAGE_SIZE;
+		if (end <= mm->mm_vbase || start >= mtop) {
+			continue;
+		}
+
+		cut_start = start > mm->mm_vbase ? start : mm->mm_vbase;
+		cut_end = end < mtop ? end : mtop;
+		first = (cut_start - mm->mm_vbase) / PAGE_SIZE;
+		count = (cut_end - cut_start) / PAGE_SIZE;
+
+		j = -1;
+		if (cut_start > mm->mm_vbase && cut_end < mtop) {
+			for (j=0; j<DUMBVM_MAXMMAPS; j++) {
+				if (as->as_mmaps[j] == NULL) {
+					break;
+				}
+			}
+			if (j == DUMBVM_MAXMMAPS) {
+				return ENOMEM;
+			}
+		}
+
+		result = mmap_writeback(mm, first, count);
+		if (result) {
+			return result;
+		}
+
+		head = tail = NULL;
+		if (cut_start > mm->mm_vbase) {
+			head = mmap_carve(mm, 0, first);
+			if (head == NULL) {
+				return ENOMEM;
+			}
+		}
+		if (cut_end < mtop) {
+			tail = mmap_carve(mm, first + count,
+					  mm->mm_npages - first - count);
+			if (tail == NULL) {
+				if (head != NULL) {
+					/* put the head pages back */
+					for (j=0; j<(int)first; j++) {
+						mm->mm_pages[j] =
+							head->mm_pages[j];
+						mm->mm_dirty[j] =
+							head->mm_dirty[j];
+						head->mm_pages[j] = 0;
+					}
+					mmap_destroy(head);
+				}
+				return ENOMEM;
+			}
+		}
+
+		/* Whatever is left in mm is the part being unmapped. */
+		mmap_destroy(mm);
+		as->as_mmaps[i] = head != NULL ? head : tail;
+		if (head != NULL && tail != NULL) {
+			KASSERT(j >= 0 && as->as_mmaps[j] == NULL);
+			as->as_mmaps[j] = tail;
+		}
+	}
+
+	dumbvm_tlb_flush();
+	return 0;
+}
+
+/*
+ * Write back dirty shared pages in [vaddr, vaddr+len). Fails with
+ * ENOMEM if part of the range isn't mapped, like Unix msync.
+ */
+int
+as_sync(struct addrspace *as, vaddr_t vaddr, size_t len)
+{
+	struct dumbvm_mmap *mm;
+	vaddr_t va, end, mtop;
+	size_t first, count;
+	int result;
+
+	dumbvm_can_sleep();
+
+	va = vaddr & PAGE_FRAME;
+	end = (vaddr + len + PAGE_SIZE - 1) & PAGE_FRAME;
+
+	while (va < end) {
+		mm = mmap_lookup(as, va, NULL);
+		if (mm == NULL) {
+			return ENOMEM;
+		}
+		mtop = mm->mm_vbase + mm->mm_npages * PAGE_SIZE;
+		first = (va - mm->mm_vbase) / PAGE_SIZE;
+		count = ((end < mtop ? end : mtop) - va) / PAGE_SIZE;
+
+		result = mmap_writeback(mm, first, count);
+		if (result) {
+			return result;
+		}
+		va += count * PAGE_SIZE;
+	}
+	return 0;
+}
+
+/*
+ * Move the break. The page table only grows (doubling, so a heap grown
+ * a page at a time doesn't copy it every time); pages above a lowered
+ * break are freed right away.
+ */
+int
+as_sbrk(struct addrspace *as, intptr_t amount, vaddr_t *oldbreak)
+{
+	vaddr_t newend, top;
+	size_t oldpages, newpages, nslots, i;
+	paddr_t *pages;
+
+	dumbvm_can_sleep();
+
+	KASSERT(as->as_heapbase != 0);
+
+	if (amount < 0 &&
+	    (vaddr_t)0 - (vaddr_t)amount > as->as_heapend - as->as_heapbase) {
+		return EINVAL;
+	}
+	if (amount > 0 && (vaddr_t)amount > as->as_mmapbase - as->as_heapend) {
+		return ENOMEM;
+	}
+	newend = as->as_heapend + amount;
+
+	oldpages = heap_npages(as, as->as_heapend);
+	newpages = heap_npages(as, newend);
+
+	if (newpages > as->as_heapslots) {
+		top = (as->as_mmapbase - as->as_heapbase) / PAGE_SIZE;
+		nslots = as->as_heapslots * 2;
+		if (nslots < newpages) {
+			nslots = newpages;
+		}
+		if (nslots > top) {
+			nslots = top;
+		}
+		pages = kmalloc(nslots * sizeof(paddr_t));
+		if (pages == NULL) {
+			return ENOMEM;
+		}
+		for (i=0; i<nslots; i++) {
+			pages[i] = i < as->as_heapslots ? as->as_heappages[i] : 0;
+		}
+		kfree(as->as_heappages);
+		as->as_heappages = pages;
+		as->as_heapslots = nslots;
+	}
+
+	if (newpages < oldpages) {
+		for (i=newpages; i<oldpages; i++) {
+			if (as->as_heappages[i] != 0) {
+				putppage(as->as_heappages[i]);
+				as->as_heappages[i] = 0;
+			}
+		}
+		dumbvm_tlb_flush();
+	}
+
+	*oldbreak = as->as_heapend;
+	as->as_heapend = newend;
+	return 0;
+}
+
+/*
+ * Only the fixed regions, the stack, and heap pages that have already
+ * been touched are handed out. File mappings are refused so writes to
+ * them still go through vm_fault and get marked dirty.
+ */
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret)
+{
+	vaddr_t page, offset, stackbase, heaptop;
+	size_t index;
+
+	page = vaddr & PAGE_FRAME;
+	offset = vaddr - page;
+	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
+	heaptop = as->as_heapbase + heap_npages(as, as->as_heapend) * PAGE_SIZE;
+
+	if (mmap_lookup(as, page, NULL) != NULL) {
+		return EFAULT;
+	}
+	if (page >= as->as_vbase1 &&
+	    page < as->as_vbase1 + as->as_npages1 * PAGE_SIZE) {
+		*ret = as->as_pbase1 + (vaddr - as->as_vbase1);
+		return 0;
+	}
+	if (page >= as->as_vbase2 &&
+	    page < as->as_vbase2 + as->as_npages2 * PAGE_SIZE) {
+		*ret = as->as_pbase2 + (vaddr - as->as_vbase2);
+		return 0;
+	}
+	if (page >= stackbase && page < USERSTACK) {
+		*ret = as->as_stackpbase + (vaddr - stackbase);
+		return 0;
+	}
+	if (page >= as->as_heapbase && page < heaptop) {
+		index = (page - as->as_heapbase) / PAGE_SIZE;
+		if (as->as_heappages[index] == 0) {
+			return EFAULT;
+		}
+		*ret = as->as_heappages[index] + offset;
+		return 0;
+	}
+	return EFAULT;
+}
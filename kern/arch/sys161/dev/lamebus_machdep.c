@@ -38,6 +38,7 @@
 #include <thread.h>
 #include <current.h>
 #include <membar.h>
+#include <profile.h>
 #include <synch.h>
 #include <mainbus.h>
 #include <sys161/bus.h>
@@ -76,6 +77,87 @@ mips_timer_set(uint32_t count)
 		:: "r" (count));
 }
 
+/*
+ * Read c0_count ($9) and c0_compare ($11).
+ */
+static
+uint32_t
+mips_timer_getcount(void)
+{
+	uint32_t count;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 registers */
+		"mfc0 %0, $9;"		/* get it */
+		".set pop"		/* restore assembler mode */
+		: "=r" (count));
+	return count;
+}
+
+static
+uint32_t
+mips_timer_getcompare(void)
+{
+	uint32_t compare;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 registers */
+		"mfc0 %0, $11;"		/* get it */
+		".set pop"		/* restore assembler mode */
+		: "=r" (compare));
+	return compare;
+}
+
+/*
+ * Restart the count from zero and set the timer for COUNT cycles
+ * from now. (Writing c0_compare alone would leave any time already
+ * counted up in place, and if the count were past COUNT the timer
+ * would not go off until it wrapped.)
+ */
+static
+void
+mips_timer_restart(uint32_t count)
+{
+	/* $9 == c0_count */
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 registers */
+		"mtc0 $0, $9;"		/* zero the count */
+		".set pop"		/* restore assembler mode */
+		);
+	mips_timer_set(count);
+}
+
+/*
+ * Turn this cpu's hardclock on and off. There is no way to switch the
+ * on-chip timer off as such, so "off" sets it as far out as it goes;
+ * at 25 MHz that is about three minutes.
+ *
+ * While it's off the profiler gets no samples, so when it comes back
+ * on, the profiler is credited with the idle ticks that went by. The
+ * count has been running from zero since the stop (or since the odd
+ * tick that got through; see mainbus_interrupt).
+ */
+#define MIPS_TIMER_OFF 0xffffffff
+#define MIPS_TIMER_TICK (CPU_FREQUENCY / HZ)
+
+void
+mainbus_hardclock_start(void)
+{
+	if (mips_timer_getcompare() == MIPS_TIMER_OFF) {
+		PROF_IDLETICKS(mips_timer_getcount() / MIPS_TIMER_TICK);
+	}
+	mips_timer_restart(MIPS_TIMER_TICK);
+}
+
+void
+mainbus_hardclock_stop(void)
+{
+	mips_timer_restart(MIPS_TIMER_OFF);
+}
+
 /*
  * LAMEbus data for the system. (We have only one LAMEbus per system.)
  * This does not need to be locked, because it's constant once
@@ -116,7 +198,7 @@ mainbus_bootstrap(void)
 	/*
 	 * Configure the MIPS on-chip timer to interrupt HZ times a second.
 	 */
-	mips_timer_set(CPU_FREQUENCY / HZ);
+	mainbus_hardclock_start();
 }
 
 /*
@@ -314,8 +396,25 @@ mainbus_interrupt(struct trapframe *tf)
 		seen = true;
 	}
 	if (cause & MIPS_TIMER_BIT) {
-		/* Reset the timer (this clears the interrupt) */
-		mips_timer_set(CPU_FREQUENCY / HZ);
+		if (curcpu->c_isidle) {
+			/*
+			 * The odd tick that gets through while the
+			 * hardclock is off (or just before it goes
+			 * off). The count started over at the match, so
+			 * credit the profiler with the whole span now,
+			 * and leave the timer off. This also clears the
+			 * interrupt.
+			 */
+			PROF_IDLETICKS(mips_timer_getcompare() /
+				       MIPS_TIMER_TICK);
+			mips_timer_set(MIPS_TIMER_OFF);
+		}
+		else {
+			/* Reset the timer (this clears the interrupt) */
+			mips_timer_set(MIPS_TIMER_TICK);
+			/* take a profiling sample, if on */
+			PROF_SAMPLE(tf->tf_epc, tf->tf_ra);
+		}
 		/* and call hardclock */
 		hardclock();
 		seen = true;
@@ -33,6 +33,11 @@
  * We expose a simple interface to the rest of the kernel: "putch" to
  * print a character, "getch" to read one.
  *
+ * Output goes through a ring buffer that the device drains from its
+ * write-done interrupt, so a thread writing to the console only waits
+ * when the buffer is full, not once per character. Input is likewise
+ * collected by the read interrupt and handed to readers in batches.
+ *
  * As long as the device we're connected to does, we allow printing in
  * an interrupt handler or with interrupts off (by polling),
  * transparently to the caller. Note that getch by polling is not
@@ -55,6 +60,8 @@
 #include <thread.h>
 #include <current.h>
 #include <synch.h>
+#include <spinlock.h>
+#include <wchan.h>
 #include <generic/console.h>
 #include <vfs.h>
 #include <device.h>
@@ -109,15 +116,88 @@ flush_delay_buf(void)
 
 //////////////////////////////////////////////////
 
+/*
+ * Start sending the next buffered character, if the device is idle.
+ * Call with cs_lock held.
+ */
+static
+void
+con_kick(struct con_softc *cs)
+{
+	unsigned char ch;
+
+	KASSERT(spinlock_do_i_hold(&cs->cs_lock));
+
+	if (cs->cs_busy || cs->cs_outchars_head == cs->cs_outchars_tail) {
+		return;
+	}
+
+	ch = cs->cs_outchars[cs->cs_outchars_tail];
+	cs->cs_outchars_tail =
+		(cs->cs_outchars_tail + 1) % CONSOLE_OUTPUT_BUFFER_SIZE;
+	cs->cs_busy = true;
+	cs->cs_send(cs->cs_devdata, ch);
+}
+
+/*
+ * Add characters to the output buffer, sleeping while it is full.
+ * Call with cs_lock held.
+ */
+static
+void
+con_queue(struct con_softc *cs, const char *buf, size_t len)
+{
+	unsigned nexthead;
+	size_t i;
+
+	KASSERT(spinlock_do_i_hold(&cs->cs_lock));
+
+	for (i=0; i<len; i++) {
+		nexthead = (cs->cs_outchars_head + 1) %
+			CONSOLE_OUTPUT_BUFFER_SIZE;
+		while (nexthead == cs->cs_outchars_tail) {
+			con_kick(cs);
+			wchan_sleep(cs->cs_wwchan, &cs->cs_lock);
+		}
+		cs->cs_outchars[cs->cs_outchars_head] = buf[i];
+		cs->cs_outchars_head = nexthead;
+	}
+	con_kick(cs);
+}
+
+//////////////////////////////////////////////////
+
 /*
  * Print a character, using polling instead of interrupts to wait for
  * I/O completion.
+ *
+ * Whatever is still in the output buffer goes out first, so that
+ * messages printed from interrupt handlers (or panic) don't overtake
+ * output queued earlier. If a buffered character is already on its
+ * way out, sendpolled waits for it; the write-done interrupt then
+ * finds the buffer empty and just marks the device idle.
  */
 static
 void
 putch_polled(struct con_softc *cs, int ch)
 {
+	unsigned char bch;
+
+	if (spinlock_do_i_hold(&cs->cs_lock)) {
+		/* Printing from inside the console code itself. */
+		cs->cs_sendpolled(cs->cs_devdata, ch);
+		return;
+	}
+
+	spinlock_acquire(&cs->cs_lock);
+	while (cs->cs_outchars_head != cs->cs_outchars_tail) {
+		bch = cs->cs_outchars[cs->cs_outchars_tail];
+		cs->cs_outchars_tail =
+			(cs->cs_outchars_tail + 1) % CONSOLE_OUTPUT_BUFFER_SIZE;
+		cs->cs_sendpolled(cs->cs_devdata, bch);
+	}
 	cs->cs_sendpolled(cs->cs_devdata, ch);
+	spinlock_release(&cs->cs_lock);
 }
 
 //////////////////////////////////////////////////
@@ -129,8 +209,11 @@ static
 void
 putch_intr(struct con_softc *cs, int ch)
 {
-	P(cs->cs_wsem);
-	cs->cs_send(cs->cs_devdata, ch);
+	char c = ch;
+
+	spinlock_acquire(&cs->cs_lock);
+	con_queue(cs, &c, 1);
+	spinlock_release(&cs->cs_lock);
 }
 
 /*
@@ -142,10 +225,14 @@ getch_intr(struct con_softc *cs)
 {
 	unsigned char ret;
 
-	P(cs->cs_rsem);
+	spinlock_acquire(&cs->cs_lock);
+	while (cs->cs_gotchars_head == cs->cs_gotchars_tail) {
+		wchan_sleep(cs->cs_rwchan, &cs->cs_lock);
+	}
 	ret = cs->cs_gotchars[cs->cs_gotchars_tail];
 	cs->cs_gotchars_tail =
 		(cs->cs_gotchars_tail + 1) % CONSOLE_INPUT_BUFFER_SIZE;
+	spinlock_release(&cs->cs_lock);
 	return ret;
 }
 
@@ -153,10 +240,7 @@ getch_intr(struct con_softc *cs)
  * Called from underlying device when a read-ready interrupt occurs.
  *
  * Note: if gotchars_head == gotchars_tail, the buffer is empty. Thus
- * if gotchars_head+1 == gotchars_tail, the buffer is full. A slightly
- * tidier way to implement this check (that avoids wasting a slot,
- * too) would be with a second semaphore used with a nonblocking P,
- * but we don't have that in OS/161.
+ * if gotchars_head+1 == gotchars_tail, the buffer is full.
  */
 void
 con_input(void *vcs, int ch)
@@ -164,27 +248,47 @@ con_input(void *vcs, int ch)
 	struct con_softc *cs = vcs;
 	unsigned nexthead;
 
+	spinlock_acquire(&cs->cs_lock);
+
 	nexthead = (cs->cs_gotchars_head + 1) % CONSOLE_INPUT_BUFFER_SIZE;
 	if (nexthead == cs->cs_gotchars_tail) {
 		/* overflow; drop character */
+		spinlock_release(&cs->cs_lock);
 		return;
 	}
 
 	cs->cs_gotchars[cs->cs_gotchars_head] = ch;
 	cs->cs_gotchars_head = nexthead;
 
-	V(cs->cs_rsem);
+	wchan_wakeall(cs->cs_rwchan, &cs->cs_lock);
+	spinlock_release(&cs->cs_lock);
 }
 
 /*
  * Called from underlying device when a write-done interrupt occurs.
+ *
+ * Send the next buffered character. Blocked writers are only woken
+ * once half the buffer has drained, so they refill it in batches
+ * rather than a character at a time.
  */
 void
 con_start(void *vcs)
 {
 	struct con_softc *cs = vcs;
+	unsigned used;
+
+	spinlock_acquire(&cs->cs_lock);
+
+	cs->cs_busy = false;
+	con_kick(cs);
 
-	V(cs->cs_wsem);
+	used = (cs->cs_outchars_head + CONSOLE_OUTPUT_BUFFER_SIZE -
+		cs->cs_outchars_tail) % CONSOLE_OUTPUT_BUFFER_SIZE;
+	if (used <= CONSOLE_OUTPUT_BUFFER_SIZE / 2) {
+		wchan_wakeall(cs->cs_wwchan, &cs->cs_lock);
+	}
+
+	spinlock_release(&cs->cs_lock);
 }
 
 //////////////////////////////////////////////////
@@ -240,16 +344,100 @@ con_eachopen(struct device *dev, int openflags)
 	return 0;
 }
 
+/*
+ * Size of the on-stack staging buffer used to move data between the
+ * uio and the console rings. Output may double in size from \n -> \r\n.
+ */
+#define CON_IOCHUNK 128
+
+/*
+ * Read from the console. Takes everything already typed (up to the end
+ * of the line) in one go under the lock, then copies it out.
+ */
+static
+int
+con_read(struct con_softc *cs, struct uio *uio)
+{
+	char buf[CON_IOCHUNK];
+	size_t len;
+	bool eol = false;
+	int result;
+
+	while (uio->uio_resid > 0 && !eol) {
+		spinlock_acquire(&cs->cs_lock);
+		while (cs->cs_gotchars_head == cs->cs_gotchars_tail) {
+			wchan_sleep(cs->cs_rwchan, &cs->cs_lock);
+		}
+		len = 0;
+		while (len < sizeof(buf) && len < uio->uio_resid && !eol &&
+		       cs->cs_gotchars_head != cs->cs_gotchars_tail) {
+			buf[len] = cs->cs_gotchars[cs->cs_gotchars_tail];
+			cs->cs_gotchars_tail = (cs->cs_gotchars_tail + 1) %
+				CONSOLE_INPUT_BUFFER_SIZE;
+			if (buf[len]=='\r') {
+				buf[len] = '\n';
+			}
+			if (buf[len]=='\n') {
+				eol = true;
+			}
+			len++;
+		}
+		spinlock_release(&cs->cs_lock);
+
+		result = uiomove(buf, len, uio);
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Write to the console. Copies the uio in chunks and queues each chunk
+ * with a single trip through the lock.
+ */
+static
+int
+con_write(struct con_softc *cs, struct uio *uio)
+{
+	char in[CON_IOCHUNK];
+	char out[CON_IOCHUNK * 2];
+	size_t inlen, outlen, i;
+	int result;
+
+	while (uio->uio_resid > 0) {
+		inlen = uio->uio_resid;
+		if (inlen > sizeof(in)) {
+			inlen = sizeof(in);
+		}
+		result = uiomove(in, inlen, uio);
+		if (result) {
+			return result;
+		}
+
+		outlen = 0;
+		for (i=0; i<inlen; i++) {
+			if (in[i]=='\n') {
+				out[outlen++] = '\r';
+			}
+			out[outlen++] = in[i];
+		}
+
+		spinlock_acquire(&cs->cs_lock);
+		con_queue(cs, out, outlen);
+		spinlock_release(&cs->cs_lock);
+	}
+	return 0;
+}
+
 static
 int
 con_io(struct device *dev, struct uio *uio)
 {
+	struct con_softc *cs = dev->d_data;
 	int result;
-	char ch;
 	struct lock *lk;
 
-	(void)dev;  // unused
-
 	if (uio->uio_rw==UIO_READ) {
 		lk = con_userlock_read;
 	}
@@ -260,35 +448,15 @@ con_io(struct device *dev, struct uio *uio)
 	KASSERT(lk != NULL);
 	lock_acquire(lk);
 
-	while (uio->uio_resid > 0) {
-		if (uio->uio_rw==UIO_READ) {
-			ch = getch();
-			if (ch=='\r') {
-				ch = '\n';
-			}
-			result = uiomove(&ch, 1, uio);
-			if (result) {
-				lock_release(lk);
-				return result;
-			}
-			if (ch=='\n') {
-				break;
-			}
-		}
-		else {
-			result = uiomove(&ch, 1, uio);
-			if (result) {
-				lock_release(lk);
-				return result;
-			}
-			if (ch=='\n') {
-				putch('\r');
-			}
-			putch(ch);
-		}
+	if (uio->uio_rw==UIO_READ) {
+		result = con_read(cs, uio);
+	}
+	else {
+		result = con_write(cs, uio);
 	}
+
 	lock_release(lk);
-	return 0;
+	return result;
 }
 
 static
@@ -343,7 +511,7 @@ attach_console_to_vfs(struct con_softc *cs)
 int
 config_con(struct con_softc *cs, int unit)
 {
-	struct semaphore *rsem, *wsem;
+	struct wchan *rwc, *wwc;
 	struct lock *rlk, *wlk;
 
 	/*
@@ -359,33 +527,37 @@ config_con(struct con_softc *cs, int unit)
 	}
 	KASSERT(the_console==NULL);
 
-	rsem = sem_create("console read", 0);
-	if (rsem == NULL) {
+	rwc = wchan_create("console read");
+	if (rwc == NULL) {
 		return ENOMEM;
 	}
-	wsem = sem_create("console write", 1);
-	if (wsem == NULL) {
-		sem_destroy(rsem);
+	wwc = wchan_create("console write");
+	if (wwc == NULL) {
+		wchan_destroy(rwc);
 		return ENOMEM;
 	}
 	rlk = lock_create("console-lock-read");
 	if (rlk == NULL) {
-		sem_destroy(rsem);
-		sem_destroy(wsem);
+		wchan_destroy(rwc);
+		wchan_destroy(wwc);
 		return ENOMEM;
 	}
 	wlk = lock_create("console-lock-write");
 	if (wlk == NULL) {
 		lock_destroy(rlk);
-		sem_destroy(rsem);
-		sem_destroy(wsem);
+		wchan_destroy(rwc);
+		wchan_destroy(wwc);
 		return ENOMEM;
 	}
 
-	cs->cs_rsem = rsem;
-	cs->cs_wsem = wsem;
+	spinlock_init(&cs->cs_lock);
+	cs->cs_rwchan = rwc;
+	cs->cs_wwchan = wwc;
 	cs->cs_gotchars_head = 0;
 	cs->cs_gotchars_tail = 0;
+	cs->cs_outchars_head = 0;
+	cs->cs_outchars_tail = 0;
+	cs->cs_busy = false;
 
 	the_console = cs;
 	con_userlock_read = rlk;
@@ -35,9 +35,17 @@
  *
  * devdata, send, and sendpolled are provided by the underlying
  * device, and are to be initialized by the attach routine.
+ *
+ * Output is queued in cs_outchars and fed to the device one character
+ * per write-done interrupt; writers only block when it is full. Input
+ * is queued in cs_gotchars by the read interrupt. Both rings are
+ * protected by cs_lock.
  */
 
-#define CONSOLE_INPUT_BUFFER_SIZE 32
+#include <spinlock.h>
+
+#define CONSOLE_INPUT_BUFFER_SIZE 256
+#define CONSOLE_OUTPUT_BUFFER_SIZE 1024
 
 struct con_softc {
 	/* initialized by attach routine */
@@ -46,11 +54,16 @@ struct con_softc {
 	void (*cs_sendpolled)(void *devdata, int ch);
 
 	/* initialized by config routine */
-	struct semaphore *cs_rsem;
-	struct semaphore *cs_wsem;
+	struct spinlock cs_lock;
+	struct wchan *cs_rwchan;	/* readers waiting for input */
+	struct wchan *cs_wwchan;	/* writers waiting for buffer space */
 	unsigned char cs_gotchars[CONSOLE_INPUT_BUFFER_SIZE];
 	unsigned cs_gotchars_head;	/* next slot to put a char in */
 	unsigned cs_gotchars_tail;	/* next slot to take a char out */
+	unsigned char cs_outchars[CONSOLE_OUTPUT_BUFFER_SIZE];
+	unsigned cs_outchars_head;	/* next slot to put a char in */
+	unsigned cs_outchars_tail;	/* next slot to take a char out */
+	bool cs_busy;			/* device is sending a char */
 };
 
 /*
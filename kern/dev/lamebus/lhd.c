@@ -39,6 +39,7 @@
 #include <synch.h>
 #include <platform/bus.h>
 #include <vfs.h>
+#include <trace.h>
 #include <lamebus/lhd.h>
 #include "autoconf.h"
 
@@ -194,7 +195,7 @@ lhd_io(struct device *d, struct uio *uio)
 	uint32_t lenoff = uio->uio_resid % LHD_SECTSIZE;
 	uint32_t i;
 	uint32_t statval = LHD_WORKING;
-	int result;
+	int result = 0;
 
 	/* Don't allow I/O that isn't sector-aligned. */
 	if (sectoff != 0 || lenoff != 0) {
@@ -212,6 +213,9 @@ lhd_io(struct device *d, struct uio *uio)
 		statval |= LHD_ISWRITE;
 	}
 
+	TRACE(TRACE_DISKIO, sector,
+	      len | (uio->uio_rw==UIO_WRITE ? TRACE_WRITE : 0));
+
 	/* Loop over all the sectors we were asked to do. */
 	for (i=0; i<len; i++) {
 
@@ -227,7 +231,7 @@ lhd_io(struct device *d, struct uio *uio)
 			membar_store_store();
 			if (result) {
 				V(lh->lh_clear);
-				return result;
+				break;
 			}
 		}
 
@@ -255,13 +259,14 @@ lhd_io(struct device *d, struct uio *uio)
 		/* Tell another thread it's cleared to go ahead. */
 		V(lh->lh_clear);
 
-		/* If we failed, return the error. */
+		/* If we failed, stop. */
 		if (result) {
-			return result;
+			break;
 		}
 	}
 
-	return 0;
+	TRACE(TRACE_DISKDONE, sector, result);
+	return result;
 }
 
 static const struct device_ops lhd_devops = {
@@ -34,6 +34,7 @@
 #include <lib.h>
 #include <spl.h>
 #include <clock.h>
+#include <timeout.h>
 #include <platform/bus.h>
 #include <lamebus/ltimer.h>
 #include "autoconf.h"
@@ -46,9 +47,6 @@
 #define LT_REG_COUNT  16    /* Time for countdown timer (usec) */
 #define LT_REG_SPKR   20    /* Beep control */
 
-/* Granularity of countdown timer (usec) */
-#define LT_GRANULARITY   1000000
-
 static bool havetimerclock;
 
 /*
@@ -84,17 +82,17 @@ config_ltimer(struct ltimer_softc *lt, int ltimerno)
 	lt->lt_hardclock = 0;
 
 	/*
-	 * We do, however, use ltimer for the timer clock, since the
-	 * on-chip timer can't do that.
+	 * We do, however, use ltimer to drive the timeouts (of which
+	 * timerclock is one), since the on-chip timer can't do that.
+	 * It runs one-shot, set each time for whenever the next
+	 * timeout is due.
 	 */
 	if (!havetimerclock) {
 		havetimerclock = true;
 		lt->lt_timerclock = 1;
 
-		/* Wire it to go off once every second. */
-		bus_write_register(lt->lt_bus, lt->lt_buspos, LT_REG_ROE, 1);
-		bus_write_register(lt->lt_bus, lt->lt_buspos, LT_REG_COUNT,
-				   LT_GRANULARITY);
+		bus_write_register(lt->lt_bus, lt->lt_buspos, LT_REG_ROE, 0);
+		timeout_setclock(lt, ltimer_gettime, ltimer_program);
 	}
 
 	return 0;
@@ -119,14 +117,26 @@ ltimer_irq(void *vlt)
 			hardclock();
 		}
 		/*
-		 * Likewise for timerclock.
+		 * Likewise for the timeouts.
 		 */
 		if (lt->lt_timerclock) {
-			timerclock();
+			timeout_clock();
 		}
 	}
 }
 
+/*
+ * Start the countdown timer for USECS microseconds. This replaces
+ * any countdown already going.
+ */
+void
+ltimer_program(void *vlt, uint32_t usecs)
+{
+	struct ltimer_softc *lt = vlt;
+
+	bus_write_register(lt->lt_bus, lt->lt_buspos, LT_REG_COUNT, usecs);
+}
+
 /*
  * The timer device will beep if you write to the beep register. It
  * doesn't matter what value you write. This function is called if
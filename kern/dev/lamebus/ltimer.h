@@ -38,7 +38,7 @@ struct timespec;
 struct ltimer_softc {
 	/* Initialized by config function */
 	int lt_hardclock;        /* true if we should call hardclock() */
-	int lt_timerclock;        /* true if we should call timerclock() */
+	int lt_timerclock;        /* true if we drive the timeouts */
 
 	/* Initialized by lower-level attach routine */
 	void *lt_bus;		/* bus we're on */
@@ -52,5 +52,7 @@ void ltimer_irq(/*struct ltimer_softc*/ void *lt);  // interrupt handler
 void ltimer_beep(/*struct ltimer_softc*/ void *devdata);   // for beep device
 void ltimer_gettime(/*struct ltimer_softc*/ void *devdata,
 		    struct timespec *ts);     	    // for rtclock
+void ltimer_program(/*struct ltimer_softc*/ void *devdata,
+		    uint32_t usecs);		    // for timeouts
 
 #endif /* _LAMEBUS_LTIMER_H_ */
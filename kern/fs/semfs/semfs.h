@@ -43,6 +43,7 @@
  */
 
 #define SEMFS_ROOTDIR	0xffffffffU		/* semnum for root dir */
+#define SEMFS_NHASH	64			/* name hash buckets */
 
 /*
  * A user-facing semaphore.
@@ -62,10 +63,17 @@ DECLARRAY(semfs_sem, SEMFS_INLINE);
 
 /*
  * Directory entry; name and reference to a semaphore.
+ *
+ * Entries live both in the directory array (which gives getdirentry
+ * its ordering) and on a name hash chain (which is what lookups use).
+ * semd_slot is the entry's index in the array so removal doesn't have
+ * to search for it.
  */
 struct semfs_direntry {
 	char *semd_name;			/* Name */
 	unsigned semd_semnum;			/* Which semaphore */
+	unsigned semd_slot;			/* Index in semfs_dents */
+	struct semfs_direntry *semd_hashnext;	/* Next on hash chain */
 };
 DECLARRAY(semfs_direntry, SEMFS_INLINE);
 
@@ -80,6 +88,7 @@ struct semfs_vnode {
 	struct vnode semv_absvn;		/* Abstract vnode */
 	struct semfs *semv_semfs;		/* Back-pointer to fs */
 	unsigned semv_semnum;			/* Which semaphore */
+	struct semfs_sem *semv_sem;		/* The semaphore, or NULL */
 };
 
 /*
@@ -95,6 +104,8 @@ struct semfs {
 
 	struct lock *semfs_dirlock;		/* Lock for following */
 	struct semfs_direntryarray *semfs_dents; /* The root directory */
+	unsigned semfs_dentholes;		/* NULL slots in semfs_dents */
+	struct semfs_direntry *semfs_hash[SEMFS_NHASH]; /* Name lookup */
 };
 
 /*
@@ -115,6 +126,9 @@ int semfs_sem_insert(struct semfs *, struct semfs_sem *, unsigned *);
 void semfs_sem_destroy(struct semfs_sem *);
 struct semfs_direntry *semfs_direntry_create(const char *name, unsigned semno);
 void semfs_direntry_destroy(struct semfs_direntry *);
+struct semfs_direntry *semfs_dir_find(struct semfs *, const char *name);
+void semfs_dir_hashinsert(struct semfs *, struct semfs_direntry *);
+void semfs_dir_hashremove(struct semfs *, struct semfs_direntry *);
 
 /* in semfs_vnops.c */
 int semfs_getvnode(struct semfs *, unsigned, struct vnode **ret);
@@ -186,6 +186,8 @@ semfs_create(void)
 	if (semfs->semfs_dents == NULL) {
 		goto fail_dirlock;
 	}
+	semfs->semfs_dentholes = 0;
+	bzero(semfs->semfs_hash, sizeof(semfs->semfs_hash));
 
 	semfs->semfs_absfs.fs_data = semfs;
 	semfs->semfs_absfs.fs_ops = &semfs_fsops;
@@ -131,6 +131,8 @@ semfs_direntry_create(const char *name, unsigned semnum)
 		return NULL;
 	}
 	dent->semd_semnum = semnum;
+	dent->semd_slot = 0;
+	dent->semd_hashnext = NULL;
 	return dent;
 }
 
@@ -143,3 +145,70 @@ semfs_direntry_destroy(struct semfs_direntry *dent)
 	kfree(dent->semd_name);
 	kfree(dent);
 }
+
+////////////////////////////////////////////////////////////
+// name hash
+
+/*
+ * Hash a semaphore name (FNV-1a).
+ */
+static
+unsigned
+semfs_namehash(const char *name)
+{
+	unsigned h = 2166136261U;
+
+	while (*name != '\0') {
+		h ^= (unsigned char)*name++;
+		h *= 16777619U;
+	}
+	return h % SEMFS_NHASH;
+}
+
+/*
+ * Find the directory entry for NAME, or return NULL.
+ */
+struct semfs_direntry *
+semfs_dir_find(struct semfs *semfs, const char *name)
+{
+	struct semfs_direntry *dent;
+
+	KASSERT(lock_do_i_hold(semfs->semfs_dirlock));
+	dent = semfs->semfs_hash[semfs_namehash(name)];
+	while (dent != NULL && strcmp(dent->semd_name, name) != 0) {
+		dent = dent->semd_hashnext;
+	}
+	return dent;
+}
+
+/*
+ * Put a directory entry on its hash chain.
+ */
+void
+semfs_dir_hashinsert(struct semfs *semfs, struct semfs_direntry *dent)
+{
+	unsigned h;
+
+	KASSERT(lock_do_i_hold(semfs->semfs_dirlock));
+	h = semfs_namehash(dent->semd_name);
+	dent->semd_hashnext = semfs->semfs_hash[h];
+	semfs->semfs_hash[h] = dent;
+}
+
+/*
+ * Take a directory entry off its hash chain.
+ */
+void
+semfs_dir_hashremove(struct semfs *semfs, struct semfs_direntry *dent)
+{
+	struct semfs_direntry **pp;
+
+	KASSERT(lock_do_i_hold(semfs->semfs_dirlock));
+	pp = &semfs->semfs_hash[semfs_namehash(dent->semd_name)];
+	while (*pp != dent) {
+		KASSERT(*pp != NULL);
+		pp = &(*pp)->semd_hashnext;
+	}
+	*pp = dent->semd_hashnext;
+	dent->semd_hashnext = NULL;
+}
@@ -37,10 +37,13 @@
 #include <proc.h>
 #include <current.h>
 #include <vfs.h>
+#include <fs.h>
 #include <vnode.h>
 
 #include "semfs.h"
 
+static const struct vnode_ops semfs_semops;
+
 ////////////////////////////////////////////////////////////
 // basic ops
 
@@ -106,10 +109,6 @@ semfs_fsync(struct vnode *vn)
 ////////////////////////////////////////////////////////////
 // semaphore ops
 
-/*
- * XXX fold these two together
- */
-
 static
 struct semfs_sem *
 semfs_getsembynum(struct semfs *semfs, unsigned semnum)
@@ -123,13 +122,17 @@ semfs_getsembynum(struct semfs *semfs, unsigned semnum)
 	return sem;
 }
 
+/*
+ * The semaphore behind a vnode. A semaphore is not destroyed while
+ * it has a vnode, so the pointer cached in the vnode can be used
+ * without going through the semaphore table.
+ */
 static
 struct semfs_sem *
 semfs_getsem(struct semfs_vnode *semv)
 {
-	struct semfs *semfs = semv->semv_semfs;
-
-	return semfs_getsembynum(semfs, semv->semv_semnum);
+	KASSERT(semv->semv_sem != NULL);
+	return semv->semv_sem;
 }
 
 /*
@@ -153,6 +156,65 @@ semfs_wakeup(struct semfs_sem *sem, unsigned newcount)
 	}
 }
 
+/*
+ * P(): take COUNT from the semaphore, sleeping as needed. The count
+ * is consumed piecemeal as it becomes available, as if each unit were
+ * a separate P.
+ */
+static
+void
+semfs_sem_p(struct semfs_sem *sem, unsigned semnum, unsigned count)
+{
+	unsigned consume;
+
+	lock_acquire(sem->sems_lock);
+	while (count > 0) {
+		if (sem->sems_count > 0) {
+			consume = count;
+			if (consume > sem->sems_count) {
+				consume = sem->sems_count;
+			}
+			DEBUG(DB_SEMFS, "semfs: sem%u: P, count %u -> %u\n",
+			      semnum, sem->sems_count,
+			      sem->sems_count - consume);
+			sem->sems_count -= consume;
+			count -= consume;
+		}
+		if (count == 0) {
+			break;
+		}
+		if (sem->sems_count == 0) {
+			DEBUG(DB_SEMFS, "semfs: sem%u: blocking\n", semnum);
+			cv_wait(sem->sems_cv, sem->sems_lock);
+		}
+	}
+	lock_release(sem->sems_lock);
+}
+
+/*
+ * V(): add COUNT to the semaphore.
+ */
+static
+int
+semfs_sem_v(struct semfs_sem *sem, unsigned semnum, unsigned count)
+{
+	unsigned newcount;
+
+	lock_acquire(sem->sems_lock);
+	newcount = sem->sems_count + count;
+	if (newcount < sem->sems_count) {
+		/* overflow */
+		lock_release(sem->sems_lock);
+		return EFBIG;
+	}
+	DEBUG(DB_SEMFS, "semfs: sem%u: V, count %u -> %u\n",
+	      semnum, sem->sems_count, newcount);
+	semfs_wakeup(sem, newcount);
+	sem->sems_count = newcount;
+	lock_release(sem->sems_lock);
+	return 0;
+}
+
 /*
  * stat() for semaphore vnodes
  */
@@ -189,36 +251,12 @@ int
 semfs_read(struct vnode *vn, struct uio *uio)
 {
 	struct semfs_vnode *semv = vn->vn_data;
-	struct semfs_sem *sem;
-	size_t consume;
 
-	sem = semfs_getsem(semv);
+	semfs_sem_p(semfs_getsem(semv), semv->semv_semnum, uio->uio_resid);
 
-	lock_acquire(sem->sems_lock);
-	while (uio->uio_resid > 0) {
-		if (sem->sems_count > 0) {
-			consume = uio->uio_resid;
-			if (consume > sem->sems_count) {
-				consume = sem->sems_count;
-			}
-			DEBUG(DB_SEMFS, "semfs: sem%u: P, count %u -> %u\n",
-			      semv->semv_semnum, sem->sems_count,
-			      sem->sems_count - consume);
-			sem->sems_count -= consume;
-			/* don't bother advancing the uio data pointers */
-			uio->uio_offset += consume;
-			uio->uio_resid -= consume;
-		}
-		if (uio->uio_resid == 0) {
-			break;
-		}
-		if (sem->sems_count == 0) {
-			DEBUG(DB_SEMFS, "semfs: sem%u: blocking\n",
-			      semv->semv_semnum);
-			cv_wait(sem->sems_cv, sem->sems_lock);
-		}
-	}
-	lock_release(sem->sems_lock);
+	/* don't bother advancing the uio data pointers */
+	uio->uio_offset += uio->uio_resid;
+	uio->uio_resid = 0;
 	return 0;
 }
 
@@ -231,27 +269,44 @@ int
 semfs_write(struct vnode *vn, struct uio *uio)
 {
 	struct semfs_vnode *semv = vn->vn_data;
-	struct semfs_sem *sem;
-	unsigned newcount;
+	int result;
 
-	sem = semfs_getsem(semv);
+	if (uio->uio_resid == 0) {
+		return 0;
+	}
+	result = semfs_sem_v(semfs_getsem(semv), semv->semv_semnum,
+			     uio->uio_resid);
+	if (result) {
+		return result;
+	}
+	uio->uio_offset += uio->uio_resid;
+	uio->uio_resid = 0;
+	return 0;
+}
 
-	lock_acquire(sem->sems_lock);
-	while (uio->uio_resid > 0) {
-		newcount = sem->sems_count + uio->uio_resid;
-		if (newcount < sem->sems_count) {
-			/* overflow */
-			lock_release(sem->sems_lock);
-			return EFBIG;
-		}
-		DEBUG(DB_SEMFS, "semfs: sem%u: V, count %u -> %u\n",
-		      semv->semv_semnum, sem->sems_count, newcount);
-		semfs_wakeup(sem, newcount);
-		sem->sems_count = newcount;
-		uio->uio_offset += uio->uio_resid;
-		uio->uio_resid = 0;
+/*
+ * Direct P/V for sys_sem_op: a negative DELTA is P(-DELTA), a positive
+ * one is V(DELTA). Same semantics as read and write, without the uio.
+ */
+int
+semfs_semop(struct vnode *vn, int delta)
+{
+	struct semfs_vnode *semv;
+
+	if (vn->vn_ops != &semfs_semops) {
+		return EINVAL;
+	}
+	semv = vn->vn_data;
+
+	if (delta < 0) {
+		semfs_sem_p(semfs_getsem(semv), semv->semv_semnum,
+			    0U - (unsigned)delta);
+		return 0;
+	}
+	if (delta > 0) {
+		return semfs_sem_v(semfs_getsem(semv), semv->semv_semnum,
+				   delta);
 	}
-	lock_release(sem->sems_lock);
 	return 0;
 }
 
@@ -378,7 +433,7 @@ semfs_creat(struct vnode *dirvn, const char *name, bool excl, mode_t mode,
 	struct semfs *semfs = dirsemv->semv_semfs;
 	struct semfs_direntry *dent;
 	struct semfs_sem *sem;
-	unsigned i, num, empty, semnum;
+	unsigned num, empty, semnum;
 	int result;
 
 	(void)mode;
@@ -387,27 +442,28 @@ semfs_creat(struct vnode *dirvn, const char *name, bool excl, mode_t mode,
 	}
 
 	lock_acquire(semfs->semfs_dirlock);
+	dent = semfs_dir_find(semfs, name);
+	if (dent != NULL) {
+		if (excl) {
+			lock_release(semfs->semfs_dirlock);
+			return EEXIST;
+		}
+		result = semfs_getvnode(semfs, dent->semd_semnum, resultvn);
+		lock_release(semfs->semfs_dirlock);
+		return result;
+	}
+
+	/* reuse a hole in the directory only if we know there is one */
 	num = semfs_direntryarray_num(semfs->semfs_dents);
 	empty = num;
-	for (i=0; i<num; i++) {
-		dent = semfs_direntryarray_get(semfs->semfs_dents, i);
-		if (dent == NULL) {
-			if (empty == num) {
-				empty = i;
-			}
-			continue;
-		}
-		if (!strcmp(dent->semd_name, name)) {
-			/* found */
-			if (excl) {
-				lock_release(semfs->semfs_dirlock);
-				return EEXIST;
+	if (semfs->semfs_dentholes > 0) {
+		for (empty = 0; empty < num; empty++) {
+			if (semfs_direntryarray_get(semfs->semfs_dents,
+						    empty) == NULL) {
+				break;
 			}
-			result = semfs_getvnode(semfs, dent->semd_semnum,
-						resultvn);
-			lock_release(semfs->semfs_dirlock);
-			return result;
 		}
+		KASSERT(empty < num);
 	}
 
 	/* create it */
@@ -430,6 +486,7 @@ semfs_creat(struct vnode *dirvn, const char *name, bool excl, mode_t mode,
 
 	if (empty < num) {
 		semfs_direntryarray_set(semfs->semfs_dents, empty, dent);
+		semfs->semfs_dentholes--;
 	}
 	else {
 		result = semfs_direntryarray_add(semfs->semfs_dents, dent,
@@ -438,18 +495,21 @@ semfs_creat(struct vnode *dirvn, const char *name, bool excl, mode_t mode,
 			goto fail_undent;
 		}
 	}
+	dent->semd_slot = empty;
 
 	result = semfs_getvnode(semfs, semnum, resultvn);
 	if (result) {
 		goto fail_undir;
 	}
 
+	semfs_dir_hashinsert(semfs, dent);
 	sem->sems_linked = true;
 	lock_release(semfs->semfs_dirlock);
 	return 0;
 
  fail_undir:
 	semfs_direntryarray_set(semfs->semfs_dents, empty, NULL);
+	semfs->semfs_dentholes++;
  fail_undent:
 	semfs_direntry_destroy(dent);
  fail_uninsert:
@@ -475,47 +535,41 @@ semfs_remove(struct vnode *dirvn, const char *name)
 	struct semfs *semfs = dirsemv->semv_semfs;
 	struct semfs_direntry *dent;
 	struct semfs_sem *sem;
-	unsigned i, num;
-	int result;
 
 	if (!strcmp(name, ".") || !strcmp(name, "..")) {
 		return EINVAL;
 	}
 
 	lock_acquire(semfs->semfs_dirlock);
-	num = semfs_direntryarray_num(semfs->semfs_dents);
-	for (i=0; i<num; i++) {
-		dent = semfs_direntryarray_get(semfs->semfs_dents, i);
-		if (dent == NULL) {
-			continue;
-		}
-		if (!strcmp(name, dent->semd_name)) {
-			/* found */
-			sem = semfs_getsembynum(semfs, dent->semd_semnum);
-			lock_acquire(sem->sems_lock);
-			KASSERT(sem->sems_linked);
-			sem->sems_linked = false;
-			if (sem->sems_hasvnode == false) {
-				lock_acquire(semfs->semfs_tablelock);
-				semfs_semarray_set(semfs->semfs_sems,
-						   dent->semd_semnum, NULL);
-				lock_release(semfs->semfs_tablelock);
-				lock_release(sem->sems_lock);
-				semfs_sem_destroy(sem);
-			}
-			else {
-				lock_release(sem->sems_lock);
-			}
-			semfs_direntryarray_set(semfs->semfs_dents, i, NULL);
-			semfs_direntry_destroy(dent);
-			result = 0;
-			goto out;
-		}
+	dent = semfs_dir_find(semfs, name);
+	if (dent == NULL) {
+		lock_release(semfs->semfs_dirlock);
+		return ENOENT;
 	}
-	result = ENOENT;
- out:
+
+	sem = semfs_getsembynum(semfs, dent->semd_semnum);
+	lock_acquire(sem->sems_lock);
+	KASSERT(sem->sems_linked);
+	sem->sems_linked = false;
+	if (sem->sems_hasvnode == false) {
+		lock_acquire(semfs->semfs_tablelock);
+		semfs_semarray_set(semfs->semfs_sems, dent->semd_semnum, NULL);
+		lock_release(semfs->semfs_tablelock);
+		lock_release(sem->sems_lock);
+		semfs_sem_destroy(sem);
+	}
+	else {
+		lock_release(sem->sems_lock);
+	}
+	semfs_dir_hashremove(semfs, dent);
+	KASSERT(semfs_direntryarray_get(semfs->semfs_dents,
+					dent->semd_slot) == dent);
+	semfs_direntryarray_set(semfs->semfs_dents, dent->semd_slot, NULL);
+	semfs->semfs_dentholes++;
+	semfs_direntry_destroy(dent);
+
 	lock_release(semfs->semfs_dirlock);
-	return result;
+	return 0;
 }
 
 /*
@@ -528,7 +582,6 @@ semfs_lookup(struct vnode *dirvn, char *path, struct vnode **resultvn)
 	struct semfs_vnode *dirsemv = dirvn->vn_data;
 	struct semfs *semfs = dirsemv->semv_semfs;
 	struct semfs_direntry *dent;
-	unsigned i, num;
 	int result;
 
 	if (!strcmp(path, ".") || !strcmp(path, "..")) {
@@ -538,21 +591,14 @@ semfs_lookup(struct vnode *dirvn, char *path, struct vnode **resultvn)
 	}
 
 	lock_acquire(semfs->semfs_dirlock);
-	num = semfs_direntryarray_num(semfs->semfs_dents);
-	for (i=0; i<num; i++) {
-		dent = semfs_direntryarray_get(semfs->semfs_dents, i);
-		if (dent == NULL) {
-			continue;
-		}
-		if (!strcmp(path, dent->semd_name)) {
-			result = semfs_getvnode(semfs, dent->semd_semnum,
-						resultvn);
-			lock_release(semfs->semfs_dirlock);
-			return result;
-		}
+	dent = semfs_dir_find(semfs, path);
+	if (dent == NULL) {
+		lock_release(semfs->semfs_dirlock);
+		return ENOENT;
 	}
+	result = semfs_getvnode(semfs, dent->semd_semnum, resultvn);
 	lock_release(semfs->semfs_dirlock);
-	return ENOENT;
+	return result;
 }
 
 /*
@@ -736,6 +782,7 @@ semfs_vnode_create(struct semfs *semfs, unsigned semnum)
 
 	semv->semv_semfs = semfs;
 	semv->semv_semnum = semnum;
+	semv->semv_sem = NULL;
 
 	result = vnode_init(&semv->semv_absvn, optable,
 			    &semfs->semfs_absfs, semv);
@@ -791,6 +838,7 @@ semfs_getvnode(struct semfs *semfs, unsigned semnum, struct vnode **ret)
 		KASSERT(sem != NULL);
 		KASSERT(sem->sems_hasvnode == false);
 		sem->sems_hasvnode = true;
+		semv->semv_sem = sem;
 	}
 	lock_release(semfs->semfs_tablelock);
 
@@ -33,6 +33,7 @@
  * Block allocation.
  */
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <bitmap.h>
 #include <sfs.h>
@@ -52,18 +53,36 @@ sfs_clearblock(struct sfs_fs *sfs, daddr_t block)
 }
 
 /*
- * Allocate a block.
+ * Allocation groups.
+ *
+ * The volume is divided into groups of SFS_GROUPBLOCKS blocks (one
+ * freemap block's worth). The first SFS_GROUPINODES blocks of each
+ * group are preferred for inodes and the rest for file data. New
+ * inodes go in their directory's group, so a directory's inodes are
+ * close together and close to it, and file data goes after the
+ * inode area of the inode's group, each block following the one
+ * before it in the file. This is only a placement policy; any block
+ * can still be used for anything when space runs short.
  */
+#define SFS_GROUPBLOCKS		SFS_BITSPERBLOCK
+#define SFS_GROUPINODES		256
+
+/*
+ * Allocate the first free block in START..END-1.
+ */
+static
 int
-sfs_balloc(struct sfs_fs *sfs, daddr_t *diskblock)
+sfs_balloc_range(struct sfs_fs *sfs, daddr_t start, daddr_t end,
+		 daddr_t *diskblock)
 {
 	int result;
 
-	result = bitmap_alloc(sfs->sfs_freemap, diskblock);
+	result = bitmap_alloc_range(sfs->sfs_freemap, start, end, diskblock);
 	if (result) {
 		return result;
 	}
 	sfs->sfs_freemapdirty = true;
+	sfs_jfreemapdirty(sfs, *diskblock);
 
 	if (*diskblock >= sfs->sfs_sb.sb_nblocks) {
 		panic("sfs: %s: balloc: invalid block %u\n",
@@ -78,13 +97,89 @@ sfs_balloc(struct sfs_fs *sfs, daddr_t *diskblock)
 	return result;
 }
 
+/*
+ * Allocate a block, preferably GOAL or the first free one after it.
+ */
+int
+sfs_balloc(struct sfs_fs *sfs, daddr_t goal, daddr_t *diskblock)
+{
+	int result;
+
+	if (goal >= sfs->sfs_sb.sb_nblocks) {
+		goal = 0;
+	}
+	result = sfs_balloc_range(sfs, goal, sfs->sfs_sb.sb_nblocks,
+				  diskblock);
+	if (result == ENOSPC && goal > 0) {
+		result = sfs_balloc_range(sfs, 0, goal, diskblock);
+	}
+	return result;
+}
+
+/*
+ * Allocate a block for a new inode in directory DIRINO. Look in the
+ * inode area of the directory's group, then of the groups after it;
+ * if they're all full, take whatever's free.
+ */
+int
+sfs_ialloc(struct sfs_fs *sfs, uint32_t dirino, uint32_t *ino)
+{
+	uint32_t nblocks = sfs->sfs_sb.sb_nblocks;
+	uint32_t ngroups = DIVROUNDUP(nblocks, SFS_GROUPBLOCKS);
+	uint32_t g, i, start;
+	int result;
+
+	g = dirino / SFS_GROUPBLOCKS;
+	for (i=0; i<ngroups; i++) {
+		start = ((g + i) % ngroups) * SFS_GROUPBLOCKS;
+		result = sfs_balloc_range(sfs, start, start + SFS_GROUPINODES,
+					  ino);
+		if (result != ENOSPC) {
+			return result;
+		}
+	}
+	return sfs_balloc(sfs, dirino, ino);
+}
+
+/*
+ * Where to put the first data block of inode INO: just past the inode
+ * area of its group.
+ */
+daddr_t
+sfs_datagoal(struct sfs_fs *sfs, uint32_t ino)
+{
+	daddr_t goal;
+
+	goal = (ino / SFS_GROUPBLOCKS) * SFS_GROUPBLOCKS + SFS_GROUPINODES;
+	if (goal <= ino || goal >= sfs->sfs_sb.sb_nblocks) {
+		goal = ino + 1;
+	}
+	return goal;
+}
+
 /*
  * Free a block.
  */
 void
 sfs_bfree(struct sfs_fs *sfs, daddr_t diskblock)
 {
-	bitmap_unmark(sfs->sfs_freemap, diskblock);
+	sfs_bfree_run(sfs, diskblock, 1);
+}
+
+/*
+ * Free COUNT consecutive blocks starting at START. With a journal,
+ * they stay allocated until the transaction freeing them commits.
+ */
+void
+sfs_bfree_run(struct sfs_fs *sfs, daddr_t start, uint32_t count)
+{
+	KASSERT(start + count <= sfs->sfs_sb.sb_nblocks);
+
+	if (sfs->sfs_journal != NULL) {
+		sfs_jfree(sfs, start, count);
+		return;
+	}
+	bitmap_unmark_range(sfs->sfs_freemap, start, count);
 	sfs->sfs_freemapdirty = true;
 }
 
@@ -50,11 +50,8 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 	 daddr_t *diskblock)
 {
 	/*
-	 * I/O buffer for handling indirect blocks.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
+	 * I/O buffer for handling indirect blocks, used only if we
+	 * can't get memory to cache the vnode's indirect block.
 	 */
 	static uint32_t idbuf[SFS_DBPERIDB];
 
@@ -62,6 +59,7 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 	daddr_t block;
 	daddr_t idblock;
 	uint32_t idnum, idoff;
+	uint32_t *ib;
 	int result;
 
 	KASSERT(sizeof(idbuf)==SFS_BLOCKSIZE);
@@ -69,6 +67,9 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 	/* Since we're using a static buffer, we'd better be locked. */
 	KASSERT(vfs_biglock_do_i_hold());
 
+	/* Inline files have no blocks to map */
+	KASSERT((sv->sv_i.sfi_flags & SFS_DINODE_INLINE) == 0);
+
 	/*
 	 * If the block we want is one of the direct blocks...
 	 */
@@ -79,10 +80,18 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		block = sv->sv_i.sfi_direct[fileblock];
 
 		/*
-		 * Do we need to allocate?
+		 * Do we need to allocate? If so, try to put it right
+		 * after the previous block of the file.
 		 */
 		if (block==0 && doalloc) {
-			result = sfs_balloc(sfs, &block);
+			if (fileblock > 0 &&
+			    sv->sv_i.sfi_direct[fileblock-1] != 0) {
+				block = sv->sv_i.sfi_direct[fileblock-1] + 1;
+			}
+			else {
+				block = sfs_datagoal(sfs, sv->sv_ino);
+			}
+			result = sfs_balloc(sfs, block, &block);
 			if (result) {
 				return result;
 			}
@@ -127,6 +136,17 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 	/* Get the disk block number of the indirect block. */
 	idblock = sv->sv_i.sfi_indirect;
 
+	/*
+	 * Keep the vnode's indirect block in memory, so that walking
+	 * through a large file doesn't read it again for every data
+	 * block. The copy is write-through: changes below go to disk
+	 * (or the journal) right away, and sfs_itrunc drops it.
+	 */
+	if (sv->sv_ibuf == NULL) {
+		sv->sv_ibuf = kmalloc(SFS_BLOCKSIZE);
+	}
+	ib = sv->sv_ibuf != NULL ? sv->sv_ibuf : idbuf;
+
 	if (idblock==0 && !doalloc) {
 		/*
 		 * There's no indirect block allocated. We weren't
@@ -143,7 +163,13 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		 * the indirect block. Thus, we need to allocate an
 		 * indirect block.
 		 */
-		result = sfs_balloc(sfs, &idblock);
+		if (sv->sv_i.sfi_direct[SFS_NDIRECT-1] != 0) {
+			idblock = sv->sv_i.sfi_direct[SFS_NDIRECT-1] + 1;
+		}
+		else {
+			idblock = sfs_datagoal(sfs, sv->sv_ino);
+		}
+		result = sfs_balloc(sfs, idblock, &idblock);
 		if (result) {
 			return result;
 		}
@@ -155,34 +181,46 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		sv->sv_dirty = true;
 
 		/* Clear the indirect block buffer */
-		bzero(idbuf, sizeof(idbuf));
+		bzero(ib, SFS_BLOCKSIZE);
+		if (ib == sv->sv_ibuf) {
+			sv->sv_iblock = idblock;
+		}
 	}
-	else {
+	else if (ib != sv->sv_ibuf || sv->sv_iblock != idblock) {
 		/*
-		 * We already have an indirect block allocated; load it.
+		 * We already have an indirect block allocated, but
+		 * not in memory; load it.
 		 */
-		result = sfs_readblock(sfs, idblock, idbuf, sizeof(idbuf));
+		sv->sv_iblock = 0;
+		result = sfs_readblock(sfs, idblock, ib, SFS_BLOCKSIZE);
 		if (result) {
 			return result;
 		}
+		if (ib == sv->sv_ibuf) {
+			sv->sv_iblock = idblock;
+		}
 	}
 
 	/* Get the block out of the indirect block buffer */
-	block = idbuf[idoff];
+	block = ib[idoff];
 
 	/* If there's no block there, allocate one */
 	if (block==0 && doalloc) {
-		result = sfs_balloc(sfs, &block);
+		block = (idoff > 0 && ib[idoff-1] != 0) ?
+			ib[idoff-1] + 1 : idblock + 1;
+		result = sfs_balloc(sfs, block, &block);
 		if (result) {
 			return result;
 		}
 
 		/* Remember the block we allocated */
-		idbuf[idoff] = block;
+		ib[idoff] = block;
 
 		/* The indirect block is now dirty; write it back */
-		result = sfs_writeblock(sfs, idblock, idbuf, sizeof(idbuf));
+		result = sfs_jwrite(sfs, idblock, ib, SFS_BLOCKSIZE);
 		if (result) {
+			/* the cached copy no longer matches the disk */
+			sv->sv_iblock = 0;
 			return result;
 		}
 	}
@@ -197,6 +235,40 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 	return 0;
 }
 
+/*
+ * Blocks freed by sfs_itrunc are collected into runs of consecutive
+ * block numbers so each run can be freed in one go. Since sfs_balloc
+ * hands out the lowest free block, a file written front to back is
+ * mostly one or a few runs.
+ */
+struct sfs_freerun {
+	daddr_t fr_start;
+	uint32_t fr_count;
+};
+
+static
+void
+sfs_freerun_flush(struct sfs_fs *sfs, struct sfs_freerun *fr)
+{
+	if (fr->fr_count > 0) {
+		sfs_bfree_run(sfs, fr->fr_start, fr->fr_count);
+		fr->fr_count = 0;
+	}
+}
+
+static
+void
+sfs_freerun_add(struct sfs_fs *sfs, struct sfs_freerun *fr, daddr_t block)
+{
+	if (fr->fr_count > 0 && block == fr->fr_start + fr->fr_count) {
+		fr->fr_count++;
+		return;
+	}
+	sfs_freerun_flush(sfs, fr);
+	fr->fr_start = block;
+	fr->fr_count = 1;
+}
+
 /*
  * Called for ftruncate() and from sfs_reclaim.
  */
@@ -204,11 +276,8 @@ int
 sfs_itrunc(struct sfs_vnode *sv, off_t len)
 {
 	/*
-	 * I/O buffer for handling the indirect block.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
+	 * I/O buffer for handling the indirect block, if sfs_bmap
+	 * hasn't got it cached.
 	 */
 	static uint32_t idbuf[SFS_DBPERIDB];
 
@@ -217,6 +286,8 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 	/* Length in blocks (divide rounding up) */
 	uint32_t blocklen = DIVROUNDUP(len, SFS_BLOCKSIZE);
 
+	struct sfs_freerun fr;
+	uint32_t *ib;
 	uint32_t i, j;
 	daddr_t block, idblock;
 	uint32_t baseblock, highblock;
@@ -227,6 +298,31 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 
 	vfs_biglock_acquire();
 
+	/*
+	 * Inline files just zero the tail, unless they're being
+	 * extended too far to stay inline.
+	 */
+	if (sv->sv_i.sfi_flags & SFS_DINODE_INLINE) {
+		if (len <= SFS_INLINESIZE) {
+			if (len < sv->sv_i.sfi_size) {
+				bzero(SFS_INLINEDATA(&sv->sv_i) + len,
+				      sv->sv_i.sfi_size - len);
+			}
+			sv->sv_i.sfi_size = len;
+			sv->sv_dirty = true;
+			vfs_biglock_release();
+			return 0;
+		}
+		result = sfs_promote(sv);
+		if (result) {
+			vfs_biglock_release();
+			return result;
+		}
+	}
+
+	fr.fr_start = 0;
+	fr.fr_count = 0;
+
 	/*
 	 * Go through the direct blocks. Discard any that are
 	 * past the limit we're truncating to.
@@ -234,7 +330,7 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 	for (i=0; i<SFS_NDIRECT; i++) {
 		block = sv->sv_i.sfi_direct[i];
 		if (i >= blocklen && block != 0) {
-			sfs_bfree(sfs, block);
+			sfs_freerun_add(sfs, &fr, block);
 			sv->sv_i.sfi_direct[i] = 0;
 			sv->sv_dirty = true;
 		}
@@ -249,55 +345,70 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 	/* The highest block in the indirect block */
 	highblock = baseblock + SFS_DBPERIDB - 1;
 
-	if (blocklen < highblock && idblock != 0) {
+	if (blocklen <= highblock && idblock != 0) {
 		/* We're past the proposed EOF; may need to free stuff */
 
-		/* Read the indirect block */
-		result = sfs_readblock(sfs, idblock, idbuf, sizeof(idbuf));
-		if (result) {
-			vfs_biglock_release();
-			return result;
+		/* Use sfs_bmap's copy of the indirect block if it has one */
+		if (sv->sv_ibuf != NULL && sv->sv_iblock == idblock) {
+			ib = sv->sv_ibuf;
+		}
+		else {
+			ib = idbuf;
+			result = sfs_readblock(sfs, idblock, ib, SFS_BLOCKSIZE);
+			if (result) {
+				sfs_freerun_flush(sfs, &fr);
+				vfs_biglock_release();
+				return result;
+			}
 		}
 
 		hasnonzero = 0;
 		iddirty = 0;
 		for (j=0; j<SFS_DBPERIDB; j++) {
 			/* Discard any blocks that are past the new EOF */
-			if (blocklen < baseblock+j && idbuf[j] != 0) {
-				sfs_bfree(sfs, idbuf[j]);
-				idbuf[j] = 0;
+			if (blocklen <= baseblock+j && ib[j] != 0) {
+				sfs_freerun_add(sfs, &fr, ib[j]);
+				ib[j] = 0;
 				iddirty = 1;
 			}
 			/* Remember if we see any nonzero blocks in here */
-			if (idbuf[j]!=0) {
+			if (ib[j]!=0) {
 				hasnonzero=1;
 			}
 		}
 
 		if (!hasnonzero) {
 			/* The whole indirect block is empty now; free it */
-			sfs_bfree(sfs, idblock);
+			sfs_freerun_add(sfs, &fr, idblock);
 			sv->sv_i.sfi_indirect = 0;
+			sv->sv_iblock = 0;
 			sv->sv_dirty = true;
 		}
 		else if (iddirty) {
 			/* The indirect block is dirty; write it back */
-			result = sfs_writeblock(sfs, idblock, idbuf,
-						sizeof(idbuf));
+			result = sfs_jwrite(sfs, idblock, ib, SFS_BLOCKSIZE);
 			if (result) {
+				sv->sv_iblock = 0;
+				sfs_freerun_flush(sfs, &fr);
 				vfs_biglock_release();
 				return result;
 			}
 		}
 	}
+	sfs_freerun_flush(sfs, &fr);
 
 	/* Set the file size */
 	sv->sv_i.sfi_size = len;
 
+	/* An empty file has no blocks left; it can go back to inline */
+	if (len == 0) {
+		KASSERT(sv->sv_i.sfi_indirect == 0);
+		sv->sv_i.sfi_flags |= SFS_DINODE_INLINE;
+	}
+
 	/* Mark the inode dirty */
 	sv->sv_dirty = true;
 
 	vfs_biglock_release();
 	return 0;
 }
-
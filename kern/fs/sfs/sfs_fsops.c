@@ -215,6 +215,13 @@ sfs_sync(struct fs *fs)
 		return result;
 	}
 
+	/* Commit the journal; this takes care of the freemap too. */
+	result = sfs_jcommit(sfs);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
 	/* If the free block map needs to be written, write it. */
 	result = sfs_sync_freemap(sfs);
 	if (result) {
@@ -259,6 +266,7 @@ static
 void
 sfs_fs_destroy(struct sfs_fs *sfs)
 {
+	sfs_junmount(sfs);
 	if (sfs->sfs_freemap != NULL) {
 		bitmap_destroy(sfs->sfs_freemap);
 	}
@@ -360,6 +368,9 @@ sfs_fs_create(void)
 	sfs->sfs_freemap = NULL;
 	sfs->sfs_freemapdirty = false;
 
+	/* journal */
+	sfs->sfs_journal = NULL;
+
 	return sfs;
 
 cleanup_object:
@@ -448,6 +459,15 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	/* Ensure null termination of the volume name */
 	sfs->sfs_sb.sb_volname[sizeof(sfs->sfs_sb.sb_volname)-1] = 0;
 
+	/* Set up the journal; this replays it if needed */
+	result = sfs_jmount(sfs);
+	if (result) {
+		sfs->sfs_device = NULL;
+		sfs_fs_destroy(sfs);
+		vfs_biglock_release();
+		return result;
+	}
+
 	/* Load free block bitmap */
 	sfs->sfs_freemap = bitmap_create(SFS_FS_FREEMAPBITS(sfs));
 	if (sfs->sfs_freemap == NULL) {
@@ -50,8 +50,8 @@ sfs_sync_inode(struct sfs_vnode *sv)
 	int result;
 
 	if (sv->sv_dirty) {
-		result = sfs_writeblock(sfs, sv->sv_ino, &sv->sv_i,
-					sizeof(sv->sv_i));
+		result = sfs_jwrite(sfs, sv->sv_ino, &sv->sv_i,
+				    sizeof(sv->sv_i));
 		if (result) {
 			return result;
 		}
@@ -93,10 +93,17 @@ sfs_reclaim(struct vnode *v)
 	}
 	spinlock_release(&v->vn_countlock);
 
+	result = sfs_jbegin(sfs);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
 	/* If there are no on-disk references to the file either, erase it. */
 	if (sv->sv_i.sfi_linkcount == 0) {
 		result = sfs_itrunc(sv, 0);
 		if (result) {
+			sfs_jend(sfs);
 			vfs_biglock_release();
 			return result;
 		}
@@ -105,6 +112,7 @@ sfs_reclaim(struct vnode *v)
 	/* Sync the inode to disk */
 	result = sfs_sync_inode(sv);
 	if (result) {
+		sfs_jend(sfs);
 		vfs_biglock_release();
 		return result;
 	}
@@ -114,6 +122,8 @@ sfs_reclaim(struct vnode *v)
 		sfs_bfree(sfs, sv->sv_ino);
 	}
 
+	sfs_jend(sfs);
+
 	/* Remove the vnode structure from the table in the struct sfs_fs. */
 	num = vnodearray_num(sfs->sfs_vnodes);
 	ix = num;
@@ -136,6 +146,9 @@ sfs_reclaim(struct vnode *v)
 	vfs_biglock_release();
 
 	/* Release the storage for the vnode structure itself. */
+	if (sv->sv_ibuf != NULL) {
+		kfree(sv->sv_ibuf);
+	}
 	kfree(sv);
 
 	/* Done */
@@ -205,14 +218,21 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 	/* Not dirty yet */
 	sv->sv_dirty = false;
 
+	/* No indirect block cached until sfs_bmap wants one */
+	sv->sv_ibuf = NULL;
+	sv->sv_iblock = 0;
+	sv->sv_iothread = NULL;
+
 	/*
 	 * FORCETYPE is set if we're creating a new file, because the
 	 * block on disk will have been zeroed out by sfs_balloc and
 	 * thus the type recorded there will be SFS_TYPE_INVAL.
+	 * New objects start out with their (empty) data inline.
 	 */
 	if (forcetype != SFS_TYPE_INVAL) {
 		KASSERT(sv->sv_i.sfi_type == SFS_TYPE_INVAL);
 		sv->sv_i.sfi_type = forcetype;
+		sv->sv_i.sfi_flags = SFS_DINODE_INLINE;
 		sv->sv_dirty = true;
 	}
 
@@ -256,20 +276,23 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 }
 
 /*
- * Create a new filesystem object and hand back its vnode.
+ * Create a new filesystem object in directory DIRINO and hand back
+ * its vnode.
  */
 int
-sfs_makeobj(struct sfs_fs *sfs, int type, struct sfs_vnode **ret)
+sfs_makeobj(struct sfs_fs *sfs, int type, uint32_t dirino,
+	    struct sfs_vnode **ret)
 {
 	uint32_t ino;
 	int result;
 
 	/*
 	 * First, get an inode. (Each inode is a block, and the inode
-	 * number is the block number, so just get a block.)
+	 * number is the block number, so just get a block, preferably
+	 * near the directory.)
 	 */
 
-	result = sfs_balloc(sfs, &ino);
+	result = sfs_ialloc(sfs, dirino, &ino);
 	if (result) {
 		return result;
 	}
@@ -39,6 +39,7 @@
 #include <vfs.h>
 #include <device.h>
 #include <sfs.h>
+#include <trace.h>
 #include "sfsprivate.h"
 
 ////////////////////////////////////////////////////////////
@@ -102,7 +103,8 @@ sfs_rwblock(struct sfs_fs *sfs, struct uio *uio)
 }
 
 /*
- * Read a block.
+ * Read a block. If the journal has a newer copy that hasn't been
+ * written home yet, that's what we want.
  */
 int
 sfs_readblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len)
@@ -112,6 +114,10 @@ sfs_readblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len)
 
 	KASSERT(len == SFS_BLOCKSIZE);
 
+	if (sfs_jread(sfs, block, data)) {
+		return 0;
+	}
+
 	SFSUIO(&iov, &ku, data, block, UIO_READ);
 	return sfs_rwblock(sfs, &ku);
 }
@@ -131,6 +137,84 @@ sfs_writeblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len)
 	return sfs_rwblock(sfs, &ku);
 }
 
+////////////////////////////////////////////////////////////
+//
+// Inline data
+
+/*
+ * Do I/O to the data of an inline file. The region must lie inside
+ * the inode.
+ */
+static
+int
+sfs_inlineio(struct sfs_vnode *sv, struct uio *uio)
+{
+	KASSERT(sv->sv_i.sfi_flags & SFS_DINODE_INLINE);
+	KASSERT(uio->uio_offset + uio->uio_resid <= SFS_INLINESIZE);
+
+	if (uio->uio_rw == UIO_WRITE) {
+		sv->sv_dirty = true;
+	}
+	return uiomove(SFS_INLINEDATA(&sv->sv_i) + uio->uio_offset,
+		       uio->uio_resid, uio);
+}
+
+/*
+ * Move an inline file's data out to a block of its own so it can
+ * grow past SFS_INLINESIZE. Directory blocks are metadata and go
+ * through the journal; file data is written in place.
+ */
+int
+sfs_promote(struct sfs_vnode *sv)
+{
+	/* Same deal as the static buffers below */
+	static char pbuf[SFS_BLOCKSIZE];
+
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	char *data = SFS_INLINEDATA(&sv->sv_i);
+	uint32_t size = sv->sv_i.sfi_size;
+	daddr_t diskblock;
+	int result;
+
+	KASSERT(vfs_biglock_do_i_hold());
+	KASSERT(sv->sv_i.sfi_flags & SFS_DINODE_INLINE);
+	KASSERT(size <= SFS_INLINESIZE);
+
+	/* The block pointers share space with the data; clear them first */
+	bzero(pbuf, sizeof(pbuf));
+	memcpy(pbuf, data, size);
+	bzero(data, SFS_INLINESIZE);
+	sv->sv_i.sfi_flags &= ~SFS_DINODE_INLINE;
+	sv->sv_dirty = true;
+
+	if (size == 0) {
+		return 0;
+	}
+
+	result = sfs_bmap(sv, 0, true, &diskblock);
+	if (result) {
+		goto fail;
+	}
+
+	if (sv->sv_i.sfi_type == SFS_TYPE_DIR) {
+		result = sfs_jwrite(sfs, diskblock, pbuf, sizeof(pbuf));
+	}
+	else {
+		result = sfs_writeblock(sfs, diskblock, pbuf, sizeof(pbuf));
+	}
+	if (result) {
+		sfs_bfree(sfs, diskblock);
+		sv->sv_i.sfi_direct[0] = 0;
+		goto fail;
+	}
+	return 0;
+
+ fail:
+	memcpy(data, pbuf, size);
+	sv->sv_i.sfi_flags |= SFS_DINODE_INLINE;
+	return result;
+}
+
 ////////////////////////////////////////////////////////////
 //
 // File-level I/O
@@ -319,6 +403,25 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 		}
 	}
 
+	TRACE(TRACE_SFSIO, sv->sv_ino,
+	      uio->uio_resid | (uio->uio_rw==UIO_WRITE ? TRACE_WRITE : 0));
+
+	/*
+	 * Inline files are done right here, unless a write is going
+	 * to make them too big, in which case they become normal files.
+	 */
+	if (sv->sv_i.sfi_flags & SFS_DINODE_INLINE) {
+		if (uio->uio_rw == UIO_READ ||
+		    uio->uio_offset + uio->uio_resid <= SFS_INLINESIZE) {
+			result = sfs_inlineio(sv, uio);
+			goto out;
+		}
+		result = sfs_promote(sv);
+		if (result) {
+			goto out;
+		}
+	}
+
 	/*
 	 * First, do any leading partial block.
 	 */
@@ -384,6 +487,8 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 	/* Add in any extra amount we couldn't read because of EOF */
 	uio->uio_resid += extraresid;
 
+	TRACE(TRACE_SFSDONE, sv->sv_ino, result);
+
 	/* Done */
 	return result;
 }
@@ -426,6 +531,36 @@ sfs_metaio(struct sfs_vnode *sv, off_t actualpos, void *data, size_t len,
 	/* We're using a global static buffer; it had better be locked */
 	KASSERT(vfs_biglock_do_i_hold());
 
+	endpos = actualpos + len;
+
+	/* Small directories keep their entries in the inode */
+	if (sv->sv_i.sfi_flags & SFS_DINODE_INLINE) {
+		char *inl = SFS_INLINEDATA(&sv->sv_i);
+
+		if (rw == UIO_READ) {
+			if (endpos <= SFS_INLINESIZE) {
+				memcpy(data, inl + actualpos, len);
+			}
+			else {
+				/* past EOF */
+				bzero(data, len);
+			}
+			return 0;
+		}
+		if (endpos <= SFS_INLINESIZE) {
+			memcpy(inl + actualpos, data, len);
+			if (endpos > (off_t)sv->sv_i.sfi_size) {
+				sv->sv_i.sfi_size = endpos;
+			}
+			sv->sv_dirty = true;
+			return 0;
+		}
+		result = sfs_promote(sv);
+		if (result) {
+			return result;
+		}
+	}
+
 	/* Figure out which block of the vnode (directory, whatever) this is */
 	vnblock = actualpos / SFS_BLOCKSIZE;
 	blockoffset = actualpos % SFS_BLOCKSIZE;
@@ -461,14 +596,13 @@ sfs_metaio(struct sfs_vnode *sv, off_t actualpos, void *data, size_t len,
 		memcpy(metaiobuf + blockoffset, data, len);
 
 		/* Write the block back */
-		result = sfs_writeblock(sfs, diskblock,
-					metaiobuf, sizeof(metaiobuf));
+		result = sfs_jwrite(sfs, diskblock,
+				    metaiobuf, sizeof(metaiobuf));
 		if (result) {
 			return result;
 		}
 
 		/* Update the vnode size if needed */
-		endpos = actualpos + len;
 		if (endpos > (off_t)sv->sv_i.sfi_size) {
 			sv->sv_i.sfi_size = endpos;
 			sv->sv_dirty = true;
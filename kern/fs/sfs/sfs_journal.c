@@ -0,0 +1,880 @@
+/*
+ * SFS filesystem
+ *
+ * Metadata journal.
+ *
+ * Metadata updates (inodes, directory blocks, indirect blocks, and
+ * the freemap) are collected in memory in a running transaction
+ * instead of being written in place. Each operation that changes
+ * metadata is bracketed by sfs_jbegin/sfs_jend; transactions are only
+ * committed between operations, so each one takes the volume from one
+ * consistent state to another.
+ *
+ * A commit writes the transaction's blocks to the journal area,
+ * followed by a commit block, then writes them to their home
+ * locations, then advances the sequence number in the journal header
+ * so the transaction won't be replayed again. If we crash anywhere in
+ * there, the mount code replays whatever committed transaction is in
+ * the journal, which costs at most one transaction's worth of I/O no
+ * matter how big the volume is.
+ *
+ * Commits are grouped: a transaction stays open across operations
+ * until enough have accumulated, it gets old, it fills up, or someone
+ * syncs. A block changed many times while the transaction is open is
+ * written once, so e.g. a burst of creates in one directory costs one
+ * write of the directory block, not one per create. Age is measured
+ * with a timeout armed when the first operation begins; since that
+ * fires in interrupt context, it wakes a per-volume thread to do the
+ * commit, so the last changes before the volume goes quiet still get
+ * committed.
+ *
+ * Blocks freed during a transaction stay marked in use until it
+ * commits, so they can't be handed out again and overwritten with
+ * file data while the on-disk metadata may still point at them.
+ *
+ * The freemap is logged at commit time: allocating or freeing just
+ * notes which freemap block changed.
+ *
+ * Everything here runs under the VFS big lock.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <bitmap.h>
+#include <synch.h>
+#include <thread.h>
+#include <timeout.h>
+#include <vfs.h>
+#include <sfs.h>
+#include "sfsprivate.h"
+
+#define SFS_JMAXTXN	128	/* most blocks in one transaction, */
+				/* not counting the freemap */
+#define SFS_JOPBLOCKS	16	/* most non-freemap blocks per operation */
+#define SFS_JOPFREES	(2 * (SFS_NDIRECT + SFS_DBPERIDB + 2))
+				/* most free runs per operation (two itruncs) */
+#define SFS_JMAXFREES	(2 * SFS_JOPFREES)
+#define SFS_JGROUPOPS	64	/* commit after this many operations... */
+#define SFS_JGROUPSECS	1	/* ...or once the transaction is this old */
+#define SFS_JNHASH	32	/* hash buckets for logged blocks */
+
+/*
+ * A run of blocks to free when the running transaction commits.
+ */
+struct sfs_jfreerun {
+	daddr_t jf_start;
+	uint32_t jf_count;
+};
+
+/*
+ * The thread that commits transactions once they're old. It is
+ * separate from the journal so that unmount can let it go without
+ * waiting for it: it frees itself once it sees js_stop.
+ */
+struct sfs_jsyncer {
+	struct semaphore *js_sem;	/* V'd when there's work */
+	struct sfs_fs *js_sfs;
+	bool js_stop;			/* volume going away; exit */
+};
+
+/*
+ * A block in the running transaction.
+ */
+struct sfs_jblock {
+	daddr_t jb_block;		/* home location */
+	int jb_hashnext;		/* next in hash chain, or -1 */
+	char jb_data[SFS_BLOCKSIZE];	/* current contents */
+};
+
+struct sfs_journal {
+	daddr_t j_start;		/* first block of journal area */
+	uint32_t j_nblocks;		/* size of journal area */
+	uint32_t j_seq;			/* sequence number of running txn */
+	unsigned j_maxtxn;		/* most blocks that fit in the area */
+
+	unsigned j_depth;		/* sfs_jbegin nesting */
+	unsigned j_nops;		/* operations in running txn */
+	bool j_commitwanted;		/* commit when the operation ends */
+	struct timeout j_timeout;	/* running txn is old */
+	struct sfs_jsyncer *j_syncer;
+
+	struct sfs_jblock *j_blocks;	/* logged blocks */
+	unsigned j_nlogged;
+	int j_hash[SFS_JNHASH];
+
+	struct sfs_jfreerun j_frees[SFS_JMAXFREES]; /* deferred frees */
+	unsigned j_nfrees;
+
+	struct bitmap *j_fmdirty;	/* changed freemap blocks */
+	uint32_t j_fmblocks;		/* size of freemap in blocks */
+};
+
+////////////////////////////////////////////////////////////
+// Running transaction
+
+/*
+ * Forget everything in the running transaction.
+ */
+static
+void
+sfs_jreset(struct sfs_journal *j)
+{
+	unsigned i;
+
+	j->j_nlogged = 0;
+	j->j_nops = 0;
+	j->j_commitwanted = false;
+	timeout_cancel(&j->j_timeout);
+	for (i=0; i<SFS_JNHASH; i++) {
+		j->j_hash[i] = -1;
+	}
+}
+
+/*
+ * Find BLOCK in the running transaction, or return NULL.
+ */
+static
+struct sfs_jblock *
+sfs_jfind(struct sfs_journal *j, daddr_t block)
+{
+	int ix;
+
+	for (ix = j->j_hash[block % SFS_JNHASH]; ix >= 0;
+	     ix = j->j_blocks[ix].jb_hashnext) {
+		if (j->j_blocks[ix].jb_block == block) {
+			return &j->j_blocks[ix];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Put a copy of DATA, the new contents of BLOCK, in the running
+ * transaction, replacing any earlier copy.
+ */
+static
+void
+sfs_jlog(struct sfs_fs *sfs, daddr_t block, const void *data)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	struct sfs_jblock *jb;
+	unsigned h;
+
+	jb = sfs_jfind(j, block);
+	if (jb == NULL) {
+		if (j->j_nlogged >= j->j_maxtxn) {
+			panic("sfs: %s: journal transaction overflow\n",
+			      sfs->sfs_sb.sb_volname);
+		}
+		h = block % SFS_JNHASH;
+		jb = &j->j_blocks[j->j_nlogged];
+		jb->jb_block = block;
+		jb->jb_hashnext = j->j_hash[h];
+		j->j_hash[h] = j->j_nlogged;
+		j->j_nlogged++;
+	}
+	memcpy(jb->jb_data, data, SFS_BLOCKSIZE);
+}
+
+/*
+ * Check if a new operation is guaranteed to fit in the running
+ * transaction, including the freemap blocks logged at commit.
+ */
+static
+bool
+sfs_jroom(struct sfs_journal *j)
+{
+	return j->j_nlogged + SFS_JOPBLOCKS + j->j_fmblocks <= j->j_maxtxn
+		&& j->j_nfrees + SFS_JOPFREES <= SFS_JMAXFREES;
+}
+
+////////////////////////////////////////////////////////////
+// Journal I/O
+
+/* FNV-1a, continued from H */
+static
+uint32_t
+sfs_jcksum(uint32_t h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		h ^= p[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static
+int
+sfs_jwriteheader(struct sfs_fs *sfs)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	struct sfs_jheader jh;
+
+	bzero(&jh, sizeof(jh));
+	jh.jh_magic = SFS_JMAGIC_HEADER;
+	jh.jh_seq = j->j_seq;
+	return sfs_writeblock(sfs, j->j_start, &jh, sizeof(jh));
+}
+
+/*
+ * Write the running transaction to the journal area.
+ */
+static
+int
+sfs_jwritelog(struct sfs_fs *sfs)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	struct sfs_jdesc jd;
+	struct sfs_jcommit jc;
+	uint32_t cksum = 2166136261U;
+	daddr_t pos;
+	unsigned i, k, n;
+	int result;
+
+	KASSERT(sizeof(jd) == SFS_BLOCKSIZE);
+
+	pos = j->j_start + 1;
+	for (i=0; i<j->j_nlogged; i+=n) {
+		n = j->j_nlogged - i;
+		if (n > SFS_JTAGS) {
+			n = SFS_JTAGS;
+		}
+
+		bzero(&jd, sizeof(jd));
+		jd.jd_magic = SFS_JMAGIC_DESC;
+		jd.jd_seq = j->j_seq;
+		jd.jd_ntags = n;
+		for (k=0; k<n; k++) {
+			jd.jd_tags[k] = j->j_blocks[i+k].jb_block;
+		}
+		cksum = sfs_jcksum(cksum, &jd, sizeof(jd));
+		result = sfs_writeblock(sfs, pos++, &jd, sizeof(jd));
+		if (result) {
+			return result;
+		}
+
+		for (k=0; k<n; k++) {
+			struct sfs_jblock *jb = &j->j_blocks[i+k];
+
+			cksum = sfs_jcksum(cksum, jb->jb_data, SFS_BLOCKSIZE);
+			result = sfs_writeblock(sfs, pos++, jb->jb_data,
+						SFS_BLOCKSIZE);
+			if (result) {
+				return result;
+			}
+		}
+	}
+	KASSERT(pos < j->j_start + j->j_nblocks);
+
+	/* The device is synchronous, so everything above is on disk. */
+	bzero(&jc, sizeof(jc));
+	jc.jc_magic = SFS_JMAGIC_COMMIT;
+	jc.jc_seq = j->j_seq;
+	jc.jc_nblocks = j->j_nlogged;
+	jc.jc_cksum = cksum;
+	return sfs_writeblock(sfs, pos, &jc, sizeof(jc));
+}
+
+/*
+ * Write every block of the running transaction home.
+ */
+static
+int
+sfs_jcheckpoint(struct sfs_fs *sfs)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	unsigned i;
+	int result;
+
+	for (i=0; i<j->j_nlogged; i++) {
+		result = sfs_writeblock(sfs, j->j_blocks[i].jb_block,
+					j->j_blocks[i].jb_data, SFS_BLOCKSIZE);
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Commit the running transaction.
+ */
+static
+int
+sfs_jdocommit(struct sfs_fs *sfs)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	char *freemapdata;
+	unsigned i;
+	int result;
+
+	KASSERT(j->j_depth == 0);
+
+	/* Deferred frees become real now. */
+	for (i=0; i<j->j_nfrees; i++) {
+		struct sfs_jfreerun *jf = &j->j_frees[i];
+		daddr_t b;
+
+		bitmap_unmark_range(sfs->sfs_freemap, jf->jf_start,
+				    jf->jf_count);
+		/* one call per freemap block the run touches */
+		for (b = jf->jf_start; b < jf->jf_start + jf->jf_count;
+		     b = (b / SFS_BITSPERBLOCK + 1) * SFS_BITSPERBLOCK) {
+			sfs_jfreemapdirty(sfs, b);
+		}
+	}
+	j->j_nfrees = 0;
+
+	/* Log the parts of the freemap that changed. */
+	freemapdata = bitmap_getdata(sfs->sfs_freemap);
+	for (i=0; i<j->j_fmblocks; i++) {
+		if (bitmap_isset(j->j_fmdirty, i)) {
+			sfs_jlog(sfs, SFS_FREEMAP_START + i,
+				 freemapdata + i*SFS_BLOCKSIZE);
+			bitmap_unmark(j->j_fmdirty, i);
+		}
+	}
+	sfs->sfs_freemapdirty = false;
+
+	if (j->j_nlogged == 0) {
+		sfs_jreset(j);
+		return 0;
+	}
+
+	/*
+	 * If either of these fails, the transaction stays in memory
+	 * and we'll try again on the next commit.
+	 */
+	result = sfs_jwritelog(sfs);
+	if (result) {
+		return result;
+	}
+	result = sfs_jcheckpoint(sfs);
+	if (result) {
+		return result;
+	}
+
+	j->j_seq++;
+	result = sfs_jwriteheader(sfs);
+	if (result) {
+		/* harmless: replaying it again is idempotent */
+		j->j_seq--;
+		return result;
+	}
+
+	sfs_jreset(j);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// Interface
+
+/*
+ * Start an operation that changes metadata. If the running
+ * transaction might not have room for it, commit first.
+ */
+int
+sfs_jbegin(struct sfs_fs *sfs)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	struct timespec ts;
+	int result;
+
+	KASSERT(vfs_biglock_do_i_hold());
+
+	if (j == NULL) {
+		return 0;
+	}
+
+	if (j->j_depth == 0 && !sfs_jroom(j)) {
+		result = sfs_jdocommit(sfs);
+		if (result) {
+			return result;
+		}
+	}
+	if (j->j_nops == 0) {
+		ts.tv_sec = SFS_JGROUPSECS;
+		ts.tv_nsec = 0;
+		timeout_add(&j->j_timeout, &ts);
+	}
+	j->j_depth++;
+	j->j_nops++;
+	return 0;
+}
+
+/*
+ * Finish an operation. Commits the transaction if it's time to; once
+ * it's old, the syncer thread takes care of that.
+ */
+void
+sfs_jend(struct sfs_fs *sfs)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	int result;
+
+	KASSERT(vfs_biglock_do_i_hold());
+
+	if (j == NULL) {
+		return;
+	}
+
+	KASSERT(j->j_depth > 0);
+	j->j_depth--;
+	if (j->j_depth > 0) {
+		return;
+	}
+
+	if (j->j_commitwanted || j->j_nops >= SFS_JGROUPOPS) {
+		result = sfs_jdocommit(sfs);
+		if (result) {
+			kprintf("sfs: %s: journal commit failed: %s\n",
+				sfs->sfs_sb.sb_volname, strerror(result));
+		}
+	}
+}
+
+/*
+ * Commit the running transaction, or if an operation is in progress,
+ * arrange for it to be committed when the operation ends.
+ */
+int
+sfs_jcommit(struct sfs_fs *sfs)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+
+	KASSERT(vfs_biglock_do_i_hold());
+
+	if (j == NULL) {
+		return 0;
+	}
+	if (j->j_depth > 0) {
+		j->j_commitwanted = true;
+		return 0;
+	}
+	return sfs_jdocommit(sfs);
+}
+
+/*
+ * Write a metadata block. With a journal this only updates the
+ * running transaction.
+ */
+int
+sfs_jwrite(struct sfs_fs *sfs, daddr_t block, void *data, size_t len)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	int result;
+
+	KASSERT(len == SFS_BLOCKSIZE);
+	KASSERT(vfs_biglock_do_i_hold());
+
+	if (j == NULL) {
+		return sfs_writeblock(sfs, block, data, len);
+	}
+
+	if (j->j_depth == 0 && sfs_jfind(j, block) == NULL && !sfs_jroom(j)) {
+		/* not part of any operation; safe to commit first */
+		result = sfs_jdocommit(sfs);
+		if (result) {
+			return result;
+		}
+	}
+	sfs_jlog(sfs, block, data);
+	return 0;
+}
+
+/*
+ * If BLOCK has a newer copy in the running transaction, copy it to
+ * DATA and return true.
+ */
+bool
+sfs_jread(struct sfs_fs *sfs, daddr_t block, void *data)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	struct sfs_jblock *jb;
+
+	if (j == NULL || j->j_nlogged == 0) {
+		return false;
+	}
+	jb = sfs_jfind(j, block);
+	if (jb == NULL) {
+		return false;
+	}
+	memcpy(data, jb->jb_data, SFS_BLOCKSIZE);
+	return true;
+}
+
+/*
+ * With a journal, log a changed inode as part of the current
+ * operation, so it commits together with the blocks it points to.
+ * (Without one, dirty inodes are written at sync and reclaim time.)
+ */
+void
+sfs_jinode(struct sfs_vnode *sv)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	int result;
+
+	if (sfs->sfs_journal == NULL) {
+		return;
+	}
+	KASSERT(sfs->sfs_journal->j_depth > 0);
+
+	/* inside an operation this only copies into the transaction */
+	result = sfs_sync_inode(sv);
+	KASSERT(result == 0);
+}
+
+/*
+ * Free COUNT blocks starting at START when the running transaction
+ * commits. Runs that continue the previous one are merged into it.
+ */
+void
+sfs_jfree(struct sfs_fs *sfs, daddr_t start, uint32_t count)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	struct sfs_jfreerun *jf;
+
+	KASSERT(j != NULL);
+	if (j->j_nfrees > 0) {
+		jf = &j->j_frees[j->j_nfrees - 1];
+		if (jf->jf_start + jf->jf_count == start) {
+			jf->jf_count += count;
+			return;
+		}
+	}
+	if (j->j_nfrees >= SFS_JMAXFREES) {
+		panic("sfs: %s: journal free list overflow\n",
+		      sfs->sfs_sb.sb_volname);
+	}
+	jf = &j->j_frees[j->j_nfrees++];
+	jf->jf_start = start;
+	jf->jf_count = count;
+}
+
+/*
+ * Note that the freemap bit for BLOCK changed.
+ */
+void
+sfs_jfreemapdirty(struct sfs_fs *sfs, daddr_t block)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	unsigned fmblock = block / SFS_BITSPERBLOCK;
+
+	if (j != NULL && !bitmap_isset(j->j_fmdirty, fmblock)) {
+		bitmap_mark(j->j_fmdirty, fmblock);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Syncer
+
+/*
+ * Timeout function: the running transaction is old. We're in
+ * interrupt context, so hand off to the syncer thread.
+ */
+static
+void
+sfs_jtimeout(void *data)
+{
+	struct sfs_jsyncer *js = data;
+
+	V(js->js_sem);
+}
+
+/*
+ * Syncer thread: commit the running transaction when it gets old,
+ * until the volume is unmounted.
+ */
+static
+void
+sfs_jsyncer(void *data, unsigned long junk)
+{
+	struct sfs_jsyncer *js = data;
+	struct sfs_journal *j;
+	struct timespec ts;
+	int result;
+
+	(void)junk;
+
+	while (1) {
+		P(js->js_sem);
+		vfs_biglock_acquire();
+		if (js->js_stop) {
+			vfs_biglock_release();
+			break;
+		}
+		j = js->js_sfs->sfs_journal;
+		if (j->j_depth > 0) {
+			j->j_commitwanted = true;
+		}
+		else if (j->j_nops > 0) {
+			result = sfs_jdocommit(js->js_sfs);
+			if (result) {
+				kprintf("sfs: %s: journal commit failed: %s\n",
+					js->js_sfs->sfs_sb.sb_volname,
+					strerror(result));
+				/* try again later */
+				ts.tv_sec = SFS_JGROUPSECS;
+				ts.tv_nsec = 0;
+				timeout_add(&j->j_timeout, &ts);
+			}
+		}
+		vfs_biglock_release();
+	}
+
+	sem_destroy(js->js_sem);
+	kfree(js);
+}
+
+/*
+ * Start the syncer thread.
+ */
+static
+int
+sfs_jstartsyncer(struct sfs_fs *sfs)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	struct sfs_jsyncer *js;
+	int result;
+
+	js = kmalloc(sizeof(*js));
+	if (js == NULL) {
+		return ENOMEM;
+	}
+	js->js_sem = sem_create("sfs syncer", 0);
+	if (js->js_sem == NULL) {
+		kfree(js);
+		return ENOMEM;
+	}
+	js->js_sfs = sfs;
+	js->js_stop = false;
+
+	result = thread_fork("sfs syncer", NULL, sfs_jsyncer, js, 0);
+	if (result) {
+		sem_destroy(js->js_sem);
+		kfree(js);
+		return result;
+	}
+	timeout_init(&j->j_timeout, sfs_jtimeout, js);
+	j->j_syncer = js;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// Mount and unmount
+
+/*
+ * Replay the transaction in the journal, if there's a complete one.
+ * Uses the (empty) running transaction to hold it.
+ */
+static
+int
+sfs_jreplay(struct sfs_fs *sfs)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+	struct sfs_jdesc jd;
+	struct sfs_jcommit *jc;
+	uint32_t cksum = 2166136261U;
+	daddr_t pos, end;
+	unsigned i;
+	int result;
+
+	pos = j->j_start + 1;
+	end = j->j_start + j->j_nblocks;
+	while (pos < end) {
+		result = sfs_readblock(sfs, pos++, &jd, sizeof(jd));
+		if (result) {
+			return result;
+		}
+		if (jd.jd_seq != j->j_seq) {
+			return 0;
+		}
+		if (jd.jd_magic == SFS_JMAGIC_COMMIT) {
+			break;
+		}
+		if (jd.jd_magic != SFS_JMAGIC_DESC || jd.jd_ntags == 0 ||
+		    jd.jd_ntags > SFS_JTAGS ||
+		    jd.jd_ntags > j->j_maxtxn - j->j_nlogged ||
+		    pos + jd.jd_ntags >= end) {
+			return 0;
+		}
+		cksum = sfs_jcksum(cksum, &jd, sizeof(jd));
+
+		for (i=0; i<jd.jd_ntags; i++) {
+			struct sfs_jblock *jb = &j->j_blocks[j->j_nlogged++];
+
+			jb->jb_block = jd.jd_tags[i];
+			if (jb->jb_block >= sfs->sfs_sb.sb_nblocks) {
+				return 0;
+			}
+			result = sfs_readblock(sfs, pos++, jb->jb_data,
+					       SFS_BLOCKSIZE);
+			if (result) {
+				return result;
+			}
+			cksum = sfs_jcksum(cksum, jb->jb_data, SFS_BLOCKSIZE);
+		}
+	}
+
+	/* jd now holds what should be the commit block */
+	jc = (struct sfs_jcommit *)&jd;
+	if (jc->jc_magic != SFS_JMAGIC_COMMIT ||
+	    jc->jc_nblocks != j->j_nlogged || jc->jc_cksum != cksum ||
+	    j->j_nlogged == 0) {
+		return 0;
+	}
+
+	kprintf("sfs: %s: replaying %u journaled blocks\n",
+		sfs->sfs_sb.sb_volname, j->j_nlogged);
+	return sfs_jcheckpoint(sfs);
+}
+
+/*
+ * Set up the journal at mount time, replaying it if needed. Must be
+ * called before the freemap is loaded. Leaves sfs_journal NULL if
+ * the volume has no journal.
+ */
+int
+sfs_jmount(struct sfs_fs *sfs)
+{
+	struct sfs_superblock *sb = &sfs->sfs_sb;
+	struct sfs_journal *j;
+	struct sfs_jheader jh;
+	unsigned n;
+	int result;
+
+	KASSERT(sfs->sfs_journal == NULL);
+
+	if (sb->sb_journalblocks == 0) {
+		return 0;
+	}
+	if (sb->sb_journalstart <
+	    SFS_FREEMAP_START + SFS_FREEMAPBLOCKS(sb->sb_nblocks) ||
+	    sb->sb_journalblocks < 3 ||
+	    sb->sb_journalstart + sb->sb_journalblocks > sb->sb_nblocks) {
+		kprintf("sfs: %s: bad journal location %u+%u\n",
+			sb->sb_volname, sb->sb_journalstart,
+			sb->sb_journalblocks);
+		return EINVAL;
+	}
+
+	j = kmalloc(sizeof(*j));
+	if (j == NULL) {
+		return ENOMEM;
+	}
+	j->j_start = sb->sb_journalstart;
+	j->j_nblocks = sb->sb_journalblocks;
+	j->j_depth = 0;
+	j->j_nfrees = 0;
+	j->j_syncer = NULL;
+	timeout_init(&j->j_timeout, sfs_jtimeout, NULL);
+	sfs_jreset(j);
+
+	/*
+	 * Most blocks we can fit after the header with descriptors. A
+	 * commit may log the whole freemap on top of the operations'
+	 * blocks, so leave room for that too.
+	 */
+	j->j_fmblocks = SFS_FREEMAPBLOCKS(sb->sb_nblocks);
+	n = j->j_nblocks - 2;
+	while (n > 0 && 1 + DIVROUNDUP(n, SFS_JTAGS) + n + 1 > j->j_nblocks) {
+		n--;
+	}
+	if (n > SFS_JMAXTXN + j->j_fmblocks) {
+		n = SFS_JMAXTXN + j->j_fmblocks;
+	}
+	j->j_maxtxn = n;
+
+	j->j_fmdirty = bitmap_create(j->j_fmblocks);
+	if (j->j_fmdirty == NULL) {
+		kfree(j);
+		return ENOMEM;
+	}
+	j->j_blocks = kmalloc(j->j_maxtxn * sizeof(struct sfs_jblock));
+	if (j->j_blocks == NULL) {
+		bitmap_destroy(j->j_fmdirty);
+		kfree(j);
+		return ENOMEM;
+	}
+	sfs->sfs_journal = j;
+
+	result = sfs_readblock(sfs, j->j_start, &jh, sizeof(jh));
+	if (result) {
+		goto fail;
+	}
+	if (jh.jh_magic == SFS_JMAGIC_HEADER) {
+		j->j_seq = jh.jh_seq;
+		result = sfs_jreplay(sfs);
+		if (result) {
+			goto fail;
+		}
+		sfs_jreset(j);
+	}
+	else {
+		kprintf("sfs: %s: journal header invalid, resetting\n",
+			sb->sb_volname);
+		j->j_seq = 1;
+	}
+
+	/*
+	 * Always move to a new sequence number, so nothing left in the
+	 * journal area can be mistaken for part of a new transaction.
+	 */
+	j->j_seq++;
+	result = sfs_jwriteheader(sfs);
+	if (result) {
+		goto fail;
+	}
+
+	/*
+	 * The journal area has to hold one operation plus the whole
+	 * freemap; mksfs makes one that does for any volume it can make.
+	 */
+	if (SFS_JOPBLOCKS + j->j_fmblocks > j->j_maxtxn) {
+		kprintf("sfs: %s: journal too small for this volume "
+			"(%u blocks, needs %u); running without it\n",
+			sb->sb_volname, j->j_nblocks,
+			1 + DIVROUNDUP(SFS_JOPBLOCKS + j->j_fmblocks,
+				       SFS_JTAGS) +
+			SFS_JOPBLOCKS + j->j_fmblocks + 1);
+		sfs_junmount(sfs);
+		return 0;
+	}
+
+	result = sfs_jstartsyncer(sfs);
+	if (result) {
+		goto fail;
+	}
+	return 0;
+
+ fail:
+	sfs_junmount(sfs);
+	return result;
+}
+
+/*
+ * Tear down the journal. The running transaction must be empty.
+ */
+void
+sfs_junmount(struct sfs_fs *sfs)
+{
+	struct sfs_journal *j = sfs->sfs_journal;
+
+	if (j == NULL) {
+		return;
+	}
+	KASSERT(j->j_depth == 0);
+	timeout_cancel(&j->j_timeout);
+	if (j->j_syncer != NULL) {
+		/* it frees itself */
+		j->j_syncer->js_stop = true;
+		V(j->j_syncer->js_sem);
+	}
+	kfree(j->j_blocks);
+	bitmap_destroy(j->j_fmdirty);
+	kfree(j);
+	sfs->sfs_journal = NULL;
+}
@@ -37,6 +37,7 @@
 #include <kern/fcntl.h>
 #include <stat.h>
 #include <lib.h>
+#include <current.h>
 #include <uio.h>
 #include <vfs.h>
 #include <sfs.h>
@@ -90,6 +91,31 @@ sfs_eachopendir(struct vnode *v, int openflags)
 	return 0;
 }
 
+/*
+ * Run sfs_io for read or write. A page fault in the middle of the
+ * uiomove can come back here to page in an mmap of the same file, as
+ * in read(fd, p) where p is mapped from fd. sfs_io isn't reentrant on
+ * a vnode, so refuse that; the fault fails, and with it the outer
+ * read or write, with EFAULT.
+ */
+static
+int
+sfs_rwio(struct sfs_vnode *sv, struct uio *uio)
+{
+	int result;
+
+	KASSERT(vfs_biglock_do_i_hold());
+
+	if (sv->sv_iothread == curthread) {
+		return EFAULT;
+	}
+	KASSERT(sv->sv_iothread == NULL);
+	sv->sv_iothread = curthread;
+	result = sfs_io(sv, uio);
+	sv->sv_iothread = NULL;
+	return result;
+}
+
 /*
  * Called for read(). sfs_io() does the work.
  */
@@ -103,7 +129,7 @@ sfs_read(struct vnode *v, struct uio *uio)
 	KASSERT(uio->uio_rw==UIO_READ);
 
 	vfs_biglock_acquire();
-	result = sfs_io(sv, uio);
+	result = sfs_rwio(sv, uio);
 	vfs_biglock_release();
 
 	return result;
@@ -116,13 +142,19 @@ static
 int
 sfs_write(struct vnode *v, struct uio *uio)
 {
+	struct sfs_fs *sfs = v->vn_fs->fs_data;
 	struct sfs_vnode *sv = v->vn_data;
 	int result;
 
 	KASSERT(uio->uio_rw==UIO_WRITE);
 
 	vfs_biglock_acquire();
-	result = sfs_io(sv, uio);
+	result = sfs_jbegin(sfs);
+	if (result == 0) {
+		result = sfs_rwio(sv, uio);
+		sfs_jinode(sv);
+		sfs_jend(sfs);
+	}
 	vfs_biglock_release();
 
 	return result;
@@ -221,11 +253,19 @@ static
 int
 sfs_fsync(struct vnode *v)
 {
+	struct sfs_fs *sfs = v->vn_fs->fs_data;
 	struct sfs_vnode *sv = v->vn_data;
 	int result;
 
 	vfs_biglock_acquire();
-	result = sfs_sync_inode(sv);
+	result = sfs_jbegin(sfs);
+	if (result == 0) {
+		result = sfs_sync_inode(sv);
+		sfs_jend(sfs);
+	}
+	if (result == 0) {
+		result = sfs_jcommit(sfs);
+	}
 	vfs_biglock_release();
 
 	return result;
@@ -249,9 +289,20 @@ static
 int
 sfs_truncate(struct vnode *v, off_t len)
 {
+	struct sfs_fs *sfs = v->vn_fs->fs_data;
 	struct sfs_vnode *sv = v->vn_data;
+	int result;
 
-	return sfs_itrunc(sv, len);
+	vfs_biglock_acquire();
+	result = sfs_jbegin(sfs);
+	if (result == 0) {
+		result = sfs_itrunc(sv, len);
+		sfs_jinode(sv);
+		sfs_jend(sfs);
+	}
+	vfs_biglock_release();
+
+	return result;
 }
 
 /*
@@ -291,15 +342,23 @@ sfs_creat(struct vnode *v, const char *name, bool excl, mode_t mode,
 
 	vfs_biglock_acquire();
 
+	result = sfs_jbegin(sfs);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
 	/* Look up the name */
 	result = sfs_dir_findname(sv, name, &ino, NULL, NULL);
 	if (result!=0 && result!=ENOENT) {
+		sfs_jend(sfs);
 		vfs_biglock_release();
 		return result;
 	}
 
 	/* If it exists and we didn't want it to, fail */
 	if (result==0 && excl) {
+		sfs_jend(sfs);
 		vfs_biglock_release();
 		return EEXIST;
 	}
@@ -308,17 +367,20 @@ sfs_creat(struct vnode *v, const char *name, bool excl, mode_t mode,
 		/* We got something; load its vnode and return */
 		result = sfs_loadvnode(sfs, ino, SFS_TYPE_INVAL, &newguy);
 		if (result) {
+			sfs_jend(sfs);
 			vfs_biglock_release();
 			return result;
 		}
 		*ret = &newguy->sv_absvn;
+		sfs_jend(sfs);
 		vfs_biglock_release();
 		return 0;
 	}
 
 	/* Didn't exist - create it */
-	result = sfs_makeobj(sfs, SFS_TYPE_FILE, &newguy);
+	result = sfs_makeobj(sfs, SFS_TYPE_FILE, sv->sv_ino, &newguy);
 	if (result) {
+		sfs_jend(sfs);
 		vfs_biglock_release();
 		return result;
 	}
@@ -330,6 +392,8 @@ sfs_creat(struct vnode *v, const char *name, bool excl, mode_t mode,
 	result = sfs_dir_link(sv, name, newguy->sv_ino, NULL);
 	if (result) {
 		VOP_DECREF(&newguy->sv_absvn);
+		sfs_jinode(sv);
+		sfs_jend(sfs);
 		vfs_biglock_release();
 		return result;
 	}
@@ -339,9 +403,12 @@ sfs_creat(struct vnode *v, const char *name, bool excl, mode_t mode,
 
 	/* and consequently mark it dirty. */
 	newguy->sv_dirty = true;
+	sfs_jinode(newguy);
+	sfs_jinode(sv);
 
 	*ret = &newguy->sv_absvn;
 
+	sfs_jend(sfs);
 	vfs_biglock_release();
 	return 0;
 }
@@ -355,6 +422,7 @@ static
 int
 sfs_link(struct vnode *dir, const char *name, struct vnode *file)
 {
+	struct sfs_fs *sfs = dir->vn_fs->fs_data;
 	struct sfs_vnode *sv = dir->vn_data;
 	struct sfs_vnode *f = file->vn_data;
 	int result;
@@ -363,8 +431,15 @@ sfs_link(struct vnode *dir, const char *name, struct vnode *file)
 
 	vfs_biglock_acquire();
 
+	result = sfs_jbegin(sfs);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
 	/* Hard links to directories aren't allowed. */
 	if (f->sv_i.sfi_type == SFS_TYPE_DIR) {
+		sfs_jend(sfs);
 		vfs_biglock_release();
 		return EINVAL;
 	}
@@ -372,6 +447,7 @@ sfs_link(struct vnode *dir, const char *name, struct vnode *file)
 	/* Create the link */
 	result = sfs_dir_link(sv, name, f->sv_ino, NULL);
 	if (result) {
+		sfs_jend(sfs);
 		vfs_biglock_release();
 		return result;
 	}
@@ -379,7 +455,10 @@ sfs_link(struct vnode *dir, const char *name, struct vnode *file)
 	/* and update the link count, marking the inode dirty */
 	f->sv_i.sfi_linkcount++;
 	f->sv_dirty = true;
+	sfs_jinode(f);
+	sfs_jinode(sv);
 
+	sfs_jend(sfs);
 	vfs_biglock_release();
 	return 0;
 }
@@ -391,6 +470,7 @@ static
 int
 sfs_remove(struct vnode *dir, const char *name)
 {
+	struct sfs_fs *sfs = dir->vn_fs->fs_data;
 	struct sfs_vnode *sv = dir->vn_data;
 	struct sfs_vnode *victim;
 	int slot;
@@ -398,9 +478,16 @@ sfs_remove(struct vnode *dir, const char *name)
 
 	vfs_biglock_acquire();
 
+	result = sfs_jbegin(sfs);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
 	/* Look for the file and fetch a vnode for it. */
 	result = sfs_lookonce(sv, name, &victim, &slot);
 	if (result) {
+		sfs_jend(sfs);
 		vfs_biglock_release();
 		return result;
 	}
@@ -412,11 +499,13 @@ sfs_remove(struct vnode *dir, const char *name)
 		KASSERT(victim->sv_i.sfi_linkcount > 0);
 		victim->sv_i.sfi_linkcount--;
 		victim->sv_dirty = true;
+		sfs_jinode(victim);
 	}
 
 	/* Discard the reference that sfs_lookonce got us */
 	VOP_DECREF(&victim->sv_absvn);
 
+	sfs_jend(sfs);
 	vfs_biglock_release();
 	return result;
 }
@@ -440,12 +529,19 @@ sfs_rename(struct vnode *d1, const char *n1,
 
 	vfs_biglock_acquire();
 
+	result = sfs_jbegin(sfs);
+	if (result) {
+		vfs_biglock_release();
+		return result;
+	}
+
 	KASSERT(d1==d2);
 	KASSERT(sv->sv_ino == SFS_ROOTDIR_INO);
 
 	/* Look up the old name of the file and get its inode and slot number*/
 	result = sfs_lookonce(sv, n1, &g1, &slot1);
 	if (result) {
+		sfs_jend(sfs);
 		vfs_biglock_release();
 		return result;
 	}
@@ -483,10 +579,13 @@ sfs_rename(struct vnode *d1, const char *n1,
 	KASSERT(g1->sv_i.sfi_linkcount>0);
 	g1->sv_i.sfi_linkcount--;
 	g1->sv_dirty = true;
+	sfs_jinode(g1);
+	sfs_jinode(sv);
 
 	/* Let go of the reference to g1 */
 	VOP_DECREF(&g1->sv_absvn);
 
+	sfs_jend(sfs);
 	vfs_biglock_release();
 	return 0;
 
@@ -504,9 +603,11 @@ sfs_rename(struct vnode *d1, const char *n1,
 		      sfs->sfs_sb.sb_volname);
 	}
 	g1->sv_i.sfi_linkcount--;
+	sfs_jinode(g1);
  puke:
 	/* Let go of the reference to g1 */
 	VOP_DECREF(&g1->sv_absvn);
+	sfs_jend(sfs);
 	vfs_biglock_release();
 	return result;
 }
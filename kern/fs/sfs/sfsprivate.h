@@ -43,8 +43,11 @@ extern const struct vnode_ops sfs_dirops;
 
 
 /* Functions in sfs_balloc.c */
-int sfs_balloc(struct sfs_fs *sfs, daddr_t *diskblock);
+int sfs_balloc(struct sfs_fs *sfs, daddr_t goal, daddr_t *diskblock);
+int sfs_ialloc(struct sfs_fs *sfs, uint32_t dirino, uint32_t *ino);
+daddr_t sfs_datagoal(struct sfs_fs *sfs, uint32_t ino);
 void sfs_bfree(struct sfs_fs *sfs, daddr_t diskblock);
+void sfs_bfree_run(struct sfs_fs *sfs, daddr_t start, uint32_t count);
 int sfs_bused(struct sfs_fs *sfs, daddr_t diskblock);
 
 /* Functions in sfs_bmap.c */
@@ -67,12 +70,26 @@ int sfs_sync_inode(struct sfs_vnode *sv);
 int sfs_reclaim(struct vnode *v);
 int sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 		struct sfs_vnode **ret);
-int sfs_makeobj(struct sfs_fs *sfs, int type, struct sfs_vnode **ret);
+int sfs_makeobj(struct sfs_fs *sfs, int type, uint32_t dirino,
+		struct sfs_vnode **ret);
 int sfs_getroot(struct fs *fs, struct vnode **ret);
 
+/* Functions in sfs_journal.c */
+int sfs_jmount(struct sfs_fs *sfs);
+void sfs_junmount(struct sfs_fs *sfs);
+int sfs_jbegin(struct sfs_fs *sfs);
+void sfs_jend(struct sfs_fs *sfs);
+int sfs_jcommit(struct sfs_fs *sfs);
+int sfs_jwrite(struct sfs_fs *sfs, daddr_t block, void *data, size_t len);
+bool sfs_jread(struct sfs_fs *sfs, daddr_t block, void *data);
+void sfs_jinode(struct sfs_vnode *sv);
+void sfs_jfree(struct sfs_fs *sfs, daddr_t start, uint32_t count);
+void sfs_jfreemapdirty(struct sfs_fs *sfs, daddr_t block);
+
 /* Functions in sfs_io.c */
 int sfs_readblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len);
 int sfs_writeblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len);
+int sfs_promote(struct sfs_vnode *sv);
 int sfs_io(struct sfs_vnode *sv, struct uio *uio);
 int sfs_metaio(struct sfs_vnode *sv, off_t pos, void *data, size_t len,
 	       enum uio_rw rw);
@@ -41,6 +41,27 @@
 struct vnode;
 
 
+#if OPT_DUMBVM
+/*
+ * A file mapped with mmap. mm_pages holds the physical page backing
+ * each virtual page, or 0 if it hasn't been faulted in yet; mm_dirty
+ * records which pages of a MAP_SHARED mapping have been written since
+ * they were last written back.
+ */
+struct dumbvm_mmap {
+        vaddr_t mm_vbase;
+        size_t mm_npages;
+        paddr_t *mm_pages;
+        bool *mm_dirty;
+        struct vnode *mm_vnode;
+        off_t mm_offset;                /* file offset of mm_vbase */
+        int mm_prot;
+        int mm_flags;
+};
+
+#define DUMBVM_MAXMMAPS 16
+#endif
+
 /*
  * Address space - data structure associated with the virtual memory
  * space of a process.
@@ -57,6 +78,12 @@ struct addrspace {
         paddr_t as_pbase2;
         size_t as_npages2;
         paddr_t as_stackpbase;
+        struct dumbvm_mmap *as_mmaps[DUMBVM_MAXMMAPS];
+        vaddr_t as_mmapbase;            /* mappings are placed below this */
+        vaddr_t as_heapbase;            /* page after the higher region */
+        vaddr_t as_heapend;             /* the break */
+        paddr_t *as_heappages;          /* backing pages, 0 if untouched */
+        size_t as_heapslots;            /* entries in as_heappages */
 #else
         /* Put stuff here for your VM system */
 #endif
@@ -118,6 +145,55 @@ int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
 
+/*
+ * File mappings (mmap):
+ *
+ *    as_map_file - map LEN bytes of VN starting at OFFSET (page
+ *                aligned) and hand back the chosen address. Pages are
+ *                read in on first touch by vm_fault.
+ *
+ *    as_unmap  - remove any mappings in [VADDR, VADDR+LEN), writing
+ *                back dirty MAP_SHARED pages first. May split a
+ *                mapping in two.
+ *
+ *    as_sync   - write back dirty MAP_SHARED pages in the range.
+ */
+
+int               as_map_file(struct addrspace *as, size_t len,
+                              int prot, int flags,
+                              struct vnode *vn, off_t offset,
+                              vaddr_t *ret);
+int               as_unmap(struct addrspace *as, vaddr_t vaddr, size_t len);
+int               as_sync(struct addrspace *as, vaddr_t vaddr, size_t len);
+
+/*
+ * The heap:
+ *
+ *    as_sbrk   - move the break by AMOUNT bytes and hand back the old
+ *                break. The heap starts out empty just above the
+ *                loaded regions, and its pages are only allocated when
+ *                first touched. Pages given back by shrinking the heap
+ *                are freed.
+ */
+
+int               as_sbrk(struct addrspace *as, intptr_t amount,
+                          vaddr_t *oldbreak);
+
+/*
+ * Direct access:
+ *
+ *    as_translate - hand back the physical address behind user address
+ *                VADDR in AS, for writing to another process's memory
+ *                without going through its TLB. Fails with EFAULT if
+ *                the page isn't resident or can't be written behind
+ *                the VM system's back (e.g. it's part of a mapping
+ *                that tracks dirty pages); callers then fall back to
+ *                an ordinary copy.
+ */
+
+int               as_translate(struct addrspace *as, vaddr_t vaddr,
+                               paddr_t *ret);
+
 
 /*
  * Functions in loadelf.c
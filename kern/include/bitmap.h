@@ -38,8 +38,10 @@
  *                      Returns NULL on error.
  *     bitmap_getdata - return pointer to raw bit data (for I/O).
  *     bitmap_alloc   - locate a cleared bit, set it, and return its index.
+ *     bitmap_alloc_range - same, but only look at bits START..END-1.
  *     bitmap_mark    - set a clear bit by its index.
  *     bitmap_unmark  - clear a set bit by its index.
+ *     bitmap_unmark_range - clear a run of set bits.
  *     bitmap_isset   - return whether a particular bit is set or not.
  *     bitmap_destroy - destroy bitmap.
  */
@@ -50,8 +52,12 @@ struct bitmap;  /* Opaque. */
 struct bitmap *bitmap_create(unsigned nbits);
 void          *bitmap_getdata(struct bitmap *);
 int            bitmap_alloc(struct bitmap *, unsigned *index);
+int            bitmap_alloc_range(struct bitmap *, unsigned start,
+                                  unsigned end, unsigned *index);
 void           bitmap_mark(struct bitmap *, unsigned index);
 void           bitmap_unmark(struct bitmap *, unsigned index);
+void           bitmap_unmark_range(struct bitmap *, unsigned index,
+                                   unsigned count);
 int            bitmap_isset(struct bitmap *, unsigned index);
 void           bitmap_destroy(struct bitmap *);
 
@@ -38,8 +38,8 @@
 
 
 /*
- * hardclock() is called on every CPU HZ times a second, possibly only
- * when the CPU is not idle, for scheduling.
+ * hardclock() is called on every CPU HZ times a second, for
+ * scheduling, except while the CPU is idle.
  */
 
 /* hardclocks per second */
@@ -50,7 +50,8 @@ void hardclock(void);
 
 /*
  * timerclock() is called on one CPU once a second to allow simple
- * timed operations. (This is a fairly simpleminded interface.)
+ * timed operations. (This is a fairly simpleminded interface; see
+ * <timeout.h> for a better one.)
  */
 void timerclock(void);
 
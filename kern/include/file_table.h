@@ -1,28 +1,52 @@
 #ifndef _FILE_TABLE_H_
 #define _FILE_TABLE_H_
 
+#include <spinlock.h>
 #include <synch.h>
 #include <types.h>
 #include <limits.h>
 #include <vnode.h>
 
-struct file_handle;
-
-struct file_table {
-	struct file_handle * files[OPEN_MAX];
-	struct lock * lk;
-};
+struct proc;
 
+/*
+ * An open file. Every descriptor dup2'd from the same open() shares one.
+ *
+ * ref_count counts the descriptor slots pointing at the handle plus any
+ * syscall that is currently using it, and is protected by ref_lock so it
+ * can be taken during the descriptor lookup without sleeping. The handle
+ * (and its vnode) goes away when the last reference is dropped.
+ *
+ * lk serializes I/O on the handle and protects offset.
+ */
 struct file_handle {
 	struct vnode * f_vnode;
+	struct spinlock ref_lock;
 	int ref_count;
 	off_t offset;
 	int flags;
 	struct lock * lk;
 };
 
-struct file_table * file_table_create(void);
-void file_table_destroy(struct file_table * ft);
-int file_table_add(struct file_table * ft, char * filename, int flags, int32_t * retval);
+int file_handle_create(const char * name, struct vnode * vn, int flags, struct file_handle ** ret);
+void file_handle_incref(struct file_handle * fh);
+void file_handle_decref(struct file_handle * fh);
+
+/*
+ * Per-process descriptor table (proc->files).
+ *
+ * Slots are published and read under proc->ft_slotlock, which is only
+ * ever held for a pointer load or store. proc->ft_lock serializes the
+ * operations that change the table (open, close, dup2) so they can sleep
+ * in vfs_open/vfs_close without holding up I/O on other descriptors.
+ *
+ * file_table_get returns the handle for fd with a reference held, or
+ * NULL if fd is not open; release it with file_handle_decref.
+ */
+int file_table_init(struct proc * proc);
+void file_table_cleanup(struct proc * proc);
+struct file_handle * file_table_get(struct proc * proc, int fd);
+int file_table_add(struct proc * proc, struct file_handle * fh, int32_t * retval);
+struct file_handle * file_table_replace(struct proc * proc, int fd, struct file_handle * fh);
 
-#endif
\ No newline at end of file
+#endif
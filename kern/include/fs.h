@@ -87,5 +87,8 @@ struct fs_ops {
 /* Initialization functions for builtin fake file systems. */
 void semfs_bootstrap(void);
 
+/* P (delta < 0) or V (delta > 0) on an open semfs semaphore. */
+int semfs_semop(struct vnode *vn, int delta);
+
 
 #endif /* _FS_H_ */
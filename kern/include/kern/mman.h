@@ -0,0 +1,24 @@
+#ifndef _KERN_MMAN_H_
+#define _KERN_MMAN_H_
+
+/*
+ * Definitions for mmap(), munmap() and msync().
+ */
+
+/* Page protection (mmap "prot" argument) */
+#define PROT_NONE     0      /* Pages may not be accessed */
+#define PROT_READ     1      /* Pages may be read */
+#define PROT_WRITE    2      /* Pages may be written */
+#define PROT_EXEC     4      /* Pages may be executed */
+
+/* Mapping type (mmap "flags" argument); exactly one must be given */
+#define MAP_SHARED    1      /* Stores go to the file */
+#define MAP_PRIVATE   2      /* Stores stay in this address space */
+#define MAP_TYPE      3      /* mask for MAP_SHARED/MAP_PRIVATE */
+
+/* msync "flags" argument */
+#define MS_ASYNC      1      /* Schedule the write-back (done synchronously) */
+#define MS_SYNC       2      /* Write back before returning */
+#define MS_INVALIDATE 4      /* Accepted and ignored */
+
+#endif /* _KERN_MMAN_H_ */
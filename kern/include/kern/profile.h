@@ -0,0 +1,36 @@
+#ifndef _KERN_PROFILE_H_
+#define _KERN_PROFILE_H_
+
+/*
+ * Kernel profiler dump format, shared with the profdump tool.
+ *
+ * A dump is a struct prof_header followed by ph_nsamples samples,
+ * in the kernel's (big-endian) byte order.
+ */
+
+#define PROF_MAGIC	0x9f0f0161
+#define PROF_VERSION	2
+
+struct prof_header {
+	uint32_t ph_magic;
+	uint32_t ph_version;
+	uint32_t ph_ncpus;
+	uint32_t ph_hz;			/* samples per second per cpu */
+	uint32_t ph_nsamples;
+	uint32_t ph_dropped;		/* samples lost to full buffers */
+};
+
+struct prof_sample {
+	uint32_t ps_pc;			/* interrupted pc */
+	uint32_t ps_ra;			/* interrupted return address register */
+	uint32_t ps_thread;		/* curthread */
+	uint16_t ps_cpu;
+	uint16_t ps_flags;		/* PROF_* below */
+};
+
+#define PROF_USER	0x1		/* pc is in user mode */
+#define PROF_IDLE	0x2		/* cpu was idle */
+#define PROF_IDLESPAN	0x4		/* with PROF_IDLE: idle for ps_pc */
+					/* ticks, not one; ps_ra unused */
+
+#endif /* _KERN_PROFILE_H_ */
@@ -74,9 +74,14 @@ struct sfs_superblock {
 	uint32_t sb_magic;		/* Magic number; should be SFS_MAGIC */
 	uint32_t sb_nblocks;			/* Number of blocks in fs */
 	char sb_volname[SFS_VOLNAME_SIZE];	/* Name of this volume */
-	uint32_t reserved[118];			/* unused, set to 0 */
+	uint32_t sb_journalstart;		/* First journal block, or 0 */
+	uint32_t sb_journalblocks;		/* Size of journal */
+	uint32_t reserved[116];			/* unused, set to 0 */
 };
 
+/* Flags for sfi_flags */
+#define SFS_DINODE_INLINE 0x1		/* data is stored in the inode */
+
 /*
  * On-disk inode
  */
@@ -86,9 +91,21 @@ struct sfs_dinode {
 	uint16_t sfi_linkcount;			/* # hard links to this file */
 	uint32_t sfi_direct[SFS_NDIRECT];	/* Direct blocks */
 	uint32_t sfi_indirect;			/* Indirect block */
-	uint32_t sfi_waste[128-3-SFS_NDIRECT];	/* unused space, set to 0 */
+	uint32_t sfi_waste[128-4-SFS_NDIRECT];	/* unused space, set to 0 */
+	uint32_t sfi_flags;			/* SFS_DINODE_* flags */
 };
 
+/*
+ * Inline data. A file or directory with SFS_DINODE_INLINE set has no
+ * blocks; instead its contents (sfi_size bytes, at most SFS_INLINESIZE)
+ * are kept in the inode itself, in the space starting at sfi_direct
+ * and running up to sfi_flags. Bytes past sfi_size are zero. Inline
+ * data is not byte-swapped.
+ */
+#define SFS_INLINEOFFSET  8
+#define SFS_INLINESIZE    (SFS_BLOCKSIZE - SFS_INLINEOFFSET - 4)
+#define SFS_INLINEDATA(sfi) ((char *)(sfi) + SFS_INLINEOFFSET)
+
 /*
  * On-disk directory entry
  */
@@ -97,5 +114,48 @@ struct sfs_direntry {
 	char sfd_name[SFS_NAMELEN];		/* Filename */
 };
 
+/*
+ * On-disk metadata journal.
+ *
+ * The journal is a contiguous run of blocks (marked in use in the
+ * freemap) described by the superblock. Its first block is a header;
+ * after that it holds at most one transaction: one or more descriptor
+ * blocks, each followed by copies of the blocks whose home locations
+ * it lists, and then a commit block.
+ *
+ * A transaction is replayed (its blocks copied home) only if every
+ * descriptor and the commit block carry the header's sequence number
+ * and the commit block's count and checksum match. The checksum is
+ * 32-bit FNV-1a over the bytes of the descriptor and data blocks, in
+ * the order they appear in the journal. Once a transaction has been
+ * written home, the header's sequence number is advanced, which
+ * invalidates it.
+ */
+#define SFS_JMAGIC_HEADER 0x4a484452	/* "JHDR" */
+#define SFS_JMAGIC_DESC   0x4a445343	/* "JDSC" */
+#define SFS_JMAGIC_COMMIT 0x4a434d54	/* "JCMT" */
+#define SFS_JTAGS         125		/* block numbers per descriptor */
+
+struct sfs_jheader {
+	uint32_t jh_magic;			/* SFS_JMAGIC_HEADER */
+	uint32_t jh_seq;			/* sequence # of next txn */
+	uint32_t reserved[126];			/* unused, set to 0 */
+};
+
+struct sfs_jdesc {
+	uint32_t jd_magic;			/* SFS_JMAGIC_DESC */
+	uint32_t jd_seq;			/* transaction sequence # */
+	uint32_t jd_ntags;			/* # of blocks that follow */
+	uint32_t jd_tags[SFS_JTAGS];		/* their home block numbers */
+};
+
+struct sfs_jcommit {
+	uint32_t jc_magic;			/* SFS_JMAGIC_COMMIT */
+	uint32_t jc_seq;			/* transaction sequence # */
+	uint32_t jc_nblocks;			/* total # of logged blocks */
+	uint32_t jc_cksum;			/* see above */
+	uint32_t reserved[124];			/* unused, set to 0 */
+};
+
 
 #endif /* _KERN_SFS_H_ */
@@ -0,0 +1,50 @@
+#ifndef _KERN_TRACE_H_
+#define _KERN_TRACE_H_
+
+/*
+ * Kernel event trace dump format, shared with the tracedump tool.
+ *
+ * A dump is a struct trace_header followed by th_nrecords records.
+ * Each CPU's records are in order, one CPU after another; the tool
+ * merges them by time. Everything is in the kernel's byte order,
+ * which is big-endian.
+ */
+
+#define TRACE_MAGIC	0x7ace0161
+#define TRACE_VERSION	1
+
+struct trace_header {
+	uint32_t th_magic;
+	uint32_t th_version;
+	uint32_t th_ncpus;
+	uint32_t th_nrecords;
+};
+
+struct trace_record {
+	uint32_t tr_sec;		/* gettime() when it happened */
+	uint32_t tr_nsec;
+	uint16_t tr_cpu;
+	uint16_t tr_type;		/* TRACE_* below */
+	uint32_t tr_thread;		/* curthread */
+	uint32_t tr_arg0;
+	uint32_t tr_arg1;
+};
+
+/* Event types, with what goes in the args. */
+#define TRACE_NONE		0
+#define TRACE_SWITCH		1	/* old thread's new state, next thread */
+#define TRACE_SLEEP		2	/* wchan, 0 */
+#define TRACE_WAKE		3	/* wchan, thread woken */
+#define TRACE_FAULT		4	/* fault type, address */
+#define TRACE_SYSCALL		5	/* call number, first argument */
+#define TRACE_SYSRET		6	/* call number, error */
+#define TRACE_DISKIO		7	/* first sector, count | TRACE_WRITE */
+#define TRACE_DISKDONE		8	/* first sector, error */
+#define TRACE_SFSIO		9	/* inode, bytes | TRACE_WRITE */
+#define TRACE_SFSDONE		10	/* inode, error */
+#define TRACE_NTYPES		11
+
+/* Flag or'd into the size for writes. */
+#define TRACE_WRITE		0x80000000
+
+#endif /* _KERN_TRACE_H_ */
@@ -52,6 +52,13 @@ void mainbus_interrupt(struct trapframe *);
 /* XXX this interface is not adequately MI */
 size_t mainbus_ramsize(void);
 
+/*
+ * Start and stop the current cpu's hardclock. The scheduler stops it
+ * while the cpu is idle.
+ */
+void mainbus_hardclock_start(void);
+void mainbus_hardclock_stop(void);
+
 /* Switch on an inter-processor interrupt. (Low-level.) */
 void mainbus_send_ipi(struct cpu *target);
 
@@ -0,0 +1,20 @@
+#ifndef _PIPE_H_
+#define _PIPE_H_
+
+struct vnode;
+
+/*
+ * Anonymous pipes.
+ *
+ * pipe_create makes a pipe and hands back one vnode for each end, each
+ * holding one reference. Reads block until data is available and
+ * return what there is; writes of up to PIPE_BUF bytes are atomic.
+ * Once the read end is gone, writes fail with EPIPE; once the write end
+ * is gone and the pipe is empty, reads return EOF.
+ */
+
+#define PIPE_SIZE 4096		/* ring buffer size; at least PIPE_BUF */
+
+int pipe_create(struct vnode ** readvn, struct vnode ** writevn);
+
+#endif
@@ -40,6 +40,7 @@
 #include <limits.h>
 #include <types.h>
 #include <synch.h>
+#include <thread.h>
 #include <file_table.h>
 
 struct addrspace;
@@ -74,8 +75,16 @@ struct proc {
 	/* VFS */
 	struct vnode *p_cwd;		/* current working directory */
 
+	/* File table (see file_table.h) */
+	struct lock *ft_lock;		/* serializes open/close/dup2 */
+	struct spinlock ft_slotlock;	/* protects the slots in files[] */
+	struct file_handle *files[OPEN_MAX];
+
+	/* Resource usage (protected by p_lock) */
+	struct threadusage p_usage;	/* from threads that have left */
+	struct threadusage p_childusage; /* from children reaped by wait */
+
 	/* add more material here as needed */
-	struct file_table * file_table;
 };
 
 /* This is the process structure for the kernel and for kernel-only threads. */
@@ -96,6 +105,15 @@ int proc_addthread(struct proc *proc, struct thread *t);
 /* Detach a thread from its process. */
 void proc_remthread(struct thread *t);
 
+/*
+ * Resource usage. proc_getusage adds up PROC's counters, including the
+ * calling thread's own if it belongs to PROC. proc_addchildusage folds
+ * everything CHILD used into PARENT's child totals; wait should call
+ * it when it reaps CHILD.
+ */
+void proc_getusage(struct proc *proc, struct threadusage *ret);
+void proc_addchildusage(struct proc *parent, struct proc *child);
+
 /* Fetch the address space of the current process. */
 struct addrspace *proc_getas(void);
 
@@ -0,0 +1,46 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+/*
+ * Sampling profiler. Enable with "options profile" in the kernel
+ * config; then "prof on" in the menu starts taking a sample on every
+ * hardclock of every cpu, and "prof dump" writes them out for the
+ * profdump tool to match against the kernel (and a user program).
+ *
+ * Each sample is the interrupted pc and return address register. The
+ * latter gives the caller only if the interrupted function hasn't
+ * reused ra yet (for leaf functions it always is), so the call-site
+ * profile is approximate.
+ *
+ * A cpu with nothing to run turns its hardclock off, so it takes no
+ * samples while idle; instead, when the hardclock comes back on, the
+ * ticks it slept through go in as one PROF_IDLESPAN sample.
+ */
+
+#include <kern/profile.h>
+#include <recbuf.h>
+#include "opt-profile.h"
+
+#if OPT_PROFILE
+
+extern struct recbuf prof_buf;
+
+void prof_sample(vaddr_t pc, vaddr_t ra);
+void prof_idleticks(unsigned ticks);
+int prof_start(void);
+void prof_stop(void);
+int prof_dump(char *path);
+
+#define PROF_SAMPLE(pc, ra) \
+	(prof_buf.rb_enabled ? prof_sample(pc, ra) : (void)0)
+#define PROF_IDLETICKS(ticks) \
+	(prof_buf.rb_enabled ? prof_idleticks(ticks) : (void)0)
+
+#else
+
+#define PROF_SAMPLE(pc, ra)	((void)0)
+#define PROF_IDLETICKS(ticks)	((void)(ticks))
+
+#endif
+
+#endif /* _PROFILE_H_ */
@@ -0,0 +1,43 @@
+#ifndef _RECBUF_H_
+#define _RECBUF_H_
+
+/*
+ * Per-cpu record buffers, for the event tracer and the profiler.
+ *
+ * Each cpu fills its own buffer, only from that cpu and with
+ * interrupts off, so recording takes no locks. A buffer either wraps
+ * around, overwriting the oldest records (rb_wrap), or once full just
+ * counts what it drops.
+ *
+ * To record, call recbuf_begin; if it returns a slot, fill it in and
+ * call recbuf_end. Between the two the cpu's buffer is marked busy,
+ * which is what lets recbuf_stop wait out a record in progress that
+ * got past the check of rb_enabled just before it was cleared.
+ *
+ * recbuf_dump writes a header and then each cpu's records, oldest
+ * first, to a file.
+ */
+
+struct recbuf_cpu;
+
+struct recbuf {
+	volatile bool rb_enabled;
+	size_t rb_recsize;		/* size of one record */
+	unsigned rb_nrecs;		/* records per cpu */
+	bool rb_wrap;			/* overwrite when full, vs. drop */
+	struct recbuf_cpu **rb_cpus;
+	unsigned rb_ncpus;
+};
+
+#define RECBUF_INITIALIZER(recsize, nrecs, wrap) \
+	{ false, recsize, nrecs, wrap, NULL, 0 }
+
+int recbuf_start(struct recbuf *rb);
+void recbuf_stop(struct recbuf *rb);
+void *recbuf_begin(struct recbuf *rb, unsigned *cpunum, int *spl);
+void recbuf_end(struct recbuf *rb, unsigned cpunum, int spl);
+void recbuf_counts(struct recbuf *rb, unsigned *kept, unsigned *dropped);
+int recbuf_dump(struct recbuf *rb, char *path,
+		const void *header, size_t headerlen);
+
+#endif /* _RECBUF_H_ */
@@ -56,8 +56,13 @@ struct sfs_vnode {
 	struct sfs_dinode sv_i;		/* copy of on-disk inode */
 	uint32_t sv_ino;                /* inode number */
 	bool sv_dirty;                  /* true if sv_i modified */
+	uint32_t *sv_ibuf;              /* cached indirect block, or NULL */
+	daddr_t sv_iblock;              /* block in sv_ibuf (0 = invalid) */
+	struct thread *sv_iothread;     /* thread in sfs_io here, or NULL */
 };
 
+struct sfs_journal;	/* private to sfs_journal.c */
+
 /*
  * In-memory info for a whole fs volume
  */
@@ -69,6 +74,7 @@ struct sfs_fs {
 	struct vnodearray *sfs_vnodes;  /* vnodes loaded into memory */
 	struct bitmap *sfs_freemap;     /* blocks in use are marked 1 */
 	bool sfs_freemapdirty;          /* true if freemap modified */
+	struct sfs_journal *sfs_journal; /* metadata journal, or NULL */
 };
 
 /*
@@ -38,6 +38,7 @@
 #include <cdefs.h>
 #include <hangman.h>
 #include <types.h>
+#include "opt-ticketlock.h"
 
 /* Inlining support - for making sure an out-of-line copy gets built */
 #ifndef SPINLOCK_INLINE
@@ -55,9 +56,20 @@
  * This structure is made public so spinlocks do not have to be
  * malloc'd; however, code that uses spinlocks should not look inside
  * the structure directly but always use the spinlock API functions.
+ *
+ * With "options ticketlock" the lock is a ticket lock: each CPU takes
+ * a number from splk_next and waits until splk_serving reaches it, so
+ * CPUs get the lock in the order they asked for it, and waiters only
+ * read while they spin. Otherwise it is a test-and-test-and-set lock
+ * on splk_lock.
  */
 struct spinlock {
+#if OPT_TICKETLOCK
+	volatile spinlock_data_t splk_next;    /* Next ticket to hand out. */
+	volatile spinlock_data_t splk_serving; /* Ticket that holds the lock. */
+#else
 	volatile spinlock_data_t splk_lock; /* Memory word where we spin. */
+#endif
 	struct cpu *splk_holder;	    /* CPU holding this lock. */
 	HANGMAN_LOCKABLE(splk_hangman);     /* Deadlock detector hook. */
 };
@@ -65,11 +77,18 @@ struct spinlock {
 /*
  * Initializer for cases where a spinlock needs to be static or global.
  */
+#if OPT_TICKETLOCK
+#define SPINLOCK_WORDS_INITIALIZER \
+	SPINLOCK_DATA_INITIALIZER, SPINLOCK_DATA_INITIALIZER
+#else
+#define SPINLOCK_WORDS_INITIALIZER	SPINLOCK_DATA_INITIALIZER
+#endif
+
 #ifdef OPT_HANGMAN
-#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL, \
+#define SPINLOCK_INITIALIZER	{ SPINLOCK_WORDS_INITIALIZER, NULL, \
 				  HANGMAN_LOCKABLE_INITIALIZER }
 #else
-#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL }
+#define SPINLOCK_INITIALIZER	{ SPINLOCK_WORDS_INITIALIZER, NULL }
 #endif
 
 /*
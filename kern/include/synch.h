@@ -37,6 +37,8 @@
 
 #include <spinlock.h>
 
+struct timespec;	/* from <kern/time.h> */
+
 /*
  * Dijkstra-style semaphore.
  *
@@ -128,8 +130,10 @@ void cv_destroy(struct cv *);
  *                   waking up again, re-acquire the lock.
  *    cv_signal    - Wake up one thread that's sleeping on this CV.
  *    cv_broadcast - Wake up all threads sleeping on this CV.
+ *    cv_timedwait - Like cv_wait, but give up after RELTIME has passed;
+ *                   returns ETIMEDOUT then and 0 if woken up.
  *
- * For all three operations, the current thread must hold the lock passed
+ * For all of these operations, the current thread must hold the lock passed
  * in. Note that under normal circumstances the same lock should be used
  * on all operations with any particular CV.
  *
@@ -138,6 +142,8 @@ void cv_destroy(struct cv *);
 void cv_wait(struct cv *cv, struct lock *lock);
 void cv_signal(struct cv *cv, struct lock *lock);
 void cv_broadcast(struct cv *cv, struct lock *lock);
+int cv_timedwait(struct cv *cv, struct lock *lock,
+		 const struct timespec *reltime);
 
 /*
  * Reader-writer locks.
@@ -147,10 +153,32 @@ void cv_broadcast(struct cv *cv, struct lock *lock);
  *
  * The name field is for easier debugging. A copy of the name is
  * (should be) made internally.
+ *
+ * The policy decides who goes next when both readers and writers are
+ * waiting:
+ *    RWLOCK_PHASE_FAIR   - readers and writers take turns: when a writer
+ *                          finishes, every reader waiting at that point
+ *                          gets in together, and new readers queue up
+ *                          behind the next writer. Neither side starves.
+ *                          This is what rwlock_create gives you.
+ *    RWLOCK_READER_PREF  - readers get in whenever no writer holds the
+ *                          lock. Writers can starve.
+ *    RWLOCK_WRITER_PREF  - nobody new gets a read lock while a writer
+ *                          is waiting. Readers can starve.
+ *
+ * The lock is handed directly to whoever is woken, so a woken thread
+ * never has to compete for it again.
  */
 
+enum rwlock_policy {
+        RWLOCK_PHASE_FAIR,
+        RWLOCK_READER_PREF,
+        RWLOCK_WRITER_PREF,
+};
+
 struct rwlock {
         char *rwl_name;
+        enum rwlock_policy rwl_policy;
         struct wchan *reader_wchan;
         struct wchan *writer_wchan;
         struct spinlock rwl_lock;
@@ -158,9 +186,13 @@ struct rwlock {
         volatile unsigned int readers_waiting;
         volatile unsigned int writers_active;
         volatile unsigned int readers_active;
+        volatile unsigned int rwl_readgen;     /* bumped when readers are let in */
+        volatile unsigned int rwl_wticket;     /* next waiting writer's ticket */
+        volatile unsigned int rwl_wserved;     /* writer tickets granted so far */
 };
 
 struct rwlock * rwlock_create(const char *rwl);
+struct rwlock * rwlock_create_policy(const char *rwl, enum rwlock_policy policy);
 void rwlock_destroy(struct rwlock *rwl);
 
 /*
@@ -46,6 +46,9 @@ void syscall(struct trapframe *tf);
 /* Helper for fork(). You write this. */
 void enter_forked_process(struct trapframe *tf);
 
+/* Set up the futex hash table. */
+void futex_bootstrap(void);
+
 /* Enter user mode. Does not return. */
 __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 		       vaddr_t stackptr, vaddr_t entrypoint);
@@ -57,6 +60,7 @@ __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 
 int sys_reboot(int code);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
+int sys_nanosleep(const_userptr_t user_req, userptr_t user_rem);
 
 /* File Syscalls */
 
@@ -66,6 +70,31 @@ int sys_read(int fd, userptr_t buf, size_t buflen, int32_t * retval);
 int sys_lseek(int fd, off_t pos, int whence, int64_t * retval);
 int sys_close(int fd, int32_t * retval);
 int sys_dup2(int oldfd, int newfd, int32_t * retval);
+int sys_pipe(userptr_t fds, int32_t * retval);
+int sys_copy_file_range(int infd, int outfd, size_t len, int32_t * retval);
+
+/* Memory-mapped files */
+
+int sys_mmap(userptr_t addr, size_t len, int prot, int flags, int fd, off_t offset, int32_t * retval);
+int sys_munmap(userptr_t addr, size_t len, int32_t * retval);
+int sys_msync(userptr_t addr, size_t len, int flags, int32_t * retval);
+
+/* Heap */
+
+int sys_sbrk(intptr_t amount, int32_t * retval);
+
+/* Futexes */
+
+int sys_futex_wait(userptr_t uaddr, int val, int32_t * retval);
+int sys_futex_wake(userptr_t uaddr, int count, int32_t * retval);
+
+/* Semaphores */
+
+int sys_sem_op(int fd, int delta, int32_t * retval);
+
+/* Resource usage */
+
+int sys_getrusage(int who, userptr_t usage, int32_t * retval);
 
 /* Process Syscalls */
 
@@ -57,6 +57,21 @@ struct cpu;
 #define SAME_STACK(p1, p2)     (((p1) & STACK_MASK) == ((p2) & STACK_MASK))
 
 
+/*
+ * Resource usage counters. A thread only ever updates its own, from
+ * its own context or from an interrupt on its CPU, so they need no
+ * locking. Processes sum them; see proc_getusage.
+ */
+struct threadusage {
+	uint32_t tu_uticks;		/* hardclocks taken in user mode */
+	uint32_t tu_sticks;		/* hardclocks taken in the kernel */
+	uint32_t tu_faults;		/* VM faults */
+	uint32_t tu_nvcsw;		/* voluntary context switches */
+	uint32_t tu_nivcsw;		/* involuntary context switches */
+	uint64_t tu_inbytes;		/* bytes read */
+	uint64_t tu_outbytes;		/* bytes written */
+};
+
 /* States a thread can be in. */
 typedef enum {
 	S_RUN,		/* running */
@@ -112,10 +127,14 @@ struct thread {
 	int t_curspl;			/* Current spl*() state */
 	int t_iplhigh_count;		/* # of times IPL has been raised */
 
+	bool t_intr_user;		/* Interrupt came from user mode */
+
 	/*
 	 * Public fields
 	 */
 
+	struct threadusage t_usage;	/* Resource usage */
+
 	/* add more here as needed */
 };
 
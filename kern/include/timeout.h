@@ -0,0 +1,68 @@
+#ifndef _TIMEOUT_H_
+#define _TIMEOUT_H_
+
+/*
+ * Timeouts: call a function once a given amount of time has passed.
+ *
+ * Pending timeouts are kept in a hierarchical timer wheel, so adding
+ * and cancelling are constant-time. The wheel turns in ticks of
+ * TIMEOUT_TICKUSEC microseconds, independent of HZ. It is driven by a
+ * one-shot hardware timer, which is always set for the next timeout
+ * due, so there are no interrupts while nothing is due.
+ *
+ * Timeout functions are called from the timer interrupt, on whichever
+ * cpu takes it, and must not sleep. One may re-add its own timeout.
+ *
+ * The struct timeout belongs to the caller, who must not free or
+ * reuse it while it is pending or while its function is running;
+ * timeout_cancel waits out the latter.
+ */
+
+#include <kern/time.h>
+
+#define TIMEOUT_TICKUSEC	100
+
+struct timeout {
+	struct timeout *to_next;	/* wheel slot list */
+	struct timeout **to_prevp;
+	uint64_t to_expires;		/* tick it is due on */
+	unsigned to_state;		/* TO_* in timeout.c */
+	void (*to_func)(void *);
+	void *to_data;
+};
+
+/*
+ * Hook up the hardware timer, which is used from then on: GETTIME
+ * reads its clock and PROGRAM sets it to interrupt once in USECS
+ * microseconds (replacing any earlier setting). The timer's interrupt
+ * handler should then call timeout_clock.
+ */
+void timeout_setclock(void *data,
+		      void (*gettime)(void *data, struct timespec *ts),
+		      void (*program)(void *data, uint32_t usecs));
+void timeout_clock(void);
+
+/*
+ * timeout_init - set up T to call FUNC(DATA).
+ * timeout_add - schedule T (which must not be pending) for RELTIME
+ *               from now, rounded up to the next tick.
+ * timeout_readd - from T's own function, schedule it again INTERVAL
+ *               after it was due, for periodic timeouts that mustn't
+ *               drift.
+ * timeout_cancel - unschedule T. Returns true if it was pending; false
+ *               if it had already fired, in which case its function
+ *               has finished running by the time this returns. Don't
+ *               call this while holding a spinlock that the timeout's
+ *               function takes.
+ */
+void timeout_init(struct timeout *t, void (*func)(void *), void *data);
+void timeout_add(struct timeout *t, const struct timespec *reltime);
+void timeout_readd(struct timeout *t, const struct timespec *interval);
+bool timeout_cancel(struct timeout *t);
+
+/*
+ * Put the current thread to sleep for RELTIME. Fails only with ENOMEM.
+ */
+int timeout_sleep(const struct timespec *reltime);
+
+#endif /* _TIMEOUT_H_ */
@@ -0,0 +1,38 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+/*
+ * Kernel event tracing. Enable with "options trace" in the kernel
+ * config; then "trace on" in the menu starts recording and "trace
+ * dump" writes the records out for the tracedump tool.
+ *
+ * Each CPU records into its own ring (see <recbuf.h>), so recording
+ * takes no locks. When the ring fills the oldest records are
+ * overwritten. TRACE() costs one load and a branch while tracing is
+ * off, and nothing at all without the option.
+ */
+
+#include <kern/trace.h>
+#include <recbuf.h>
+#include "opt-trace.h"
+
+#if OPT_TRACE
+
+extern struct recbuf trace_buf;
+
+void trace_record(unsigned type, uint32_t arg0, uint32_t arg1);
+int trace_start(void);
+void trace_stop(void);
+int trace_dump(char *path);
+
+#define TRACE(type, a0, a1) \
+	(trace_buf.rb_enabled ? \
+	 trace_record(type, (uint32_t)(a0), (uint32_t)(a1)) : (void)0)
+
+#else
+
+#define TRACE(type, a0, a1)	((void)0)
+
+#endif
+
+#endif /* _TRACE_H_ */
@@ -120,6 +120,40 @@ bitmap_alloc(struct bitmap *b, unsigned *index)
         return ENOSPC;
 }
 
+/*
+ * Like bitmap_alloc, but take the first clear bit at or after START
+ * and before END.
+ */
+int
+bitmap_alloc_range(struct bitmap *b, unsigned start, unsigned end,
+                   unsigned *index)
+{
+        unsigned bit;
+        WORD_TYPE mask;
+
+        if (end > b->nbits) {
+                end = b->nbits;
+        }
+
+        bit = start;
+        while (bit < end) {
+                if (bit % BITS_PER_WORD == 0 &&
+                    b->v[bit / BITS_PER_WORD] == WORD_ALLBITS) {
+                        /* whole word in use; skip it */
+                        bit += BITS_PER_WORD;
+                        continue;
+                }
+                mask = ((WORD_TYPE)1) << (bit % BITS_PER_WORD);
+                if ((b->v[bit / BITS_PER_WORD] & mask) == 0) {
+                        b->v[bit / BITS_PER_WORD] |= mask;
+                        *index = bit;
+                        return 0;
+                }
+                bit++;
+        }
+        return ENOSPC;
+}
+
 static
 inline
 void
@@ -158,6 +192,31 @@ bitmap_unmark(struct bitmap *b, unsigned index)
 }
 
 
+/*
+ * Clear COUNT bits starting at INDEX, a whole word at a time where
+ * possible. All the bits must be set.
+ */
+void
+bitmap_unmark_range(struct bitmap *b, unsigned index, unsigned count)
+{
+        KASSERT(index + count <= b->nbits);
+
+        while (count > 0 && index % BITS_PER_WORD != 0) {
+                bitmap_unmark(b, index++);
+                count--;
+        }
+        while (count >= BITS_PER_WORD) {
+                KASSERT(b->v[index / BITS_PER_WORD] == WORD_ALLBITS);
+                b->v[index / BITS_PER_WORD] = 0;
+                index += BITS_PER_WORD;
+                count -= BITS_PER_WORD;
+        }
+        while (count > 0) {
+                bitmap_unmark(b, index++);
+                count--;
+        }
+}
+
 int
 bitmap_isset(struct bitmap *b, unsigned index)
 {
@@ -44,6 +44,8 @@
 #include <syscall.h>
 #include <test.h>
 #include <prompt.h>
+#include <trace.h>
+#include <profile.h>
 #include "opt-sfs.h"
 #include "opt-net.h"
 #include "opt-synchprobs.h"
@@ -516,6 +518,57 @@ cmd_kheapdump(int nargs, char **args)
 	return 0;
 }
 
+#if OPT_TRACE || OPT_PROFILE
+/*
+ * Common part of the trace and prof commands: "on" clears the buffers
+ * and starts recording, "off" stops, and "dump file" stops and writes
+ * the records out (e.g. to emu0:trace.out) for the matching dump tool
+ * to read.
+ */
+static
+int
+cmd_recorder(int nargs, char **args, int (*start)(void),
+	     void (*stop)(void), int (*dump)(char *path))
+{
+	if (nargs == 2 && !strcmp(args[1], "on")) {
+		return start();
+	}
+	if (nargs == 2 && !strcmp(args[1], "off")) {
+		stop();
+		return 0;
+	}
+	if (nargs == 3 && !strcmp(args[1], "dump")) {
+		return dump(args[2]);
+	}
+	kprintf("Usage: %s on | off | dump file\n", args[0]);
+	return EINVAL;
+}
+#endif
+
+#if OPT_TRACE
+/*
+ * Command for the event trace.
+ */
+static
+int
+cmd_trace(int nargs, char **args)
+{
+	return cmd_recorder(nargs, args, trace_start, trace_stop, trace_dump);
+}
+#endif
+
+#if OPT_PROFILE
+/*
+ * Command for the profiler.
+ */
+static
+int
+cmd_prof(int nargs, char **args)
+{
+	return cmd_recorder(nargs, args, prof_start, prof_stop, prof_dump);
+}
+#endif
+
 ////////////////////////////////////////
 //
 // Menus.
@@ -556,6 +609,12 @@ static const char *opsmenu[] = {
 	"[pwd]     Print current directory   ",
 	"[sync]    Sync filesystems          ",
 	"[debug]   Drop to debugger          ",
+#if OPT_TRACE
+	"[trace]   Event trace on/off/dump   ",
+#endif
+#if OPT_PROFILE
+	"[prof]    Profiler on/off/dump      ",
+#endif
 	"[panic]   Intentional panic         ",
 	"[deadlock] Intentional deadlock     ",
 	"[q]       Quit and shut down        ",
@@ -586,6 +645,7 @@ static const char *testmenu[] = {
 	"[tt1] Thread test 1                 ",
 	"[tt2] Thread test 2                 ",
 	"[tt3] Thread test 3                 ",
+	"[tot] Timeout test                  ",
 #if OPT_NET
 	"[net] Network test                  ",
 #endif
@@ -600,7 +660,7 @@ static const char *testmenu[] = {
 	"[cvt3] CV test 3             (1*)   ",
 	"[cvt4] CV test 4             (1*)   ",
 	"[cvt5] CV test 5             (1)    ",
-	"[rwt1] RW lock test          (1?)   ",
+	"[rwt1] RW lock test [policy] (1?)   ",
 	"[rwt2] RW lock test 2        (1?)   ",
 	"[rwt3] RW lock test 3        (1?)   ",
 	"[rwt4] RW lock test 4        (1?)   ",
@@ -722,6 +782,12 @@ static struct {
 	{ "khu",        cmd_kheapused },
 	{ "khgen",      cmd_kheapgeneration },
 	{ "khdump",     cmd_kheapdump },
+#if OPT_TRACE
+	{ "trace",      cmd_trace },
+#endif
+#if OPT_PROFILE
+	{ "prof",       cmd_prof },
+#endif
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -739,6 +805,7 @@ static struct {
 	{ "tt1",	threadtest },
 	{ "tt2",	threadtest2 },
 	{ "tt3",	threadtest3 },
+	{ "tot",	timeouttest },
 
 	/* synchronization assignment tests */
 	{ "sem1",	semtest },
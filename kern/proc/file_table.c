@@ -1,113 +1,201 @@
+#include <types.h>
 #include <file_table.h>
+#include <proc.h>
 #include <limits.h>
+#include <spinlock.h>
 #include <synch.h>
 #include <lib.h>
-#include <kern/stat.h>
+#include <vfs.h>
 #include <kern/errno.h>
 
-struct file_table * 
-file_table_create(void) 
-{	
-	struct file_table * ft = NULL;
-	ft = (struct file_table *)kmalloc(sizeof(struct file_table));
+int
+file_handle_create(const char * name, struct vnode * vn, int flags, struct file_handle ** ret)
+{
+	KASSERT(name != NULL);
+	KASSERT(vn != NULL);
+	KASSERT(ret != NULL);
 
-	if (ft != NULL) {
-		memset(ft->files, 0, sizeof(ft->files));
+	struct file_handle * fh = kmalloc(sizeof(struct file_handle));
 
-		ft->lk = lock_create("file_table_lock");
+	if (fh == NULL) {
+		return ENOMEM;
+	}
 
-		if (ft->lk == NULL) {
-			kfree(ft);
-			ft = NULL;
-		}
+	fh->lk = lock_create(name);
+
+	if (fh->lk == NULL) {
+		kfree(fh);
+		return ENOMEM;
 	}
 
-	return ft;
+	spinlock_init(&fh->ref_lock);
+	fh->f_vnode = vn;
+	fh->ref_count = 1;
+	fh->offset = 0;
+	fh->flags = flags;
+
+	*ret = fh;
+	return 0;
 }
 
-void 
-file_table_destroy(struct file_table * ft) 
+void
+file_handle_incref(struct file_handle * fh)
 {
-	KASSERT(ft != NULL);
+	KASSERT(fh != NULL);
+
+	spinlock_acquire(&fh->ref_lock);
+	KASSERT(fh->ref_count > 0);
+	++fh->ref_count;
+	spinlock_release(&fh->ref_lock);
+}
+
+/*
+ * Drop a reference. The last one closes the vnode and frees the handle;
+ * nobody else can reach the handle at that point, so no locks are needed
+ * to tear it down.
+ */
+void
+file_handle_decref(struct file_handle * fh)
+{
+	KASSERT(fh != NULL);
+
+	spinlock_acquire(&fh->ref_lock);
+	KASSERT(fh->ref_count > 0);
+	int remaining = --fh->ref_count;
+	spinlock_release(&fh->ref_lock);
+
+	if (remaining > 0) {
+		return;
+	}
 
-	if (ft != NULL) {
-		// TODO destroy each open file
-		lock_destroy(ft->lk);
-		kfree(ft);
+	if (fh->f_vnode != NULL) {
+		vfs_close(fh->f_vnode);
 	}
+
+	lock_destroy(fh->lk);
+	spinlock_cleanup(&fh->ref_lock);
+	kfree(fh);
 }
 
-int 
-file_table_add(struct file_table * ft, char * filename, int flags, int32_t * retval) 
+int
+file_table_init(struct proc * proc)
 {
-	KASSERT(ft != NULL);
-	KASSERT(filename != NULL);
-	KASSERT(retval != NULL);
+	KASSERT(proc != NULL);
+
+	proc->ft_lock = lock_create("file_table_lock");
 
-	if (ft == NULL || filename == NULL || retval == NULL) {
-		return EINVAL;
+	if (proc->ft_lock == NULL) {
+		return ENOMEM;
 	}
 
-	lock_acquire(ft->lk);
+	spinlock_init(&proc->ft_slotlock);
+	memset(proc->files, 0, sizeof(proc->files));
 
-	int fd = 0;
+	return 0;
+}
 
-	while (fd < OPEN_MAX && ft->files[fd] != NULL) {
-		++fd;
+/*
+ * Drop every descriptor. Only called when the process is going away, so
+ * there can be no lookups racing with us.
+ */
+void
+file_table_cleanup(struct proc * proc)
+{
+	KASSERT(proc != NULL);
+
+	int fd;
+	for (fd = 0; fd < OPEN_MAX; ++fd) {
+		if (proc->files[fd] != NULL) {
+			file_handle_decref(proc->files[fd]);
+			proc->files[fd] = NULL;
+		}
 	}
 
+	spinlock_cleanup(&proc->ft_slotlock);
+	lock_destroy(proc->ft_lock);
+	proc->ft_lock = NULL;
+}
+
+/*
+ * Descriptor lookup for the I/O fast path. Does not touch ft_lock: the
+ * slot is read and the handle pinned under the slot spinlock, so a
+ * concurrent close can at worst make the handle unreachable from the
+ * table, never free it out from under us.
+ */
+struct file_handle *
+file_table_get(struct proc * proc, int fd)
+{
+	KASSERT(proc != NULL);
+
 	if (fd < 0 || fd >= OPEN_MAX) {
-		lock_release(ft->lk);
-		*retval = -1;
-		return EMFILE;
+		return NULL;
 	}
 
-	ft->files[fd] = (struct file_handle *)kmalloc(sizeof(struct file_handle));
-	if (ft->files[fd] == NULL) {
-		lock_release(ft->lk);
-		*retval = -1;
-		return ENOMEM;
-	}
+	spinlock_acquire(&proc->ft_slotlock);
 
-	ft->files[fd]->f_vnode = NULL;
-	ft->files[fd]->ref_count = 1;
-	ft->files[fd]->offset = 0;
-	ft->files[fd]->flags = flags;
-	ft->files[fd]->lk = lock_create(filename);
+	struct file_handle * fh = proc->files[fd];
 
-	if (ft->files[fd]->lk == NULL) {
-		kfree(ft->files[fd]);
-		ft->files[fd] = NULL;
-		lock_release(ft->lk);
-		*retval = -1;
-		return ENOMEM;
+	if (fh != NULL) {
+		file_handle_incref(fh);
 	}
 
-	if (flags & O_APPEND == O_APPEND) {
-		struct stat file_info;
-		memset(&file_info, 0, sizeof(file_info));
-		if (VOP_STAT(ft->files[fd]->f_vnode, &file_info)) {
-			*retval = -1;
-			return EIO;
-		}
-		ft->files[fd]->offset = st_size;
-	}
+	spinlock_release(&proc->ft_slotlock);
 
-	int result = vfs_open(filename, flags, 0664, &ft->files[fd]->f_vnode);
+	return fh;
+}
 
-	if (result) {
-		lock_destroy(ft->files[fd]->lk);
-		kfree(ft->files[fd]);
-		ft->files[fd] = NULL;
-		lock_release(ft->lk);
+/*
+ * Install fh in the lowest free slot. The table takes over the caller's
+ * reference.
+ */
+int
+file_table_add(struct proc * proc, struct file_handle * fh, int32_t * retval)
+{
+	KASSERT(proc != NULL);
+	KASSERT(fh != NULL);
+	KASSERT(retval != NULL);
+
+	lock_acquire(proc->ft_lock);
+
+	int fd = 0;
+
+	while (fd < OPEN_MAX && proc->files[fd] != NULL) {
+		++fd;
+	}
+
+	if (fd >= OPEN_MAX) {
+		lock_release(proc->ft_lock);
 		*retval = -1;
-		return result;
+		return EMFILE;
 	}
 
-	KASSERT(ft->files[fd]->f_vnode != NULL);
+	spinlock_acquire(&proc->ft_slotlock);
+	proc->files[fd] = fh;
+	spinlock_release(&proc->ft_slotlock);
 
-	lock_release(ft->lk);
+	lock_release(proc->ft_lock);
 
-	*retval = fd; 
+	*retval = fd;
 	return 0;
 }
+
+/*
+ * Store fh (which may be NULL) in slot fd and return what was there
+ * before. The table takes over the caller's reference to fh, and the
+ * caller gets the table's reference to the old handle, which it must
+ * drop with file_handle_decref once it is no longer holding ft_lock.
+ */
+struct file_handle *
+file_table_replace(struct proc * proc, int fd, struct file_handle * fh)
+{
+	KASSERT(proc != NULL);
+	KASSERT(fd >= 0 && fd < OPEN_MAX);
+	KASSERT(lock_do_i_hold(proc->ft_lock));
+
+	spinlock_acquire(&proc->ft_slotlock);
+	struct file_handle * old = proc->files[fd];
+	proc->files[fd] = fh;
+	spinlock_release(&proc->ft_slotlock);
+
+	return old;
+}
@@ -58,9 +58,9 @@
  */
 struct proc *kproc = NULL;
 
-static int init_console_handles(struct file_handle ** files);
-static int create_console(struct file_handle ** files, int fd, int flags);
-static void destroy_file_handle(struct file_handle ** files, int fd);
+static int init_console_handles(struct proc * proc);
+static void usage_add(struct threadusage *to, const struct threadusage *from);
+static int create_console(struct proc * proc, int fd, int flags);
 
 /*
  * Create a proc structure.
@@ -90,6 +90,17 @@ proc_create(const char *name)
 	/* VFS fields */
 	proc->p_cwd = NULL;
 
+	/* Usage */
+	bzero(&proc->p_usage, sizeof(proc->p_usage));
+	bzero(&proc->p_childusage, sizeof(proc->p_childusage));
+
+	if (file_table_init(proc)) {
+		spinlock_cleanup(&proc->p_lock);
+		kfree(proc->p_name);
+		kfree(proc);
+		return NULL;
+	}
+
 	/*
 	 * If kproc is null, it means we are currently bootstrapping 
 	 * the kernel process, which occurs before bootstrapping vfs.
@@ -101,18 +112,11 @@ proc_create(const char *name)
 		return proc;
 	}
 
-	proc->ft_lock = lock_create("file_table_lock");
-
-	if (proc->ft_lock == NULL) {
+	if (init_console_handles(proc)) {
+		file_table_cleanup(proc);
 		spinlock_cleanup(&proc->p_lock);
-		return NULL;
-	}
-
-	memset(proc->files, 0, sizeof(proc->files));
-
-	if (init_console_handles(proc->files)) {
-		spinlock_cleanup(&proc->p_lock);
-		lock_destroy(proc->ft_lock);
+		kfree(proc->p_name);
+		kfree(proc);
 		return NULL;
 	}
 
@@ -202,15 +206,7 @@ proc_destroy(struct proc *proc)
 	KASSERT(proc->p_numthreads == 0);
 	spinlock_cleanup(&proc->p_lock);
 
-	lock_destroy(proc->ft_lock);
-
-	int fd;
-	for (fd = 0; fd < OPEN_MAX; ++fd) {
-		if (proc->files[fd]) {
-			destroy_file_handle(proc->files, fd);
-			KASSERT(proc->files[fd] == NULL); // Make sure the handle is nulled-out
-		}
-	}
+	file_table_cleanup(proc);
 
 	kfree(proc->p_name);
 	kfree(proc);
@@ -310,16 +306,58 @@ proc_remthread(struct thread *t)
 	proc = t->t_proc;
 	KASSERT(proc != NULL);
 
+	/*
+	 * Hand the thread's usage over to the process. Interrupts go off
+	 * first so a hardclock can't land between the add and the reset.
+	 */
+	spl = splhigh();
 	spinlock_acquire(&proc->p_lock);
 	KASSERT(proc->p_numthreads > 0);
 	proc->p_numthreads--;
+	usage_add(&proc->p_usage, &t->t_usage);
 	spinlock_release(&proc->p_lock);
+	bzero(&t->t_usage, sizeof(t->t_usage));
 
-	spl = splhigh();
 	t->t_proc = NULL;
 	splx(spl);
 }
 
+/*
+ * Only the calling thread's live counters can be read safely, so other
+ * threads still in PROC aren't counted until they leave. (User
+ * processes only have one thread.)
+ */
+void
+proc_getusage(struct proc *proc, struct threadusage *ret)
+{
+	int spl;
+
+	spl = splhigh();
+	spinlock_acquire(&proc->p_lock);
+	*ret = proc->p_usage;
+	spinlock_release(&proc->p_lock);
+	if (curthread->t_proc == proc) {
+		usage_add(ret, &curthread->t_usage);
+	}
+	splx(spl);
+}
+
+void
+proc_addchildusage(struct proc *parent, struct proc *child)
+{
+	struct threadusage total;
+
+	spinlock_acquire(&child->p_lock);
+	KASSERT(child->p_numthreads == 0);
+	total = child->p_usage;
+	usage_add(&total, &child->p_childusage);
+	spinlock_release(&child->p_lock);
+
+	spinlock_acquire(&parent->p_lock);
+	usage_add(&parent->p_childusage, &total);
+	spinlock_release(&parent->p_lock);
+}
+
 /*
  * Fetch the address space of (the current) process.
  *
@@ -364,99 +402,98 @@ proc_setas(struct addrspace *newas)
 }
 
 static int 
-init_console_handles(struct file_handle ** files) 
+init_console_handles(struct proc * proc) 
 {
-	KASSERT(files != NULL);
+	KASSERT(proc != NULL);
 
-	int result = create_console(files, STDIN_FILENO, O_RDONLY);
+	int result = create_console(proc, STDIN_FILENO, O_RDONLY);
 
 	if (result) {
 		return result;
 	}
 
-	result = create_console(files, STDOUT_FILENO, O_WRONLY);
+	result = create_console(proc, STDOUT_FILENO, O_WRONLY);
 
 	if (result) {
-		destroy_file_handle(files, STDIN_FILENO);
 		return result;
 	}
 
-	result = create_console(files, STDERR_FILENO, O_WRONLY);
+	result = create_console(proc, STDERR_FILENO, O_WRONLY);
 
 	if (result) {
-		destroy_file_handle(files, STDIN_FILENO);
-		destroy_file_handle(files, STDOUT_FILENO);
 		return result;
 	}
 
 	return 0;
 }
 
+/*
+ * Open the console on descriptor fd. On failure, the descriptors opened
+ * so far are left for file_table_cleanup to drop.
+ */
 static int 
-create_console(struct file_handle ** files, int fd, int flags)  
+create_console(struct proc * proc, int fd, int flags)  
 {
-	KASSERT(files != NULL);
+	KASSERT(proc != NULL);
 
-	if (fd < 0 || fd >= OPEN_MAX || files[fd] != NULL) {
+	if (fd < 0 || fd >= OPEN_MAX || proc->files[fd] != NULL) {
 		return EINVAL;
 	}
 
-	files[fd] = kmalloc(sizeof(struct file_handle));
+	char * console_name = kstrdup("con:");
 
-	if (files[fd] == NULL) {
+	if (console_name == NULL) {
 		return ENOMEM;
 	}
 
-	files[fd]->ref_count = 1;
-	files[fd]->offset = 0;
-	files[fd]->flags = flags;
+	struct vnode * vn;
+	int result = vfs_open(console_name, flags, 0664, &vn);
+
+	kfree(console_name);
+
+	if (result) {
+		kprintf("FAILED TO OPEN CONSOLE");
+		return result;
+	}
+
+	const char * lock_name;
 
 	if (fd == STDIN_FILENO) {
-		files[fd]->lk = lock_create("stdin_lock");
+		lock_name = "stdin_lock";
 	}
 	else if (fd == STDOUT_FILENO) {
-		files[fd]->lk = lock_create("stdout_lock");
+		lock_name = "stdout_lock";
 	}
 	else {
-		files[fd]->lk = lock_create("stderr_lock");
+		lock_name = "stderr_lock";
 	}
 
-	if (files[fd]->lk == NULL) {
-		kfree(files[fd]);
-		files[fd] = NULL;
-		return ENOMEM;
-	}
-
-	char * console_name = kstrdup("con:");
-
-	if (console_name == NULL) {
-		kfree(files[fd]);
-		files[fd] = NULL;
-		return ENOMEM;
-	}
-
-	int result = vfs_open(console_name, files[fd]->flags, 0664, &files[fd]->f_vnode);
+	struct file_handle * fh;
+	result = file_handle_create(lock_name, vn, flags, &fh);
 
 	if (result) {
-		kprintf("FAILED TO OPEN CONSOLE");
-		kfree(console_name);
-		destroy_file_handle(files, fd);
+		vfs_close(vn);
 		return result;
 	}
 
-	kfree(console_name);
+	/* Nothing else can see the new process yet. */
+	lock_acquire(proc->ft_lock);
+	struct file_handle * old = file_table_replace(proc, fd, fh);
+	KASSERT(old == NULL);
+	lock_release(proc->ft_lock);
 
 	return 0;
 }
 
-static void destroy_file_handle(struct file_handle ** files, int fd) 
+static
+void
+usage_add(struct threadusage *to, const struct threadusage *from)
 {
-	KASSERT(files != NULL);
-
-	if (files != NULL && fd >= 0 && fd < OPEN_MAX && files[fd] != NULL) {
-		vfs_close(files[fd]->f_vnode);
-		lock_destroy(files[fd]->lk);
-		kfree(files[fd]);
-		files[fd] = NULL;
-	}
+	to->tu_uticks += from->tu_uticks;
+	to->tu_sticks += from->tu_sticks;
+	to->tu_faults += from->tu_faults;
+	to->tu_nvcsw += from->tu_nvcsw;
+	to->tu_nivcsw += from->tu_nivcsw;
+	to->tu_inbytes += from->tu_inbytes;
+	to->tu_outbytes += from->tu_outbytes;
 }
@@ -6,6 +6,7 @@
 #include <synch.h>
 #include <vfs.h>
 #include <vnode.h>
+#include <file_table.h>
 #include <kern/errno.h>
 
 int 
@@ -21,38 +22,20 @@ sys_close(int fd, int32_t * retval)
 
 	lock_acquire(curproc->ft_lock);
 
-	if (curproc->files[fd] == NULL) {
-		lock_release(curproc->ft_lock);
-		*retval = -1;
-		return EBADF;
-	}
-
-	lock_acquire(curproc->files[fd]->lk);
-
-	--curproc->files[fd]->ref_count;
-
-	KASSERT(curproc->files[fd]->ref_count >= 0);
-
-	if (curproc->files[fd]->ref_count == 0) {
-		if (curproc->files[fd]->f_vnode != NULL) {
-			vfs_close(curproc->files[fd]->f_vnode);
-		}
+	struct file_handle * fh = file_table_replace(curproc, fd, NULL);
 
-		struct lock * lk = curproc->files[fd]->lk;
-
-		kfree(curproc->files[fd]);
-		curproc->files[fd] = NULL;
-
-		lock_release(lk);
-		lock_release(curproc->ft_lock);
-		lock_destroy(lk);
+	lock_release(curproc->ft_lock);
 
-		*retval = 0;
-		return 0;
+	if (fh == NULL) {
+		*retval = -1;
+		return EBADF;
 	}
 
-	lock_release(curproc->files[fd]->lk);
-	lock_release(curproc->ft_lock);
+	/*
+	 * Drop the slot's reference. If a read or write on this handle is
+	 * still in progress, the last one out closes the vnode.
+	 */
+	file_handle_decref(fh);
 
 	*retval = 0;
 	return 0;
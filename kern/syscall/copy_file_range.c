@@ -0,0 +1,139 @@
+#include <types.h>
+#include <syscall.h>
+#include <current.h>
+#include <proc.h>
+#include <synch.h>
+#include <lib.h>
+#include <uio.h>
+#include <vnode.h>
+#include <file_table.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/iovec.h>
+
+/* How much to move per VOP_READ/VOP_WRITE pair */
+#define COPY_CHUNK (16 * 1024)
+
+/* Most we copy in one call, so the count fits in the return value */
+#define COPY_MAX 0x7fffffff
+
+/*
+ * Copy up to len bytes from infd to outfd without going through user
+ * memory. Both descriptors' offsets are used and advanced, as if by a
+ * read() followed by a write(). Returns the number of bytes copied,
+ * which is short only at end of file or on error after some progress,
+ * and never more than COPY_MAX.
+ */
+int
+sys_copy_file_range(int infd, int outfd, size_t len, int32_t * retval)
+{
+	KASSERT(retval != NULL);
+	KASSERT(curproc != NULL);
+
+	struct file_handle * in = file_table_get(curproc, infd);
+
+	if (in == NULL) {
+		*retval = -1;
+		return EBADF;
+	}
+
+	struct file_handle * out = file_table_get(curproc, outfd);
+
+	if (out == NULL) {
+		file_handle_decref(in);
+		*retval = -1;
+		return EBADF;
+	}
+
+	int result = 0;
+
+	if ((in->flags & O_ACCMODE) == O_WRONLY || (out->flags & O_ACCMODE) == O_RDONLY) {
+		result = EBADF;
+	}
+	else if (in == out) {
+		/* One offset can't be both source and destination. */
+		result = EINVAL;
+	}
+
+	char * kbuf = NULL;
+
+	if (!result) {
+		kbuf = kmalloc(COPY_CHUNK);
+		if (kbuf == NULL) {
+			result = ENOMEM;
+		}
+	}
+
+	if (result) {
+		file_handle_decref(out);
+		file_handle_decref(in);
+		*retval = -1;
+		return result;
+	}
+
+	/* Take the handle locks in a fixed order so two copies can't deadlock. */
+	struct lock * first = in < out ? in->lk : out->lk;
+	struct lock * second = in < out ? out->lk : in->lk;
+
+	lock_acquire(first);
+	lock_acquire(second);
+
+	if (len > COPY_MAX) {
+		len = COPY_MAX;
+	}
+
+	size_t total = 0;
+
+	while (total < len) {
+		size_t chunk = len - total;
+		if (chunk > COPY_CHUNK) {
+			chunk = COPY_CHUNK;
+		}
+
+		struct iovec iov;
+		struct uio ku;
+
+		uio_kinit(&iov, &ku, kbuf, chunk, in->offset, UIO_READ);
+		result = VOP_READ(in->f_vnode, &ku);
+		if (result) {
+			break;
+		}
+
+		size_t got = chunk - ku.uio_resid;
+		if (got == 0) {
+			break;
+		}
+		in->offset = ku.uio_offset;
+
+		uio_kinit(&iov, &ku, kbuf, got, out->offset, UIO_WRITE);
+		result = VOP_WRITE(out->f_vnode, &ku);
+
+		size_t put = got - ku.uio_resid;
+		out->offset = ku.uio_offset;
+		total += put;
+
+		if (put < got) {
+			/* Short or failed write; don't lose the bytes we read. */
+			in->offset -= got - put;
+			break;
+		}
+		if (result) {
+			break;
+		}
+	}
+
+	lock_release(second);
+	lock_release(first);
+
+	kfree(kbuf);
+	file_handle_decref(out);
+	file_handle_decref(in);
+
+	if (result && total == 0) {
+		*retval = -1;
+		return result;
+	}
+
+	*retval = total;
+	return 0;
+}
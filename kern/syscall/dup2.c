@@ -2,6 +2,9 @@
 #include <types.h>
 #include <current.h>
 #include <limits.h>
+#include <proc.h>
+#include <synch.h>
+#include <file_table.h>
 #include <kern/errno.h>
 
 int 
@@ -22,43 +25,24 @@ sys_dup2(int oldfd, int newfd, int32_t * retval)
 
 	lock_acquire(curproc->ft_lock);
 
-	if (curproc->files[oldfd] == NULL) {
+	/* The reference taken here becomes newfd's. */
+	struct file_handle * fh = file_table_get(curproc, oldfd);
+
+	if (fh == NULL) {
 		lock_release(curproc->ft_lock);
 		*retval = -1;
 		return EBADF;
 	}
 
 	// Close the already opened file
-	if (curproc->files[newfd] != NULL) {
-		struct lock * lk = curproc->files[newfd]->lk;
-		lock_acquire(lk);
+	struct file_handle * old = file_table_replace(curproc, newfd, fh);
 
-		--curproc->files[newfd]->ref_count;
-		
-		KASSERT(curproc->files[newfd]->ref_count >= 0);
+	lock_release(curproc->ft_lock);
 
-		if (curproc->files[newfd]->ref_count == 0) {
-			vfs_close(curproc->files[newfd]->f_vnode);
-			curproc->files[newfd] = NULL;
-			lock_release(lk);
-			lock_destroy(lk);
-		}
-		else {
-			curproc->files[newfd] = NULL;
-			lock_release(lk);
-		}
+	if (old != NULL) {
+		file_handle_decref(old);
 	}
 
-	KASSERT(curproc->files[newfd] == NULL);
-
-	lock_acquire(curproc->files[oldfd]->lk);
-
-	curproc->files[newfd] = curproc->files[oldfd];
-	++curproc->files[oldfd]->ref_count;
-
-	lock_release(curproc->files[oldfd]->lk);
-	lock_release(curproc->ft_lock);
-
 	*retval = newfd;
 
 	return 0;
@@ -0,0 +1,186 @@
+#include <types.h>
+#include <syscall.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <spinlock.h>
+#include <synch.h>
+#include <wchan.h>
+#include <copyinout.h>
+#include <lib.h>
+#include <kern/errno.h>
+
+/*
+ * Futexes: sleep until woken, keyed by a user address.
+ *
+ * A waiter is a record on the waiting thread's own stack, chained
+ * into one of FUTEX_NBUCKETS hash buckets by (address space, user
+ * address). Each bucket has one wchan; futex_wake marks the waiters
+ * it picks and wakes the whole wchan, and anyone not marked (a
+ * different address that hashed to the same bucket) goes back to
+ * sleep.
+ *
+ * fb_lock is held across futex_wait's check of the user's value and
+ * its queueing, and across futex_wake's search, so a wake can't slip
+ * in between the check and the sleep and get lost. It has to be a
+ * sleep lock because reading the value can fault. fb_spin protects the
+ * waiter list and goes with the wchan.
+ */
+
+#define FUTEX_NBUCKETS 64
+
+struct futex_waiter {
+	struct addrspace * fw_as;
+	vaddr_t fw_uaddr;
+	bool fw_woken;
+	struct futex_waiter * fw_next;
+};
+
+struct futex_bucket {
+	struct lock * fb_lock;
+	struct spinlock fb_spin;
+	struct wchan * fb_wchan;
+	struct futex_waiter * fb_waiters;
+};
+
+static struct futex_bucket futex_buckets[FUTEX_NBUCKETS];
+
+void
+futex_bootstrap(void)
+{
+	int i;
+
+	for (i = 0; i < FUTEX_NBUCKETS; ++i) {
+		futex_buckets[i].fb_lock = lock_create("futex");
+		futex_buckets[i].fb_wchan = wchan_create("futex");
+		if (futex_buckets[i].fb_lock == NULL || futex_buckets[i].fb_wchan == NULL) {
+			panic("futex_bootstrap: out of memory\n");
+		}
+		spinlock_init(&futex_buckets[i].fb_spin);
+		futex_buckets[i].fb_waiters = NULL;
+	}
+}
+
+static
+struct futex_bucket *
+futex_bucket(struct addrspace * as, vaddr_t uaddr)
+{
+	uint32_t key = (uint32_t)(uintptr_t)as ^ (uint32_t)(uaddr >> 2);
+
+	/* Fibonacci hashing; keep the top bits. */
+	key *= 2654435761U;
+	return &futex_buckets[key >> 26];
+}
+
+/*
+ * Sleep if *uaddr still equals val. Returns EAGAIN without sleeping if
+ * it doesn't.
+ */
+int
+sys_futex_wait(userptr_t uaddr, int val, int32_t * retval)
+{
+	KASSERT(retval != NULL);
+	KASSERT(curproc != NULL);
+
+	vaddr_t addr = (vaddr_t)uaddr;
+
+	if (addr % sizeof(int) != 0) {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	struct addrspace * as = proc_getas();
+	struct futex_bucket * fb = futex_bucket(as, addr);
+	int cur;
+
+	lock_acquire(fb->fb_lock);
+
+	int result = copyin((const_userptr_t)uaddr, &cur, sizeof(cur));
+
+	if (result) {
+		lock_release(fb->fb_lock);
+		*retval = -1;
+		return result;
+	}
+
+	if (cur != val) {
+		lock_release(fb->fb_lock);
+		*retval = -1;
+		return EAGAIN;
+	}
+
+	struct futex_waiter fw;
+	fw.fw_as = as;
+	fw.fw_uaddr = addr;
+	fw.fw_woken = false;
+	fw.fw_next = NULL;
+
+	/* Queue at the tail so wakeups go in arrival order. */
+	spinlock_acquire(&fb->fb_spin);
+	struct futex_waiter ** pp = &fb->fb_waiters;
+	while (*pp != NULL) {
+		pp = &(*pp)->fw_next;
+	}
+	*pp = &fw;
+
+	/* Safe to let wakers in now; they'll wait for fb_spin. */
+	lock_release(fb->fb_lock);
+
+	while (!fw.fw_woken) {
+		wchan_sleep(fb->fb_wchan, &fb->fb_spin);
+	}
+	spinlock_release(&fb->fb_spin);
+
+	*retval = 0;
+	return 0;
+}
+
+/*
+ * Wake up to count threads waiting on uaddr, oldest first. Returns how
+ * many were woken.
+ */
+int
+sys_futex_wake(userptr_t uaddr, int count, int32_t * retval)
+{
+	KASSERT(retval != NULL);
+	KASSERT(curproc != NULL);
+
+	vaddr_t addr = (vaddr_t)uaddr;
+
+	if (addr % sizeof(int) != 0 || count < 0) {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	struct addrspace * as = proc_getas();
+	struct futex_bucket * fb = futex_bucket(as, addr);
+	struct futex_waiter ** pp;
+	struct futex_waiter * fw;
+	int woken = 0;
+
+	lock_acquire(fb->fb_lock);
+	spinlock_acquire(&fb->fb_spin);
+
+	pp = &fb->fb_waiters;
+	while (*pp != NULL && woken < count) {
+		fw = *pp;
+		if (fw->fw_as == as && fw->fw_uaddr == addr) {
+			*pp = fw->fw_next;
+			fw->fw_woken = true;
+			++woken;
+		}
+		else {
+			pp = &fw->fw_next;
+		}
+	}
+
+	if (woken > 0) {
+		wchan_wakeall(fb->fb_wchan, &fb->fb_spin);
+	}
+
+	spinlock_release(&fb->fb_spin);
+	lock_release(fb->fb_lock);
+
+	*retval = woken;
+	return 0;
+}
@@ -0,0 +1,66 @@
+#include <types.h>
+#include <syscall.h>
+#include <current.h>
+#include <proc.h>
+#include <clock.h>
+#include <copyinout.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+
+static void ticks_to_timeval(uint32_t ticks, struct timeval * tv);
+
+/*
+ * Report resource usage of the calling process (RUSAGE_SELF) or of its
+ * reaped children (RUSAGE_CHILDREN). Only the fields we actually keep
+ * are filled in; the rest are zero.
+ */
+int
+sys_getrusage(int who, userptr_t usage, int32_t * retval)
+{
+	KASSERT(retval != NULL);
+	KASSERT(curproc != NULL);
+
+	struct threadusage tu;
+
+	if (who == RUSAGE_SELF) {
+		proc_getusage(curproc, &tu);
+	}
+	else if (who == RUSAGE_CHILDREN) {
+		spinlock_acquire(&curproc->p_lock);
+		tu = curproc->p_childusage;
+		spinlock_release(&curproc->p_lock);
+	}
+	else {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	struct rusage ru;
+	bzero(&ru, sizeof(ru));
+
+	ticks_to_timeval(tu.tu_uticks, &ru.ru_utime);
+	ticks_to_timeval(tu.tu_sticks, &ru.ru_stime);
+	ru.ru_minflt = tu.tu_faults;
+	ru.ru_nvcsw = tu.tu_nvcsw;
+	ru.ru_nivcsw = tu.tu_nivcsw;
+	ru.ru_inbytes = tu.tu_inbytes;
+	ru.ru_outbytes = tu.tu_outbytes;
+
+	int result = copyout(&ru, usage, sizeof(ru));
+
+	if (result) {
+		*retval = -1;
+		return result;
+	}
+
+	*retval = 0;
+	return 0;
+}
+
+static void
+ticks_to_timeval(uint32_t ticks, struct timeval * tv)
+{
+	tv->tv_sec = ticks / HZ;
+	tv->tv_usec = (ticks % HZ) * (1000000 / HZ);
+}
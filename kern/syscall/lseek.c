@@ -4,6 +4,7 @@
 #include <current.h>
 #include <limits.h>
 #include <vnode.h>
+#include <file_table.h>
 #include <kern/errno.h>
 #include <kern/seek.h>
 #include <kern/stat.h>
@@ -14,32 +15,25 @@ sys_lseek(int fd, off_t pos, int whence, int64_t * retval)
 	KASSERT(retval != NULL);
 	KASSERT(curproc != NULL);
 
-	if (fd < 0 || fd >= OPEN_MAX) {
+	if (whence != SEEK_SET && whence != SEEK_CUR && whence != SEEK_END) {
 		*retval = -1;
-		return EBADF;
+		return EINVAL;
 	}
 
-	lock_acquire(curproc->ft_lock);
+	struct file_handle * fh = file_table_get(curproc, fd);
 
-	if (curproc->files[fd] == NULL) {
-		lock_release(curproc->ft_lock);
+	if (fh == NULL) {
 		*retval = -1;
 		return EBADF;
 	}
 
-	if (whence != SEEK_SET && whence != SEEK_CUR && whence != SEEK_END) {
-		lock_release(curproc->ft_lock);
-		*retval = -1;
-		return EINVAL;
-	}
-
 	off_t seek_to = pos;
 
-	lock_acquire(curproc->files[fd]->lk);
-	lock_release(curproc->ft_lock);
+	lock_acquire(fh->lk);
 
-	if (!VOP_ISSEEKABLE(curproc->files[fd]->f_vnode)) {
-		lock_release(curproc->files[fd]->lk);
+	if (!VOP_ISSEEKABLE(fh->f_vnode)) {
+		lock_release(fh->lk);
+		file_handle_decref(fh);
 		*retval = -1;
 		return ESPIPE;
 	}
@@ -47,8 +41,9 @@ sys_lseek(int fd, off_t pos, int whence, int64_t * retval)
 	if (whence == SEEK_END) {
 		struct stat file_info;
 		memset(&file_info, 0, sizeof(file_info));
-		if (VOP_STAT(curproc->files[fd]->f_vnode, &file_info)) {
-			lock_release(curproc->files[fd]->lk);
+		if (VOP_STAT(fh->f_vnode, &file_info)) {
+			lock_release(fh->lk);
+			file_handle_decref(fh);
 			*retval = -1;
 			return ESPIPE;
 		}
@@ -56,18 +51,20 @@ sys_lseek(int fd, off_t pos, int whence, int64_t * retval)
 	}
 
 	else if (whence == SEEK_CUR) {
-		seek_to = pos + curproc->files[fd]->offset;
+		seek_to = pos + fh->offset;
 	}
 
 	if (seek_to < 0) {
-		lock_release(curproc->files[fd]->lk);
+		lock_release(fh->lk);
+		file_handle_decref(fh);
 		*retval = -1;
 		return EINVAL;
 	}
 
-	curproc->files[fd]->offset = seek_to;
+	fh->offset = seek_to;
 
-	lock_release(curproc->files[fd]->lk);
+	lock_release(fh->lk);
+	file_handle_decref(fh);
 
 	*retval = seek_to;
 
@@ -0,0 +1,136 @@
+#include <types.h>
+#include <syscall.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <vnode.h>
+#include <vm.h>
+#include <file_table.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/mman.h>
+#include <kern/stat.h>
+#include <kern/stattypes.h>
+
+int
+sys_mmap(userptr_t addr, size_t len, int prot, int flags, int fd, off_t offset, int32_t * retval)
+{
+	KASSERT(retval != NULL);
+	KASSERT(curproc != NULL);
+
+	/* The address is only a hint, and we don't take hints. */
+	(void)addr;
+
+	if (len == 0 || offset < 0 || offset % PAGE_SIZE != 0) {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	if ((flags & MAP_TYPE) != MAP_SHARED && (flags & MAP_TYPE) != MAP_PRIVATE) {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	struct file_handle * fh = file_table_get(curproc, fd);
+
+	if (fh == NULL) {
+		*retval = -1;
+		return EBADF;
+	}
+
+	int accmode = fh->flags & O_ACCMODE;
+
+	if (accmode == O_WRONLY ||
+	    ((flags & MAP_TYPE) == MAP_SHARED && (prot & PROT_WRITE) && accmode != O_RDWR)) {
+		file_handle_decref(fh);
+		*retval = -1;
+		return EACCES;
+	}
+
+	struct stat file_info;
+	int result = VOP_STAT(fh->f_vnode, &file_info);
+
+	if (result) {
+		file_handle_decref(fh);
+		*retval = -1;
+		return result;
+	}
+
+	if ((file_info.st_mode & _S_IFMT) != _S_IFREG) {
+		file_handle_decref(fh);
+		*retval = -1;
+		return ENODEV;
+	}
+
+	struct addrspace * as = proc_getas();
+	KASSERT(as != NULL);
+
+	vaddr_t vaddr;
+	result = as_map_file(as, len, prot, flags, fh->f_vnode, offset, &vaddr);
+
+	/* The mapping holds its own reference to the vnode. */
+	file_handle_decref(fh);
+
+	if (result) {
+		*retval = -1;
+		return result;
+	}
+
+	*retval = (int32_t)vaddr;
+	return 0;
+}
+
+int
+sys_munmap(userptr_t addr, size_t len, int32_t * retval)
+{
+	KASSERT(retval != NULL);
+	KASSERT(curproc != NULL);
+
+	vaddr_t vaddr = (vaddr_t)addr;
+
+	if (len == 0 || vaddr % PAGE_SIZE != 0 ||
+	    vaddr >= USERSPACETOP || len > USERSPACETOP - vaddr) {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	int result = as_unmap(proc_getas(), vaddr, len);
+
+	if (result) {
+		*retval = -1;
+		return result;
+	}
+
+	*retval = 0;
+	return 0;
+}
+
+int
+sys_msync(userptr_t addr, size_t len, int flags, int32_t * retval)
+{
+	KASSERT(retval != NULL);
+	KASSERT(curproc != NULL);
+
+	vaddr_t vaddr = (vaddr_t)addr;
+
+	if (vaddr % PAGE_SIZE != 0 || vaddr >= USERSPACETOP || len > USERSPACETOP - vaddr) {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	if ((flags & MS_ASYNC) && (flags & MS_SYNC)) {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	/* We have no background writer, so MS_ASYNC is synchronous too. */
+	int result = as_sync(proc_getas(), vaddr, len);
+
+	if (result) {
+		*retval = -1;
+		return result;
+	}
+
+	*retval = 0;
+	return 0;
+}
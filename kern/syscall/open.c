@@ -5,6 +5,8 @@
 #include <current.h>
 #include <proc.h>
 #include <vfs.h>
+#include <vnode.h>
+#include <kern/stat.h>
 #include <kern/fcntl.h>
 #include <kern/errno.h>
 #include <syscall.h>
@@ -35,13 +37,43 @@ sys_open(const_userptr_t filename, int flags, int32_t * retval)
 		return EINVAL;
 	}
 
-	result = file_table_add(curproc->file_table, safe_filename, flags, retval);
+	struct vnode * vn;
+	result = vfs_open(safe_filename, flags, 0664, &vn);
 
 	if (result) {
 		*retval = -1;
 		return result;
 	}
 
+	struct file_handle * fh;
+	result = file_handle_create(safe_filename, vn, flags, &fh);
+
+	if (result) {
+		vfs_close(vn);
+		*retval = -1;
+		return result;
+	}
+
+	if ((flags & O_APPEND) == O_APPEND) {
+		struct stat file_info;
+		memset(&file_info, 0, sizeof(file_info));
+		result = VOP_STAT(vn, &file_info);
+		if (result) {
+			file_handle_decref(fh);
+			*retval = -1;
+			return result;
+		}
+		fh->offset = file_info.st_size;
+	}
+
+	result = file_table_add(curproc, fh, retval);
+
+	if (result) {
+		file_handle_decref(fh);
+		*retval = -1;
+		return result;
+	}
+
 	return 0;
 }
 
@@ -6,6 +6,7 @@
 #include <limits.h>
 #include <uio.h>
 #include <vnode.h>
+#include <file_table.h>
 #include <kern/errno.h>
 #include <kern/fcntl.h>
 #include <kern/iovec.h>
@@ -16,20 +17,15 @@ sys_read(int fd, userptr_t buf, size_t buflen, int32_t * retval)
 	KASSERT(retval != NULL);
 	KASSERT(curproc != NULL);
 	
-	if (fd < 0 || fd >= OPEN_MAX) {
-		*retval = -1;
-		return EBADF;
-	}
+	struct file_handle * fh = file_table_get(curproc, fd);
 
-	lock_acquire(curproc->ft_lock);
-	if (curproc->files[fd] == NULL) {
-		lock_release(curproc->ft_lock);
+	if (fh == NULL) {
 		*retval = -1;
 		return EBADF;	
 	}
 
-	if ((curproc->files[fd]->flags & O_WRONLY) == O_WRONLY) {
-		lock_release(curproc->ft_lock);
+	if ((fh->flags & O_ACCMODE) == O_WRONLY) {
+		file_handle_decref(fh);
 		*retval = -1;
 		return EBADF;
 	}
@@ -51,20 +47,21 @@ sys_read(int fd, userptr_t buf, size_t buflen, int32_t * retval)
 	read_uio.uio_space = curproc->p_addrspace;
 	spinlock_release(&curproc->p_lock);
 
-	lock_acquire(curproc->files[fd]->lk);
-	lock_release(curproc->ft_lock);
+	lock_acquire(fh->lk);
 
-	read_uio.uio_offset = curproc->files[fd]->offset;
+	read_uio.uio_offset = fh->offset;
 
 	size_t amount_read = read_uio.uio_resid;
 
-	int result = VOP_READ(curproc->files[fd]->f_vnode, &read_uio);
+	int result = VOP_READ(fh->f_vnode, &read_uio);
 
 	amount_read -= read_uio.uio_resid;
+	curthread->t_usage.tu_inbytes += amount_read;
 
-	curproc->files[fd]->offset = read_uio.uio_offset;
+	fh->offset = read_uio.uio_offset;
 
-	lock_release(curproc->files[fd]->lk);
+	lock_release(fh->lk);
+	file_handle_decref(fh);
 
 	if (result) {
 		*retval = -1;
@@ -0,0 +1,31 @@
+#include <types.h>
+#include <syscall.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <kern/errno.h>
+
+int
+sys_sbrk(intptr_t amount, int32_t * retval)
+{
+	KASSERT(retval != NULL);
+	KASSERT(curproc != NULL);
+
+	struct addrspace * as = proc_getas();
+
+	if (as == NULL) {
+		*retval = -1;
+		return EINVAL;
+	}
+
+	vaddr_t oldbreak;
+	int result = as_sbrk(as, amount, &oldbreak);
+
+	if (result) {
+		*retval = -1;
+		return result;
+	}
+
+	*retval = (int32_t)oldbreak;
+	return 0;
+}
@@ -0,0 +1,52 @@
+#include <types.h>
+#include <syscall.h>
+#include <current.h>
+#include <proc.h>
+#include <fs.h>
+#include <vnode.h>
+#include <file_table.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+
+/*
+ * P or V on a semfs semaphore without going through read/write.
+ *
+ * There is no uio and no file offset involved, so this skips the
+ * handle lock entirely; the semaphore has its own. A P needs the
+ * descriptor open for reading and a V for writing, the same as the
+ * read and write they replace.
+ */
+int
+sys_sem_op(int fd, int delta, int32_t * retval)
+{
+	KASSERT(retval != NULL);
+	KASSERT(curproc != NULL);
+
+	struct file_handle * fh = file_table_get(curproc, fd);
+
+	if (fh == NULL) {
+		*retval = -1;
+		return EBADF;
+	}
+
+	int accmode = fh->flags & O_ACCMODE;
+
+	if ((delta < 0 && accmode == O_WRONLY) ||
+	    (delta > 0 && accmode == O_RDONLY)) {
+		file_handle_decref(fh);
+		*retval = -1;
+		return EBADF;
+	}
+
+	int result = semfs_semop(fh->f_vnode, delta);
+
+	file_handle_decref(fh);
+
+	if (result) {
+		*retval = -1;
+		return result;
+	}
+
+	*retval = 0;
+	return 0;
+}
@@ -0,0 +1,93 @@
+#include <types.h>
+#include <syscall.h>
+#include <current.h>
+#include <proc.h>
+#include <synch.h>
+#include <copyinout.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <pipe.h>
+#include <file_table.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+
+/*
+ * Make a pipe and install its read and write ends in the two lowest
+ * free descriptors, storing them in fds[0] and fds[1].
+ */
+int
+sys_pipe(userptr_t fds, int32_t * retval)
+{
+	KASSERT(retval != NULL);
+	KASSERT(curproc != NULL);
+
+	struct vnode * readvn;
+	struct vnode * writevn;
+
+	int result = pipe_create(&readvn, &writevn);
+
+	if (result) {
+		*retval = -1;
+		return result;
+	}
+
+	struct file_handle * readfh;
+	struct file_handle * writefh;
+
+	result = file_handle_create("pipe:r", readvn, O_RDONLY, &readfh);
+
+	if (result) {
+		vfs_close(readvn);
+		vfs_close(writevn);
+		*retval = -1;
+		return result;
+	}
+
+	result = file_handle_create("pipe:w", writevn, O_WRONLY, &writefh);
+
+	if (result) {
+		file_handle_decref(readfh);
+		vfs_close(writevn);
+		*retval = -1;
+		return result;
+	}
+
+	int kfds[2];
+
+	result = file_table_add(curproc, readfh, &kfds[0]);
+
+	if (result) {
+		file_handle_decref(readfh);
+		file_handle_decref(writefh);
+		*retval = -1;
+		return result;
+	}
+
+	result = file_table_add(curproc, writefh, &kfds[1]);
+
+	if (result) {
+		file_handle_decref(writefh);
+		goto fail_unadd;
+	}
+
+	result = copyout(kfds, fds, sizeof(kfds));
+
+	if (result) {
+		lock_acquire(curproc->ft_lock);
+		writefh = file_table_replace(curproc, kfds[1], NULL);
+		lock_release(curproc->ft_lock);
+		file_handle_decref(writefh);
+		goto fail_unadd;
+	}
+
+	*retval = 0;
+	return 0;
+
+fail_unadd:
+	lock_acquire(curproc->ft_lock);
+	readfh = file_table_replace(curproc, kfds[0], NULL);
+	lock_release(curproc->ft_lock);
+	file_handle_decref(readfh);
+	*retval = -1;
+	return result;
+}
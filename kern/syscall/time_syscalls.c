@@ -28,7 +28,9 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <clock.h>
+#include <timeout.h>
 #include <copyinout.h>
 #include <syscall.h>
 
@@ -56,3 +58,38 @@ sys___time(userptr_t user_seconds_ptr, userptr_t user_nanoseconds_ptr)
 
 	return 0;
 }
+
+/*
+ * Sleep for the time in *USER_REQ. Nothing interrupts the sleep, so
+ * the time remaining (if USER_REM isn't NULL) is always zero.
+ */
+int
+sys_nanosleep(const_userptr_t user_req, userptr_t user_rem)
+{
+	struct timespec ts;
+	int result;
+
+	result = copyin(user_req, &ts, sizeof(ts));
+	if (result) {
+		return result;
+	}
+	if (ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= 1000000000) {
+		return EINVAL;
+	}
+
+	result = timeout_sleep(&ts);
+	if (result) {
+		return result;
+	}
+
+	if (user_rem != NULL) {
+		ts.tv_sec = 0;
+		ts.tv_nsec = 0;
+		result = copyout(&ts, user_rem, sizeof(ts));
+		if (result) {
+			return result;
+		}
+	}
+
+	return 0;
+}
@@ -6,6 +6,7 @@
 #include <limits.h>
 #include <uio.h>
 #include <vnode.h>
+#include <file_table.h>
 #include <kern/errno.h>
 #include <kern/fcntl.h>
 #include <kern/iovec.h>
@@ -16,21 +17,15 @@ sys_write(int fd, const_userptr_t buf, size_t buflen, int32_t * retval)
 	KASSERT(retval != NULL);
 	KASSERT(curproc != NULL);
 	
-	if (fd < 0 || fd >= OPEN_MAX) {
-		*retval = -1;
-		return EBADF;
-	}
-
-	lock_acquire(curproc->ft_lock);
+	struct file_handle * fh = file_table_get(curproc, fd);
 
-	if (curproc->files[fd] == NULL) {
-		lock_release(curproc->ft_lock);
+	if (fh == NULL) {
 		*retval = -1;
 		return EBADF;	
 	}
 
-	if ((curproc->files[fd]->flags & O_WRONLY) != O_WRONLY && (curproc->files[fd]->flags & O_RDWR) != O_RDWR) {
-		lock_release(curproc->ft_lock);
+	if ((fh->flags & O_ACCMODE) == O_RDONLY) {
+		file_handle_decref(fh);
 		*retval = -1;
 		return EBADF;
 	}
@@ -52,20 +47,21 @@ sys_write(int fd, const_userptr_t buf, size_t buflen, int32_t * retval)
 	write_uio.uio_space = curproc->p_addrspace;
 	spinlock_release(&curproc->p_lock);
 
-	lock_acquire(curproc->files[fd]->lk);
-	lock_release(curproc->ft_lock);
+	lock_acquire(fh->lk);
 
-	write_uio.uio_offset = curproc->files[fd]->offset;
+	write_uio.uio_offset = fh->offset;
 
 	size_t amount_written = write_uio.uio_resid;
 
-	int result = VOP_WRITE(curproc->files[fd]->f_vnode, &write_uio);
+	int result = VOP_WRITE(fh->f_vnode, &write_uio);
 
 	amount_written -= write_uio.uio_resid;
+	curthread->t_usage.tu_outbytes += amount_written;
 
-	curproc->files[fd]->offset = write_uio.uio_offset;
+	fh->offset = write_uio.uio_offset;
 
-	lock_release(curproc->files[fd]->lk);
+	lock_release(fh->lk);
+	file_handle_decref(fh);
 
 	if (result) {
 		*retval = -1;
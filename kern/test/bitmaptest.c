@@ -28,6 +28,7 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <bitmap.h>
 #include <test.h>
@@ -101,6 +102,30 @@ bitmaptest(int nargs, char **args)
 		KASSERT(data[i]==0);
 	}
 
+	/* Clear a run that starts and ends partway through words */
+	bitmap_unmark_range(b, 5, 300);
+	for (i=0; i<TESTSIZE; i++) {
+		if (i >= 5 && i < 305) {
+			KASSERT(bitmap_isset(b, i)==0);
+		}
+		else {
+			KASSERT(bitmap_isset(b, i));
+		}
+	}
+
+	/* Allocating in a range takes the lowest clear bit in it */
+	KASSERT(bitmap_alloc_range(b, 305, TESTSIZE, &x) == ENOSPC);
+	KASSERT(bitmap_alloc_range(b, 0, 5, &x) == ENOSPC);
+	for (i=100; i<305; i++) {
+		KASSERT(bitmap_alloc_range(b, 100, TESTSIZE, &x) == 0);
+		KASSERT(x == (uint32_t)i);
+	}
+	for (i=5; i<100; i++) {
+		KASSERT(bitmap_alloc_range(b, 0, 100, &x) == 0);
+		KASSERT(x == (uint32_t)i);
+	}
+	KASSERT(bitmap_alloc(b, &x) == ENOSPC);
+
 	kprintf("Bitmap test complete\n");
 	return 0;
 }
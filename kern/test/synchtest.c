@@ -35,6 +35,7 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <clock.h>
 #include <thread.h>
@@ -957,15 +958,38 @@ init_items()
 	}
 }
 
+/*
+ * rwt1 takes an optional policy (phasefair, reader, or writer) and
+ * runs against a fresh lock created with it.
+ */
 int rwtest(int nargs, char **args) {
-	(void)nargs;
-	(void)args;
-
 	int i;
 	int result;
+	enum rwlock_policy policy;
 
 	init_items();
 
+	if (nargs > 1) {
+		if (!strcmp(args[1], "phasefair")) {
+			policy = RWLOCK_PHASE_FAIR;
+		}
+		else if (!strcmp(args[1], "reader")) {
+			policy = RWLOCK_READER_PREF;
+		}
+		else if (!strcmp(args[1], "writer")) {
+			policy = RWLOCK_WRITER_PREF;
+		}
+		else {
+			kprintf("Usage: rwt1 [phasefair|reader|writer]\n");
+			return EINVAL;
+		}
+		rwlock_destroy(testrwl);
+		testrwl = rwlock_create_policy("rwlocktest lock", policy);
+		if (testrwl == NULL) {
+			panic("rwtest: rwlock_create_policy failed\n");
+		}
+	}
+
 	rwtestval = 0;
 
 	kprintf("Starting rwt1...\n");
@@ -0,0 +1,197 @@
+/*
+ * Timeout test.
+ *
+ * Checks that timeouts fire, in order and not early; that cancelled
+ * ones don't fire; that a periodic timeout keeps to its schedule; and
+ * that cv_timedwait both times out and gets woken.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <timeout.h>
+#include <test.h>
+
+#define NTIMEOUTS 8
+#define NPERIODS 10
+#define PERIOD 20000	/* microseconds */
+
+/* Delays in microseconds, deliberately out of order. */
+static const unsigned delays[NTIMEOUTS] = {
+	50000, 150, 7000, 1200000, 300, 20000, 500000, 7000,
+};
+
+static struct timespec fired[NTIMEOUTS];
+static struct semaphore *firedsem;
+static volatile bool cancelfired;
+
+static struct timeout periodic;
+static struct timespec periodic_interval;
+static volatile unsigned periods;
+
+static struct lock *totlock;
+static struct cv *totcv;
+
+static
+void
+usec_to_timespec(unsigned usec, struct timespec *ts)
+{
+	ts->tv_sec = usec / 1000000;
+	ts->tv_nsec = (usec % 1000000) * 1000;
+}
+
+/* Microseconds from START to END; negative if END comes first. */
+static
+int
+elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000000 +
+		(end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+static
+void
+tot_fire(void *data)
+{
+	unsigned i = (uintptr_t)data;
+
+	gettime(&fired[i]);
+	V(firedsem);
+}
+
+static
+void
+tot_cancelled(void *data)
+{
+	(void)data;
+	cancelfired = true;
+}
+
+static
+void
+tot_periodic(void *data)
+{
+	(void)data;
+	if (++periods < NPERIODS) {
+		timeout_readd(&periodic, &periodic_interval);
+	}
+	else {
+		V(firedsem);
+	}
+}
+
+static
+void
+tot_signaller(void *p, unsigned long n)
+{
+	struct timespec ts;
+	int result;
+
+	(void)p;
+	(void)n;
+
+	usec_to_timespec(10000, &ts);
+	result = timeout_sleep(&ts);
+	KASSERT(result == 0);
+	lock_acquire(totlock);
+	cv_signal(totcv, totlock);
+	lock_release(totlock);
+}
+
+int
+timeouttest(int nargs, char **args)
+{
+	struct timeout timeouts[NTIMEOUTS], t;
+	struct timespec start, now, ts;
+	unsigned i, j;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting timeout test...\n");
+
+	firedsem = sem_create("timeouttest", 0);
+	totlock = lock_create("timeouttest");
+	totcv = cv_create("timeouttest");
+	KASSERT(firedsem != NULL && totlock != NULL && totcv != NULL);
+
+	/* Firing: each no earlier than asked, and in order of delay. */
+	gettime(&start);
+	for (i=0; i<NTIMEOUTS; i++) {
+		timeout_init(&timeouts[i], tot_fire, (void *)(uintptr_t)i);
+		usec_to_timespec(delays[i], &ts);
+		timeout_add(&timeouts[i], &ts);
+	}
+	for (i=0; i<NTIMEOUTS; i++) {
+		P(firedsem);
+	}
+	for (i=0; i<NTIMEOUTS; i++) {
+		KASSERT(elapsed(&start, &fired[i]) >= (int)delays[i]);
+		KASSERT(!timeout_cancel(&timeouts[i]));
+		for (j=0; j<NTIMEOUTS; j++) {
+			if (delays[j] < delays[i]) {
+				KASSERT(elapsed(&fired[j], &fired[i]) >= 0);
+			}
+		}
+		kprintf("  %7u us: fired after %d us\n", delays[i],
+			elapsed(&start, &fired[i]));
+	}
+
+	/* Cancelling. */
+	cancelfired = false;
+	timeout_init(&t, tot_cancelled, NULL);
+	usec_to_timespec(20000, &ts);
+	timeout_add(&t, &ts);
+	KASSERT(timeout_cancel(&t));
+	usec_to_timespec(50000, &ts);
+	result = timeout_sleep(&ts);
+	KASSERT(result == 0);
+	KASSERT(!cancelfired);
+
+	/* Periodic: due every PERIOD from the first, however late each runs. */
+	periods = 0;
+	usec_to_timespec(PERIOD, &periodic_interval);
+	timeout_init(&periodic, tot_periodic, NULL);
+	gettime(&start);
+	timeout_add(&periodic, &periodic_interval);
+	P(firedsem);
+	gettime(&now);
+	KASSERT(periods == NPERIODS);
+	KASSERT(elapsed(&start, &now) >= NPERIODS * PERIOD);
+	kprintf("  %d x %d us periodic: done after %d us\n", NPERIODS, PERIOD,
+		elapsed(&start, &now));
+
+	/* cv_timedwait with nobody to signal. */
+	lock_acquire(totlock);
+	gettime(&start);
+	usec_to_timespec(30000, &ts);
+	result = cv_timedwait(totcv, totlock, &ts);
+	gettime(&now);
+	KASSERT(result == ETIMEDOUT);
+	KASSERT(elapsed(&start, &now) >= 30000);
+	kprintf("  cv_timedwait timed out after %d us\n",
+		elapsed(&start, &now));
+
+	/* ...and with somebody. */
+	result = thread_fork("timeouttest", NULL, tot_signaller, NULL, 0);
+	KASSERT(result == 0);
+	gettime(&start);
+	usec_to_timespec(5000000, &ts);
+	result = cv_timedwait(totcv, totlock, &ts);
+	gettime(&now);
+	KASSERT(result == 0);
+	lock_release(totlock);
+	kprintf("  cv_timedwait signalled after %d us\n",
+		elapsed(&start, &now));
+
+	cv_destroy(totcv);
+	lock_destroy(totlock);
+	sem_destroy(firedsem);
+
+	kprintf("Timeout test complete\n");
+	return 0;
+}
@@ -34,13 +34,13 @@
 #include <clock.h>
 #include <thread.h>
 #include <current.h>
+#include <timeout.h>
 
 /*
  * Time handling.
  *
- * This is pretty primitive. A real kernel will typically have some
- * kind of support for scheduling callbacks to happen at specific
- * points in the future, usually with more resolution than one second.
+ * Callbacks at specific points in the future are timeouts; see
+ * timeout.c. timerclock is one of them.
  *
  * A real kernel also has to maintain the time of day; in OS/161 we
  * skimp on that because we have a known-good hardware clock.
@@ -59,6 +59,11 @@
 static struct wchan *lbolt;
 static struct spinlock lbolt_lock;
 
+static struct timeout timerclock_timeout;
+static const struct timespec timerclock_interval = { 1, 0 };
+
+static void timerclock_expire(void *data);
+
 /*
  * Setup.
  */
@@ -70,6 +75,9 @@ hardclock_bootstrap(void)
 	if (lbolt == NULL) {
 		panic("Couldn't create lbolt\n");
 	}
+
+	timeout_init(&timerclock_timeout, timerclock_expire, NULL);
+	timeout_add(&timerclock_timeout, &timerclock_interval);
 }
 
 /*
@@ -85,16 +93,31 @@ timerclock(void)
 	spinlock_release(&lbolt_lock);
 }
 
+static
+void
+timerclock_expire(void *data)
+{
+	(void)data;
+	timerclock();
+	timeout_readd(&timerclock_timeout, &timerclock_interval);
+}
+
 /*
- * This is called HZ times a second (on each processor) by the timer
- * code.
+ * This is called HZ times a second (on each processor that isn't
+ * idle) by the timer code.
  */
 void
 hardclock(void)
 {
-	/*
-	 * Collect statistics here as desired.
-	 */
+	/* Charge the tick to whoever it interrupted (nobody, if idle) */
+	if (!curcpu->c_isidle) {
+		if (curthread->t_intr_user) {
+			curthread->t_usage.tu_uticks++;
+		}
+		else {
+			curthread->t_usage.tu_sticks++;
+		}
+	}
 
 	curcpu->c_hardclocks++;
 	if ((curcpu->c_hardclocks % MIGRATE_HARDCLOCKS) == 0) {
@@ -0,0 +1,127 @@
+/*
+ * Sampling profiler.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <thread.h>
+#include <current.h>
+#include <clock.h>
+#include <profile.h>
+
+/*
+ * Samples per cpu: 40 seconds' worth at HZ=100. Once a cpu's buffer
+ * is full further samples are counted but not kept; for a profile
+ * that loses nothing but resolution.
+ */
+#define PROF_NSAMPLES	4096
+
+struct recbuf prof_buf =
+	RECBUF_INITIALIZER(sizeof(struct prof_sample), PROF_NSAMPLES, false);
+
+/*
+ * Called from the timer interrupt with the interrupted pc and ra.
+ */
+void
+prof_sample(vaddr_t pc, vaddr_t ra)
+{
+	struct prof_sample *ps;
+	unsigned cpunum;
+	int spl;
+
+	ps = recbuf_begin(&prof_buf, &cpunum, &spl);
+	if (ps == NULL) {
+		return;
+	}
+
+	ps->ps_pc = pc;
+	ps->ps_ra = ra;
+	ps->ps_thread = (uint32_t)(uintptr_t)curthread;
+	ps->ps_cpu = cpunum;
+	ps->ps_flags = 0;
+	if (curcpu->c_isidle) {
+		ps->ps_flags |= PROF_IDLE;
+	}
+	else if (curthread->t_intr_user) {
+		ps->ps_flags |= PROF_USER;
+	}
+
+	recbuf_end(&prof_buf, cpunum, spl);
+}
+
+/*
+ * Called when the hardclock comes back on after being off while the
+ * cpu was idle, with the number of ticks it missed.
+ */
+void
+prof_idleticks(unsigned ticks)
+{
+	struct prof_sample *ps;
+	unsigned cpunum;
+	int spl;
+
+	if (ticks == 0) {
+		return;
+	}
+	ps = recbuf_begin(&prof_buf, &cpunum, &spl);
+	if (ps == NULL) {
+		return;
+	}
+
+	ps->ps_pc = ticks;
+	ps->ps_ra = 0;
+	ps->ps_thread = (uint32_t)(uintptr_t)curthread;
+	ps->ps_cpu = cpunum;
+	ps->ps_flags = PROF_IDLE | PROF_IDLESPAN;
+
+	recbuf_end(&prof_buf, cpunum, spl);
+}
+
+/*
+ * Throw away any samples (allocating the buffers the first time) and
+ * start sampling.
+ */
+int
+prof_start(void)
+{
+	return recbuf_start(&prof_buf);
+}
+
+/*
+ * Stop sampling, and wait until no cpu is still taking a sample.
+ */
+void
+prof_stop(void)
+{
+	recbuf_stop(&prof_buf);
+}
+
+/*
+ * Stop sampling and write the samples to PATH (which gets clobbered,
+ * as with vfs_open).
+ */
+int
+prof_dump(char *path)
+{
+	struct prof_header ph;
+	unsigned kept, dropped;
+	int result;
+
+	prof_stop();
+
+	ph.ph_magic = PROF_MAGIC;
+	ph.ph_version = PROF_VERSION;
+	ph.ph_ncpus = prof_buf.rb_ncpus;
+	ph.ph_hz = HZ;
+	recbuf_counts(&prof_buf, &kept, &dropped);
+	ph.ph_nsamples = kept;
+	ph.ph_dropped = dropped;
+
+	result = recbuf_dump(&prof_buf, path, &ph, sizeof(ph));
+	if (result == 0) {
+		kprintf("prof: wrote %u samples (%u dropped)\n",
+			ph.ph_nsamples, ph.ph_dropped);
+	}
+	return result;
+}
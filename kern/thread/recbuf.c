@@ -0,0 +1,248 @@
+/*
+ * Per-cpu record buffers; see <recbuf.h>.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spl.h>
+#include <membar.h>
+#include <current.h>
+#include <uio.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <recbuf.h>
+
+/*
+ * One cpu's records. Only the owning cpu writes them.
+ */
+struct recbuf_cpu {
+	volatile bool rc_busy;		/* a record is being filled in */
+	unsigned rc_count;		/* records ever offered */
+	char *rc_records;
+};
+
+/*
+ * Where the oldest kept record is, and how many there are.
+ */
+static
+void
+recbuf_kept(struct recbuf *rb, struct recbuf_cpu *rc,
+	    unsigned *first, unsigned *n)
+{
+	if (rc->rc_count <= rb->rb_nrecs) {
+		*first = 0;
+		*n = rc->rc_count;
+	}
+	else {
+		*first = rb->rb_wrap ? rc->rc_count % rb->rb_nrecs : 0;
+		*n = rb->rb_nrecs;
+	}
+}
+
+static
+void
+recbuf_free(struct recbuf *rb, unsigned ncpus)
+{
+	unsigned i;
+
+	for (i=0; i<ncpus; i++) {
+		kfree(rb->rb_cpus[i]->rc_records);
+		kfree(rb->rb_cpus[i]);
+	}
+	kfree(rb->rb_cpus);
+	rb->rb_cpus = NULL;
+}
+
+/*
+ * Empty the buffers (allocating them the first time) and start
+ * recording.
+ */
+int
+recbuf_start(struct recbuf *rb)
+{
+	struct recbuf_cpu *rc;
+	unsigned i;
+
+	recbuf_stop(rb);
+
+	if (rb->rb_cpus == NULL) {
+		rb->rb_cpus = kmalloc(num_cpus * sizeof(rb->rb_cpus[0]));
+		if (rb->rb_cpus == NULL) {
+			return ENOMEM;
+		}
+		for (i=0; i<num_cpus; i++) {
+			rc = kmalloc(sizeof(*rc));
+			if (rc == NULL) {
+				recbuf_free(rb, i);
+				return ENOMEM;
+			}
+			rc->rc_busy = false;
+			rc->rc_records = kmalloc(rb->rb_nrecs * rb->rb_recsize);
+			if (rc->rc_records == NULL) {
+				kfree(rc);
+				recbuf_free(rb, i);
+				return ENOMEM;
+			}
+			rb->rb_cpus[i] = rc;
+		}
+		rb->rb_ncpus = num_cpus;
+	}
+
+	for (i=0; i<rb->rb_ncpus; i++) {
+		rb->rb_cpus[i]->rc_count = 0;
+	}
+	membar_store_store();
+	rb->rb_enabled = true;
+	return 0;
+}
+
+/*
+ * Stop recording, and wait until no cpu is still writing a record.
+ */
+void
+recbuf_stop(struct recbuf *rb)
+{
+	unsigned i;
+
+	rb->rb_enabled = false;
+	membar_any_any();
+	for (i=0; i<rb->rb_ncpus; i++) {
+		while (rb->rb_cpus[i]->rc_busy) {
+			/* spin; it's a few dozen instructions at most */
+		}
+	}
+	membar_load_load();
+}
+
+/*
+ * Get a slot for a record on the current cpu, or NULL if not
+ * recording (or the buffer is full and doesn't wrap). On success
+ * interrupts are off until recbuf_end.
+ */
+void *
+recbuf_begin(struct recbuf *rb, unsigned *cpunum, int *spl)
+{
+	struct recbuf_cpu *rc;
+	unsigned slot;
+
+	*spl = splhigh();
+	*cpunum = curcpu->c_number;
+	if (*cpunum >= rb->rb_ncpus) {
+		splx(*spl);
+		return NULL;
+	}
+	rc = rb->rb_cpus[*cpunum];
+
+	/* Pairs with the barrier in recbuf_stop. */
+	rc->rc_busy = true;
+	membar_any_any();
+	if (!rb->rb_enabled ||
+	    (!rb->rb_wrap && rc->rc_count >= rb->rb_nrecs)) {
+		if (rb->rb_enabled) {
+			rc->rc_count++;
+		}
+		rc->rc_busy = false;
+		splx(*spl);
+		return NULL;
+	}
+
+	slot = rc->rc_count++ % rb->rb_nrecs;
+	return rc->rc_records + slot * rb->rb_recsize;
+}
+
+/*
+ * Finish the record recbuf_begin handed out.
+ */
+void
+recbuf_end(struct recbuf *rb, unsigned cpunum, int spl)
+{
+	membar_store_store();
+	rb->rb_cpus[cpunum]->rc_busy = false;
+	splx(spl);
+}
+
+/*
+ * Count the records kept and dropped (or overwritten) on all cpus.
+ * Recording should be stopped.
+ */
+void
+recbuf_counts(struct recbuf *rb, unsigned *kept, unsigned *dropped)
+{
+	unsigned i, first, n;
+
+	*kept = *dropped = 0;
+	for (i=0; i<rb->rb_ncpus; i++) {
+		recbuf_kept(rb, rb->rb_cpus[i], &first, &n);
+		*kept += n;
+		*dropped += rb->rb_cpus[i]->rc_count - n;
+	}
+}
+
+/*
+ * Write LEN bytes at *POS.
+ */
+static
+int
+recbuf_write(struct vnode *vn, void *buf, size_t len, off_t *pos)
+{
+	struct iovec iov;
+	struct uio ku;
+	int result;
+
+	uio_kinit(&iov, &ku, buf, len, *pos, UIO_WRITE);
+	result = VOP_WRITE(vn, &ku);
+	if (result) {
+		return result;
+	}
+	if (ku.uio_resid > 0) {
+		return ENOSPC;
+	}
+	*pos = ku.uio_offset;
+	return 0;
+}
+
+/*
+ * Write HEADER and then every cpu's records to PATH (which, as with
+ * vfs_open, gets clobbered). Recording should be stopped.
+ */
+int
+recbuf_dump(struct recbuf *rb, char *path,
+	    const void *header, size_t headerlen)
+{
+	struct recbuf_cpu *rc;
+	struct vnode *vn;
+	unsigned i, first, n, chunk;
+	off_t pos = 0;
+	int result;
+
+	result = vfs_open(path, O_WRONLY|O_CREAT|O_TRUNC, 0664, &vn);
+	if (result) {
+		return result;
+	}
+
+	result = recbuf_write(vn, (void *)header, headerlen, &pos);
+	for (i=0; i<rb->rb_ncpus && result == 0; i++) {
+		rc = rb->rb_cpus[i];
+		recbuf_kept(rb, rc, &first, &n);
+
+		/* oldest first: from FIRST to the end, then from the start */
+		chunk = rb->rb_nrecs - first;
+		if (chunk > n) {
+			chunk = n;
+		}
+		result = recbuf_write(vn,
+				      rc->rc_records + first * rb->rb_recsize,
+				      chunk * rb->rb_recsize, &pos);
+		if (result == 0 && n > chunk) {
+			result = recbuf_write(vn, rc->rc_records,
+					      (n - chunk) * rb->rb_recsize,
+					      &pos);
+		}
+	}
+
+	vfs_close(vn);
+	return result;
+}
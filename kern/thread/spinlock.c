@@ -50,7 +50,12 @@
 void
 spinlock_init(struct spinlock *splk)
 {
+#if OPT_TICKETLOCK
+	spinlock_data_set(&splk->splk_next, 0);
+	spinlock_data_set(&splk->splk_serving, 0);
+#else
 	spinlock_data_set(&splk->splk_lock, 0);
+#endif
 	splk->splk_holder = NULL;
 	HANGMAN_LOCKABLEINIT(&splk->splk_hangman, "spinlock");
 }
@@ -62,7 +67,12 @@ void
 spinlock_cleanup(struct spinlock *splk)
 {
 	KASSERT(splk->splk_holder == NULL);
+#if OPT_TICKETLOCK
+	KASSERT(spinlock_data_get(&splk->splk_next) ==
+		spinlock_data_get(&splk->splk_serving));
+#else
 	KASSERT(spinlock_data_get(&splk->splk_lock) == 0);
+#endif
 }
 
 /*
@@ -76,6 +86,9 @@ void
 spinlock_acquire(struct spinlock *splk)
 {
 	struct cpu *mycpu;
+#if OPT_TICKETLOCK
+	spinlock_data_t ticket;
+#endif
 
 	splraise(IPL_NONE, IPL_HIGH);
 
@@ -93,6 +106,17 @@ spinlock_acquire(struct spinlock *splk)
 		mycpu = NULL;
 	}
 
+#if OPT_TICKETLOCK
+	/*
+	 * Take a ticket and wait for our turn. Nobody writes
+	 * splk_serving except the holder on release, so the waiters'
+	 * copies of it stay shared until then.
+	 */
+	ticket = spinlock_data_fetchinc(&splk->splk_next);
+	while (spinlock_data_get(&splk->splk_serving) != ticket) {
+		/* spin */
+	}
+#else
 	while (1) {
 		/*
 		 * Do test-test-and-set, that is, read first before
@@ -112,6 +136,7 @@ spinlock_acquire(struct spinlock *splk)
 		}
 		break;
 	}
+#endif
 
 	membar_store_any();
 	splk->splk_holder = mycpu;
@@ -137,7 +162,13 @@ spinlock_release(struct spinlock *splk)
 
 	splk->splk_holder = NULL;
 	membar_any_store();
+#if OPT_TICKETLOCK
+	/* Only the holder writes this, so no atomic op is needed. */
+	spinlock_data_set(&splk->splk_serving,
+			  spinlock_data_get(&splk->splk_serving) + 1);
+#else
 	spinlock_data_set(&splk->splk_lock, 0);
+#endif
 	spllower(IPL_HIGH, IPL_NONE);
 }
 
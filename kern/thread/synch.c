@@ -33,12 +33,14 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <spinlock.h>
 #include <wchan.h>
 #include <thread.h>
 #include <current.h>
 #include <synch.h>
+#include <timeout.h>
 
 ////////////////////////////////////////////////////////////
 //
@@ -348,16 +350,87 @@ cv_broadcast(struct cv *cv, struct lock *lock)
 	spinlock_release(&cv->cv_lock);
 }
 
+/*
+ * State for a cv_timedwait, on the waiting thread's stack.
+ */
+struct cv_timedwaiter {
+	struct cv *cw_cv;
+	struct thread *cw_thread;
+	bool cw_timedout;
+};
+
+/*
+ * Timeout function for cv_timedwait. If the thread is still waiting,
+ * wake it; if it isn't, a signal beat us to it.
+ */
+static
+void
+cv_timedwait_expire(void *data)
+{
+	struct cv_timedwaiter *cw = data;
+	struct cv *cv = cw->cw_cv;
+
+	spinlock_acquire(&cv->cv_lock);
+	if (wchan_wakethread(cv->cv_wchan, &cv->cv_lock, cw->cw_thread)) {
+		cw->cw_timedout = true;
+	}
+	spinlock_release(&cv->cv_lock);
+}
+
+int
+cv_timedwait(struct cv *cv, struct lock *lock, const struct timespec *reltime)
+{
+	struct cv_timedwaiter cw;
+	struct timeout t;
+
+	KASSERT(cv != NULL);
+	KASSERT(lock != NULL);
+	KASSERT(curthread != NULL);
+	KASSERT(!curthread->t_in_interrupt);
+
+	cw.cw_cv = cv;
+	cw.cw_thread = curthread;
+	cw.cw_timedout = false;
+	timeout_init(&t, cv_timedwait_expire, &cw);
+
+	spinlock_acquire(&cv->cv_lock);
+
+	KASSERT(lock_do_i_hold(lock));
+	lock_release(lock);
+
+	/* The timeout can't wake us until we're asleep; it needs cv_lock */
+	timeout_add(&t, reltime);
+	wchan_sleep(cv->cv_wchan, &cv->cv_lock);
+
+	spinlock_release(&cv->cv_lock);
+
+	/* Not while holding cv_lock: this may wait for the function. */
+	timeout_cancel(&t);
+
+	lock_acquire(lock);
+
+	return cw.cw_timedout ? ETIMEDOUT : 0;
+}
+
 ////////////////////////////////////////////////////////////
 //
 // RW Lock
 
-struct rwlock * 
-rwlock_create(const char *name) 
+struct rwlock *
+rwlock_create(const char *name)
+{
+	return rwlock_create_policy(name, RWLOCK_PHASE_FAIR);
+}
+
+struct rwlock *
+rwlock_create_policy(const char *name, enum rwlock_policy policy)
 {
 	struct rwlock *rwl;
 
 	KASSERT(name != NULL);
+	KASSERT(policy == RWLOCK_PHASE_FAIR ||
+		policy == RWLOCK_READER_PREF ||
+		policy == RWLOCK_WRITER_PREF);
 
 	rwl = kmalloc(sizeof(*rwl));
 	if (rwl == NULL) {
@@ -387,10 +460,14 @@ rwlock_create(const char *name)
 
 	spinlock_init(&rwl->rwl_lock);
 
+	rwl->rwl_policy = policy;
 	rwl->writers_active = 0;
 	rwl->readers_active = 0;
 	rwl->writers_waiting = 0;
 	rwl->readers_waiting = 0;
+	rwl->rwl_readgen = 0;
+	rwl->rwl_wticket = 0;
+	rwl->rwl_wserved = 0;
 	
 	return rwl;
 }
@@ -412,36 +489,70 @@ rwlock_destroy(struct rwlock *rwl)
 }
 
 /*
- * Operations:
- *    rwlock_acquire_read  - Get the lock for reading. Multiple threads can
- *                          hold the lock for reading at the same time.
- *    rwlock_release_read  - Free the lock. 
- *    rwlock_acquire_write - Get the lock for writing. Only one thread can
- *                           hold the write lock at one time.
- *    rwlock_release_write - Free the write lock.
- *
- * These operations must be atomic. You get to write them.
+ * Hand the lock to every waiting reader at once. They are counted as
+ * active before they even wake up, so nobody can get in ahead of them.
+ * Call with rwl_lock held.
  */
+static
+void
+rwlock_grant_readers(struct rwlock *rwl)
+{
+	KASSERT(rwl->writers_active == 0);
+
+	rwl->readers_active += rwl->readers_waiting;
+	rwl->readers_waiting = 0;
+	rwl->rwl_readgen++;
+	wchan_wakeall(rwl->reader_wchan, &rwl->rwl_lock);
+}
+
+/*
+ * Hand the lock to the writer that has waited longest. Waiting writers
+ * take tickets in the order they go to sleep, and the wchan wakes them
+ * in that order, so the one woken here is the one whose ticket is now
+ * served; a writer that arrives before it runs can't take its place.
+ * Call with rwl_lock held.
+ */
+static
+void
+rwlock_grant_writer(struct rwlock *rwl)
+{
+	KASSERT(rwl->writers_waiting > 0);
+	KASSERT(rwl->writers_active == 0);
+	KASSERT(rwl->readers_active == 0);
 
+	rwl->writers_waiting--;
+	rwl->writers_active = 1;
+	rwl->rwl_wserved++;
+	wchan_wakeone(rwl->writer_wchan, &rwl->rwl_lock);
+}
 
 void 
 rwlock_acquire_read(struct rwlock *rwl) 
 {
+	unsigned gen;
+
 	KASSERT(rwl != NULL);
 	KASSERT(curthread != NULL);
 	KASSERT(!curthread->t_in_interrupt);
 
 	spinlock_acquire(&rwl->rwl_lock);
 
-	if (rwl->writers_waiting + rwl->writers_active > 0) {
+	if (rwl->writers_active == 0 &&
+	    (rwl->writers_waiting == 0 ||
+	     rwl->rwl_policy == RWLOCK_READER_PREF)) {
+		++rwl->readers_active;
+	}
+	else {
+		/* Wait to be let in with the next batch. */
 		++rwl->readers_waiting;
-		wchan_sleep(rwl->reader_wchan, &rwl->rwl_lock);
-		--rwl->readers_waiting;
+		gen = rwl->rwl_readgen;
+		while (rwl->rwl_readgen == gen) {
+			wchan_sleep(rwl->reader_wchan, &rwl->rwl_lock);
+		}
 	}
 
 	KASSERT(rwl->writers_active == 0);
-
-	++rwl->readers_active;
+	KASSERT(rwl->readers_active > 0);
 
 	spinlock_release(&rwl->rwl_lock);
 }
@@ -454,13 +565,11 @@ rwlock_release_read(struct rwlock *rwl)
 
 	spinlock_acquire(&rwl->rwl_lock);
 
+	KASSERT(rwl->readers_active > 0);
 	--rwl->readers_active;
 
-	if (rwl->writers_waiting > 0 && rwl->readers_active == 0) {
-		wchan_wakeone(rwl->writer_wchan, &rwl->rwl_lock);
-	}
-	else if (rwl->writers_waiting == 0) {
-		wchan_wakeall(rwl->reader_wchan, &rwl->rwl_lock); // TODO WAKEALL OR WAKEONE, WHICH WOULD CAUSE LESS STARVATION OF WRITERS?
+	if (rwl->readers_active == 0 && rwl->writers_waiting > 0) {
+		rwlock_grant_writer(rwl);
 	}
 
 	spinlock_release(&rwl->rwl_lock);
@@ -469,22 +578,28 @@ rwlock_release_read(struct rwlock *rwl)
 void 
 rwlock_acquire_write(struct rwlock *rwl)
 {
+	unsigned ticket;
+
 	KASSERT(rwl != NULL);
 	KASSERT(curthread != NULL);
 	KASSERT(!curthread->t_in_interrupt);
 
 	spinlock_acquire(&rwl->rwl_lock);
 
-	if (rwl->writers_waiting + rwl->writers_active > 0 || rwl->readers_waiting + rwl->readers_active > 0) {
+	if (rwl->writers_active == 0 && rwl->readers_active == 0 &&
+	    rwl->writers_waiting == 0 && rwl->readers_waiting == 0) {
+		rwl->writers_active = 1;
+	}
+	else {
 		++rwl->writers_waiting;
-		wchan_sleep(rwl->writer_wchan, &rwl->rwl_lock);
-		--rwl->writers_waiting;
+		ticket = rwl->rwl_wticket++;
+		while (rwl->rwl_wserved != ticket + 1) {
+			wchan_sleep(rwl->writer_wchan, &rwl->rwl_lock);
+		}
 	}
 
 	KASSERT(rwl->readers_active == 0);
-	KASSERT(rwl->writers_active == 0);
-
-	rwl->writers_active = 1;
+	KASSERT(rwl->writers_active == 1);
 
 	spinlock_release(&rwl->rwl_lock);
 }
@@ -497,14 +612,17 @@ rwlock_release_write(struct rwlock *rwl)
 
 	spinlock_acquire(&rwl->rwl_lock);
 
+	KASSERT(rwl->writers_active == 1);
 	rwl->writers_active = 0;
 
-	if (rwl->readers_waiting > 0) {
-		wchan_wakeone(rwl->reader_wchan, &rwl->rwl_lock);
+	if (rwl->rwl_policy == RWLOCK_WRITER_PREF && rwl->writers_waiting > 0) {
+		rwlock_grant_writer(rwl);
 	}
-
-	else {
-		wchan_wakeone(rwl->writer_wchan, &rwl->rwl_lock);
+	else if (rwl->readers_waiting > 0) {
+		rwlock_grant_readers(rwl);
+	}
+	else if (rwl->writers_waiting > 0) {
+		rwlock_grant_writer(rwl);
 	}
 
 	spinlock_release(&rwl->rwl_lock);
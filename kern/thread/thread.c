@@ -50,6 +50,7 @@
 #include <addrspace.h>
 #include <mainbus.h>
 #include <vnode.h>
+#include <trace.h>
 
 
 /* Magic number used as a guard value on kernel thread stacks. */
@@ -151,6 +152,9 @@ thread_create(const char *name)
 	thread->t_in_interrupt = false;
 	thread->t_curspl = IPL_HIGH;
 	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
+	thread->t_intr_user = false;
+
+	bzero(&thread->t_usage, sizeof(thread->t_usage));
 
 	/* If you add to struct thread, be sure to initialize here */
 
@@ -580,6 +584,7 @@ void
 thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 {
 	struct thread *cur, *next;
+	bool stopped;
 	int spl;
 
 	DEBUGASSERT(curcpu->c_curthread == curthread);
@@ -618,8 +623,10 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		panic("Illegal S_RUN in thread_switch\n");
 	    case S_READY:
 		thread_make_runnable(cur, true /*have lock*/);
+		cur->t_usage.tu_nivcsw++;
 		break;
 	    case S_SLEEP:
+		cur->t_usage.tu_nvcsw++;
 		cur->t_wchan_name = wc->wc_name;
 		/*
 		 * Add the thread to the list in the wait channel, and
@@ -654,19 +661,31 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	 * Note that c_isidle becomes true briefly even if we don't go
 	 * idle. However, because one is supposed to hold the runqueue
 	 * lock to look at it, this should not be visible or matter.
+	 *
+	 * While idle the cpu's hardclock is stopped: with nothing to
+	 * run there is nothing for it to do. Timeouts don't need it,
+	 * and whoever gives us work sends IPI_UNIDLE.
 	 */
 
 	/* The current cpu is now idle. */
 	curcpu->c_isidle = true;
+	stopped = false;
 	do {
 		next = threadlist_remhead(&curcpu->c_runqueue);
 		if (next == NULL) {
 			spinlock_release(&curcpu->c_runqueue_lock);
+			if (!stopped) {
+				mainbus_hardclock_stop();
+				stopped = true;
+			}
 			cpu_idle();
 			spinlock_acquire(&curcpu->c_runqueue_lock);
 		}
 	} while (next == NULL);
 	curcpu->c_isidle = false;
+	if (stopped) {
+		mainbus_hardclock_start();
+	}
 
 	/*
 	 * Note that curcpu->c_curthread may be the same variable as
@@ -675,6 +694,8 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	 * assume the compiler will optimize one away if they're the
 	 * same.
 	 */
+	TRACE(TRACE_SWITCH, newstate, next);
+
 	curcpu->c_curthread = next;
 	curthread = next;
 
@@ -1041,6 +1062,7 @@ wchan_sleep(struct wchan *wc, struct spinlock *lk)
 	/* must not hold other spinlocks */
 	KASSERT(curcpu->c_spinlocks == 1);
 
+	TRACE(TRACE_SLEEP, wc, 0);
 	thread_switch(S_SLEEP, wc, lk);
 	spinlock_acquire(lk);
 }
@@ -1062,6 +1084,7 @@ wchan_wakeone(struct wchan *wc, struct spinlock *lk)
 		/* Nobody was sleeping. */
 		return;
 	}
+	TRACE(TRACE_WAKE, wc, target);
 
 	/*
 	 * Note that thread_make_runnable acquires a runqueue lock
@@ -1101,12 +1124,34 @@ wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 	 * make each thread runnable.
 	 */
 	while ((target = threadlist_remhead(&list)) != NULL) {
+		TRACE(TRACE_WAKE, wc, target);
 		thread_make_runnable(target, false);
 	}
 
 	threadlist_cleanup(&list);
 }
 
+/*
+ * Wake up one particular thread, if it's sleeping on a wait channel.
+ */
+bool
+wchan_wakethread(struct wchan *wc, struct spinlock *lk, struct thread *t)
+{
+	struct thread *target;
+
+	KASSERT(spinlock_do_i_hold(lk));
+
+	THREADLIST_FORALL(target, wc->wc_threads) {
+		if (target == t) {
+			threadlist_remove(&wc->wc_threads, target);
+			TRACE(TRACE_WAKE, wc, target);
+			thread_make_runnable(target, false);
+			return true;
+		}
+	}
+	return false;
+}
+
 /*
  * Return nonzero if there are no threads sleeping on the channel.
  * This is meant to be used only for diagnostic purposes.
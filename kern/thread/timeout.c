@@ -0,0 +1,413 @@
+/*
+ * Timeouts.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <synch.h>
+#include <timeout.h>
+
+/*
+ * The wheel has WHEEL_LEVELS levels of WHEEL_SLOTS slots. A slot at
+ * level L covers 64^L ticks, so level 0 holds what is due in the next
+ * 64 ticks one tick per slot, level 1 the next 4096 ticks 64 per slot,
+ * and so on. When the wheel reaches the start of a higher-level slot
+ * its timeouts are cascaded down to where they now belong. Timeouts
+ * further off than the wheel reaches (2^24 ticks, about 28 minutes)
+ * wait in the last slot of the top level and get looked at again when
+ * it comes around.
+ *
+ * wheel_now is the last tick the wheel has processed; it catches up
+ * with the clock in timeout_clock. It skips straight over stretches
+ * of empty slots, so a long quiet time costs no more than a short one.
+ */
+#define WHEEL_BITS	6
+#define WHEEL_SLOTS	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS	4
+#define WHEEL_RANGE	((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+#define TIMEOUT_NEVER	((uint64_t)-1)
+
+/* to_state */
+#define TO_IDLE		0
+#define TO_PENDING	1	/* in the wheel */
+#define TO_FIRING	2	/* expired; function not finished yet */
+
+static struct spinlock timeout_lock = SPINLOCK_INITIALIZER;
+static struct timeout *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint64_t wheel_now;
+static uint64_t timeout_programmed = TIMEOUT_NEVER;
+
+/* The hardware timer; see timeout_setclock. */
+static void *clock_data;
+static void (*clock_gettime)(void *data, struct timespec *ts);
+static void (*clock_program)(void *data, uint32_t usecs);
+static uint64_t clock_base;
+
+////////////////////////////////////////////////////////////
+// the wheel
+
+static
+uint64_t
+clock_usecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(clock_data, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * The current tick. Until there's a clock, time stands still at 0.
+ */
+static
+uint64_t
+timeout_ticknow(void)
+{
+	uint64_t now;
+
+	KASSERT(spinlock_do_i_hold(&timeout_lock));
+	if (clock_gettime == NULL) {
+		return wheel_now;
+	}
+	now = (clock_usecs() - clock_base) / TIMEOUT_TICKUSEC;
+	return now > wheel_now ? now : wheel_now;
+}
+
+static
+void
+wheel_insert(struct timeout *t)
+{
+	struct timeout **slotp;
+	uint64_t when, delta;
+	unsigned level;
+
+	KASSERT(t->to_expires > wheel_now);
+	when = t->to_expires;
+	delta = when - wheel_now;
+	if (delta >= WHEEL_RANGE) {
+		delta = WHEEL_RANGE - 1;
+		when = wheel_now + delta;
+	}
+	for (level=0; level < WHEEL_LEVELS-1; level++) {
+		if (delta < (uint64_t)1 << (WHEEL_BITS * (level+1))) {
+			break;
+		}
+	}
+	slotp = &wheel[level][(when >> (WHEEL_BITS * level)) & WHEEL_MASK];
+
+	t->to_next = *slotp;
+	if (t->to_next != NULL) {
+		t->to_next->to_prevp = &t->to_next;
+	}
+	t->to_prevp = slotp;
+	*slotp = t;
+}
+
+static
+void
+wheel_remove(struct timeout *t)
+{
+	*t->to_prevp = t->to_next;
+	if (t->to_next != NULL) {
+		t->to_next->to_prevp = t->to_prevp;
+	}
+	t->to_next = NULL;
+	t->to_prevp = NULL;
+}
+
+/*
+ * Find the next tick after wheel_now that the wheel has to stop at:
+ * either a level-0 slot with something due, or the start of a non-empty
+ * higher-level slot that needs cascading. Returns TIMEOUT_NEVER if the
+ * wheel is empty.
+ */
+static
+uint64_t
+wheel_next(void)
+{
+	uint64_t best = TIMEOUT_NEVER, base, tick;
+	unsigned level, shift, j;
+
+	/* Level 0 slots hold exactly the next 63 ticks. */
+	for (j=1; j<WHEEL_SLOTS; j++) {
+		if (wheel[0][(wheel_now + j) & WHEEL_MASK] != NULL) {
+			best = wheel_now + j;
+			break;
+		}
+	}
+
+	/*
+	 * Higher levels: the current slot's time has passed, so its
+	 * contents (if any) are for the next time around.
+	 */
+	for (level=1; level<WHEEL_LEVELS; level++) {
+		shift = WHEEL_BITS * level;
+		base = wheel_now >> shift;
+		for (j=1; j<=WHEEL_SLOTS; j++) {
+			if (wheel[level][(base + j) & WHEEL_MASK] != NULL) {
+				tick = (base + j) << shift;
+				if (tick < best) {
+					best = tick;
+				}
+				break;
+			}
+		}
+	}
+	return best;
+}
+
+/*
+ * Move the contents of a slot to the expired list or back into the
+ * wheel, as appropriate for wheel_now.
+ */
+static
+void
+wheel_empty(struct timeout **slotp, struct timeout **expired)
+{
+	struct timeout *t;
+
+	while ((t = *slotp) != NULL) {
+		wheel_remove(t);
+		if (t->to_expires <= wheel_now) {
+			t->to_state = TO_FIRING;
+			t->to_next = *expired;
+			*expired = t;
+		}
+		else {
+			wheel_insert(t);
+		}
+	}
+}
+
+/*
+ * Bring the wheel up to tick TARGET, collecting what expires.
+ */
+static
+void
+wheel_advance(uint64_t target, struct timeout **expired)
+{
+	uint64_t next;
+	unsigned level, shift;
+
+	while (1) {
+		next = wheel_next();
+		if (next > target) {
+			break;
+		}
+		wheel_now = next;
+		for (level=1; level<WHEEL_LEVELS; level++) {
+			shift = WHEEL_BITS * level;
+			if (next & (((uint64_t)1 << shift) - 1)) {
+				break;
+			}
+			wheel_empty(&wheel[level][(next >> shift) & WHEEL_MASK],
+				    expired);
+		}
+		wheel_empty(&wheel[0][next & WHEEL_MASK], expired);
+	}
+	if (target > wheel_now) {
+		wheel_now = target;
+	}
+}
+
+/*
+ * Set the hardware for tick NEXT.
+ */
+static
+void
+timeout_program(uint64_t next)
+{
+	uint64_t now, usecs;
+
+	timeout_programmed = next;
+	if (next == TIMEOUT_NEVER || clock_program == NULL) {
+		return;
+	}
+	now = timeout_ticknow();
+	usecs = next > now ? (next - now) * TIMEOUT_TICKUSEC : 1;
+	if (usecs > 0xffffffff) {
+		usecs = 0xffffffff;
+	}
+	clock_program(clock_data, usecs);
+}
+
+////////////////////////////////////////////////////////////
+// interface
+
+void
+timeout_setclock(void *data,
+		 void (*gettime)(void *data, struct timespec *ts),
+		 void (*program)(void *data, uint32_t usecs))
+{
+	spinlock_acquire(&timeout_lock);
+	KASSERT(clock_gettime == NULL);
+	clock_data = data;
+	clock_gettime = gettime;
+	clock_program = program;
+	/* Make the current tick wheel_now (which is still 0). */
+	clock_base = clock_usecs() - wheel_now * TIMEOUT_TICKUSEC;
+	timeout_program(wheel_next());
+	spinlock_release(&timeout_lock);
+}
+
+/*
+ * Called from the hardware timer's interrupt handler.
+ */
+void
+timeout_clock(void)
+{
+	struct timeout *expired = NULL, *t;
+
+	spinlock_acquire(&timeout_lock);
+	wheel_advance(timeout_ticknow(), &expired);
+
+	while ((t = expired) != NULL) {
+		expired = t->to_next;
+		t->to_next = NULL;
+
+		spinlock_release(&timeout_lock);
+		t->to_func(t->to_data);
+		spinlock_acquire(&timeout_lock);
+
+		/* unless it re-added itself, it's done; don't touch it again */
+		if (t->to_state == TO_FIRING) {
+			t->to_state = TO_IDLE;
+		}
+	}
+
+	timeout_program(wheel_next());
+	spinlock_release(&timeout_lock);
+}
+
+void
+timeout_init(struct timeout *t, void (*func)(void *), void *data)
+{
+	t->to_next = NULL;
+	t->to_prevp = NULL;
+	t->to_expires = 0;
+	t->to_state = TO_IDLE;
+	t->to_func = func;
+	t->to_data = data;
+}
+
+/*
+ * Convert RELTIME to ticks, rounding up.
+ */
+static
+uint64_t
+timeout_ticks(const struct timespec *reltime)
+{
+	uint64_t usecs;
+
+	KASSERT(reltime->tv_sec >= 0);
+	KASSERT(reltime->tv_nsec >= 0 && reltime->tv_nsec < 1000000000);
+
+	usecs = (uint64_t)reltime->tv_sec * 1000000 +
+		(reltime->tv_nsec + 999) / 1000;
+	return (usecs + TIMEOUT_TICKUSEC - 1) / TIMEOUT_TICKUSEC;
+}
+
+void
+timeout_add(struct timeout *t, const struct timespec *reltime)
+{
+	uint64_t ticks;
+
+	/* plus one, since part of the current tick is already gone */
+	ticks = timeout_ticks(reltime) + 1;
+
+	spinlock_acquire(&timeout_lock);
+	KASSERT(t->to_state != TO_PENDING);
+	t->to_expires = timeout_ticknow() + ticks;
+	wheel_insert(t);
+	t->to_state = TO_PENDING;
+	if (t->to_expires < timeout_programmed) {
+		timeout_program(t->to_expires);
+	}
+	spinlock_release(&timeout_lock);
+}
+
+/*
+ * From T's own function: add it again, INTERVAL after it was due
+ * rather than after now, so a periodic timeout keeps to its schedule
+ * however late each firing runs. If it has fallen a whole interval
+ * behind, it fires on the next tick.
+ */
+void
+timeout_readd(struct timeout *t, const struct timespec *interval)
+{
+	uint64_t ticks;
+
+	ticks = timeout_ticks(interval);
+
+	spinlock_acquire(&timeout_lock);
+	KASSERT(t->to_state == TO_FIRING);
+	t->to_expires += ticks;
+	if (t->to_expires <= wheel_now) {
+		t->to_expires = wheel_now + 1;
+	}
+	wheel_insert(t);
+	t->to_state = TO_PENDING;
+	if (t->to_expires < timeout_programmed) {
+		timeout_program(t->to_expires);
+	}
+	spinlock_release(&timeout_lock);
+}
+
+bool
+timeout_cancel(struct timeout *t)
+{
+	spinlock_acquire(&timeout_lock);
+	if (t->to_state == TO_PENDING) {
+		wheel_remove(t);
+		t->to_state = TO_IDLE;
+		spinlock_release(&timeout_lock);
+		return true;
+	}
+	while (t->to_state == TO_FIRING) {
+		/* its function is running on another cpu */
+		spinlock_release(&timeout_lock);
+		spinlock_acquire(&timeout_lock);
+	}
+	spinlock_release(&timeout_lock);
+	return false;
+}
+
+////////////////////////////////////////////////////////////
+// sleeping
+
+/*
+ * Each sleeper waits on its own semaphore, so waking it up doesn't
+ * mean looking for it among everyone else who's asleep.
+ */
+static
+void
+timeout_sleep_expire(void *data)
+{
+	struct semaphore *sem = data;
+
+	V(sem);
+}
+
+int
+timeout_sleep(const struct timespec *reltime)
+{
+	struct semaphore *sem;
+	struct timeout t;
+
+	sem = sem_create("timeout_sleep", 0);
+	if (sem == NULL) {
+		return ENOMEM;
+	}
+	timeout_init(&t, timeout_sleep_expire, sem);
+	timeout_add(&t, reltime);
+	P(sem);
+
+	/* Wait for timeout_clock to be done with T and SEM. */
+	timeout_cancel(&t);
+	sem_destroy(sem);
+	return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Kernel event tracing.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <current.h>
+#include <trace.h>
+
+/* Records per CPU; the ring wraps, keeping the newest. */
+#define TRACE_NRECORDS	2048
+
+struct recbuf trace_buf =
+	RECBUF_INITIALIZER(sizeof(struct trace_record), TRACE_NRECORDS, true);
+
+void
+trace_record(unsigned type, uint32_t arg0, uint32_t arg1)
+{
+	struct trace_record *r;
+	struct timespec ts;
+	unsigned cpunum;
+	int spl;
+
+	r = recbuf_begin(&trace_buf, &cpunum, &spl);
+	if (r == NULL) {
+		return;
+	}
+
+	gettime(&ts);
+	r->tr_sec = ts.tv_sec;
+	r->tr_nsec = ts.tv_nsec;
+	r->tr_cpu = cpunum;
+	r->tr_type = type;
+	r->tr_thread = (uint32_t)(uintptr_t)curthread;
+	r->tr_arg0 = arg0;
+	r->tr_arg1 = arg1;
+
+	recbuf_end(&trace_buf, cpunum, spl);
+}
+
+/*
+ * Empty the rings (allocating them the first time) and start
+ * recording.
+ */
+int
+trace_start(void)
+{
+	return recbuf_start(&trace_buf);
+}
+
+/*
+ * Stop recording, and wait until nobody is still writing a record.
+ */
+void
+trace_stop(void)
+{
+	recbuf_stop(&trace_buf);
+}
+
+/*
+ * Stop tracing and write everything recorded to PATH (which, as
+ * with vfs_open, gets clobbered).
+ */
+int
+trace_dump(char *path)
+{
+	struct trace_header th;
+	unsigned kept, overwritten;
+	int result;
+
+	trace_stop();
+
+	th.th_magic = TRACE_MAGIC;
+	th.th_version = TRACE_VERSION;
+	th.th_ncpus = trace_buf.rb_ncpus;
+	recbuf_counts(&trace_buf, &kept, &overwritten);
+	th.th_nrecords = kept;
+
+	result = recbuf_dump(&trace_buf, path, &th, sizeof(th));
+	if (result == 0) {
+		kprintf("trace: wrote %u records from %u cpus\n",
+			th.th_nrecords, th.th_ncpus);
+	}
+	return result;
+}
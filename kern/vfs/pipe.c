@@ -0,0 +1,487 @@
+/*
+ * Anonymous pipes.
+ *
+ * A pipe is a PIPE_SIZE ring buffer with a vnode embedded for each
+ * end; both vnodes point at the pipe through vn_data, and the pipe is
+ * freed when the second of them is reclaimed. pp_lock protects
+ * everything. Readers sleep on pp_readcv waiting for data, writers on
+ * pp_writecv waiting for room.
+ *
+ * A reader that goes to sleep on an empty pipe leaves its uio in
+ * pp_reader. The next writer then copies straight from its own user
+ * buffer into the reader's memory (through as_translate) instead of
+ * through the ring, and only puts whatever doesn't fit in the ring.
+ * The ring is always empty when this happens, so ordering is kept.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/iovec.h>
+#include <lib.h>
+#include <limits.h>
+#include <stat.h>
+#include <uio.h>
+#include <synch.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <vnode.h>
+#include <pipe.h>
+
+struct pipe {
+	struct lock *pp_lock;
+	struct cv *pp_readcv;		/* readers wait for data */
+	struct cv *pp_writecv;		/* writers wait for room */
+	char *pp_buf;			/* ring buffer */
+	unsigned pp_head;		/* offset of first byte in ring */
+	unsigned pp_len;		/* bytes in ring */
+	bool pp_reading;		/* read end still open */
+	bool pp_writing;		/* write end still open */
+	struct uio *pp_reader;		/* sleeping reader, or NULL */
+	struct vnode pp_readvn;
+	struct vnode pp_writevn;
+};
+
+/*
+ * Destructor for struct pipe.
+ */
+static
+void
+pipe_destroy(struct pipe *pp)
+{
+	cv_destroy(pp->pp_writecv);
+	cv_destroy(pp->pp_readcv);
+	lock_destroy(pp->pp_lock);
+	kfree(pp->pp_buf);
+	kfree(pp);
+}
+
+////////////////////////////////////////////////////////////
+// data movement
+
+/*
+ * Move as much as fits from the ring into UIO.
+ */
+static
+int
+pipe_ringout(struct pipe *pp, struct uio *uio)
+{
+	size_t n, chunk;
+	int result;
+
+	n = pp->pp_len;
+	if (n > uio->uio_resid) {
+		n = uio->uio_resid;
+	}
+	while (n > 0) {
+		chunk = PIPE_SIZE - pp->pp_head;
+		if (chunk > n) {
+			chunk = n;
+		}
+		result = uiomove(pp->pp_buf + pp->pp_head, chunk, uio);
+		if (result) {
+			return result;
+		}
+		pp->pp_head = (pp->pp_head + chunk) % PIPE_SIZE;
+		pp->pp_len -= chunk;
+		n -= chunk;
+	}
+	return 0;
+}
+
+/*
+ * Move as much as fits from UIO into the ring.
+ */
+static
+int
+pipe_ringin(struct pipe *pp, struct uio *uio)
+{
+	size_t n, tail, chunk;
+	int result;
+
+	n = PIPE_SIZE - pp->pp_len;
+	if (n > uio->uio_resid) {
+		n = uio->uio_resid;
+	}
+	while (n > 0) {
+		tail = (pp->pp_head + pp->pp_len) % PIPE_SIZE;
+		chunk = PIPE_SIZE - tail;
+		if (chunk > n) {
+			chunk = n;
+		}
+		result = uiomove(pp->pp_buf + tail, chunk, uio);
+		if (result) {
+			return result;
+		}
+		pp->pp_len += chunk;
+		n -= chunk;
+	}
+	return 0;
+}
+
+/*
+ * Copy from the writer's uio directly into the sleeping reader's
+ * buffer, one page of the reader's memory at a time. Stops quietly at
+ * the first page as_translate won't give us; the caller puts the rest
+ * in the ring.
+ */
+static
+int
+pipe_direct(struct pipe *pp, struct uio *wuio)
+{
+	struct uio *ruio = pp->pp_reader;
+	struct iovec *iov;
+	vaddr_t va;
+	paddr_t pa;
+	size_t len;
+	int result;
+
+	KASSERT(ruio->uio_segflg == UIO_USERSPACE);
+	KASSERT(ruio->uio_rw == UIO_READ);
+
+	while (ruio->uio_resid > 0 && wuio->uio_resid > 0) {
+		iov = ruio->uio_iov;
+		if (iov->iov_len == 0) {
+			KASSERT(ruio->uio_iovcnt > 1);
+			ruio->uio_iov++;
+			ruio->uio_iovcnt--;
+			continue;
+		}
+
+		va = (vaddr_t)iov->iov_ubase;
+		len = PAGE_SIZE - (va & ~PAGE_FRAME);
+		if (len > iov->iov_len) {
+			len = iov->iov_len;
+		}
+		if (len > wuio->uio_resid) {
+			len = wuio->uio_resid;
+		}
+		if (va >= USERSPACETOP ||
+		    as_translate(ruio->uio_space, va, &pa)) {
+			break;
+		}
+
+		result = uiomove((void *)PADDR_TO_KVADDR(pa), len, wuio);
+		if (result) {
+			return result;
+		}
+		iov->iov_ubase += len;
+		iov->iov_len -= len;
+		ruio->uio_resid -= len;
+		ruio->uio_offset += len;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// vnode ops
+
+static
+int
+pipe_eachopen(struct vnode *vn, int openflags)
+{
+	(void)vn;
+	(void)openflags;
+	return 0;
+}
+
+/*
+ * Reclaim one end. Pipe vnodes can only be reached through file
+ * handles, so nobody can take a new reference while we're here.
+ */
+static
+int
+pipe_reclaim(struct vnode *vn)
+{
+	struct pipe *pp = vn->vn_data;
+	bool gone;
+
+	lock_acquire(pp->pp_lock);
+	if (vn == &pp->pp_readvn) {
+		pp->pp_reading = false;
+		cv_broadcast(pp->pp_writecv, pp->pp_lock);
+	}
+	else {
+		KASSERT(vn == &pp->pp_writevn);
+		pp->pp_writing = false;
+		cv_broadcast(pp->pp_readcv, pp->pp_lock);
+	}
+	/* the vnode is part of the pipe; finish with it before unlocking */
+	vnode_cleanup(vn);
+	gone = !pp->pp_reading && !pp->pp_writing;
+	lock_release(pp->pp_lock);
+
+	if (gone) {
+		pipe_destroy(pp);
+	}
+	return 0;
+}
+
+/*
+ * Read: wait until there's data (or no writer), then take what's there.
+ */
+static
+int
+pipe_read(struct vnode *vn, struct uio *uio)
+{
+	struct pipe *pp = vn->vn_data;
+	size_t start;
+	int result = 0;
+
+	start = uio->uio_resid;
+
+	lock_acquire(pp->pp_lock);
+	while (start > 0 && uio->uio_resid == start &&
+	       pp->pp_len == 0 && pp->pp_writing) {
+		if (pp->pp_reader == NULL && uio->uio_segflg == UIO_USERSPACE) {
+			pp->pp_reader = uio;
+		}
+		cv_wait(pp->pp_readcv, pp->pp_lock);
+	}
+	if (pp->pp_reader == uio) {
+		pp->pp_reader = NULL;
+	}
+	if (pp->pp_len > 0 && uio->uio_resid > 0) {
+		result = pipe_ringout(pp, uio);
+		cv_broadcast(pp->pp_writecv, pp->pp_lock);
+	}
+	lock_release(pp->pp_lock);
+
+	return result;
+}
+
+/*
+ * Write: hand data to a waiting reader if there is one, otherwise fill
+ * the ring, sleeping for room as needed. A write of PIPE_BUF bytes or
+ * less waits until it can go in all at once, so it can't be split up
+ * by other writers.
+ */
+static
+int
+pipe_write(struct vnode *vn, struct uio *uio)
+{
+	struct pipe *pp = vn->vn_data;
+	size_t start, need;
+	int result = 0;
+
+	start = uio->uio_resid;
+
+	lock_acquire(pp->pp_lock);
+	while (uio->uio_resid > 0) {
+		if (!pp->pp_reading) {
+			result = EPIPE;
+			break;
+		}
+		if (pp->pp_len == 0 && pp->pp_reader != NULL) {
+			result = pipe_direct(pp, uio);
+			/* done with this reader whether or not it got data */
+			pp->pp_reader = NULL;
+			cv_broadcast(pp->pp_readcv, pp->pp_lock);
+			if (result) {
+				break;
+			}
+			continue;
+		}
+		need = start <= PIPE_BUF ? uio->uio_resid : 1;
+		if (PIPE_SIZE - pp->pp_len < need) {
+			cv_wait(pp->pp_writecv, pp->pp_lock);
+			continue;
+		}
+		result = pipe_ringin(pp, uio);
+		cv_broadcast(pp->pp_readcv, pp->pp_lock);
+		if (result) {
+			break;
+		}
+	}
+	lock_release(pp->pp_lock);
+
+	if (result == EPIPE && uio->uio_resid < start) {
+		/* report the partial write; the next one gets EPIPE */
+		result = 0;
+	}
+	return result;
+}
+
+static
+int
+pipe_ioctl(struct vnode *vn, int op, userptr_t data)
+{
+	(void)vn;
+	(void)op;
+	(void)data;
+	return EINVAL;
+}
+
+static
+int
+pipe_stat(struct vnode *vn, struct stat *buf)
+{
+	struct pipe *pp = vn->vn_data;
+
+	bzero(buf, sizeof(*buf));
+
+	lock_acquire(pp->pp_lock);
+	buf->st_size = pp->pp_len;
+	lock_release(pp->pp_lock);
+
+	buf->st_mode = S_IFIFO | 0600;
+	buf->st_nlink = 1;
+	buf->st_blksize = PIPE_BUF;
+	return 0;
+}
+
+static
+int
+pipe_gettype(struct vnode *vn, mode_t *ret)
+{
+	(void)vn;
+	*ret = S_IFIFO;
+	return 0;
+}
+
+static
+bool
+pipe_isseekable(struct vnode *vn)
+{
+	(void)vn;
+	return false;
+}
+
+static
+int
+pipe_fsync(struct vnode *vn)
+{
+	(void)vn;
+	return EINVAL;
+}
+
+static
+int
+pipe_truncate(struct vnode *vn, off_t len)
+{
+	(void)vn;
+	(void)len;
+	return EINVAL;
+}
+
+/*
+ * Vnode ops table for the read end.
+ */
+static const struct vnode_ops pipe_readops = {
+	.vop_magic = VOP_MAGIC,
+
+	.vop_eachopen = pipe_eachopen,
+	.vop_reclaim = pipe_reclaim,
+
+	.vop_read = pipe_read,
+	.vop_readlink = vopfail_uio_inval,
+	.vop_getdirentry = vopfail_uio_notdir,
+	.vop_write = vopfail_uio_inval,
+	.vop_ioctl = pipe_ioctl,
+	.vop_stat = pipe_stat,
+	.vop_gettype = pipe_gettype,
+	.vop_isseekable = pipe_isseekable,
+	.vop_fsync = pipe_fsync,
+	.vop_mmap = vopfail_mmap_perm,
+	.vop_truncate = pipe_truncate,
+	.vop_namefile = vopfail_uio_notdir,
+
+	.vop_creat = vopfail_creat_notdir,
+	.vop_symlink = vopfail_symlink_notdir,
+	.vop_mkdir = vopfail_mkdir_notdir,
+	.vop_link = vopfail_link_notdir,
+	.vop_remove = vopfail_string_notdir,
+	.vop_rmdir = vopfail_string_notdir,
+	.vop_rename = vopfail_rename_notdir,
+	.vop_lookup = vopfail_lookup_notdir,
+	.vop_lookparent = vopfail_lookparent_notdir,
+};
+
+/*
+ * Vnode ops table for the write end.
+ */
+static const struct vnode_ops pipe_writeops = {
+	.vop_magic = VOP_MAGIC,
+
+	.vop_eachopen = pipe_eachopen,
+	.vop_reclaim = pipe_reclaim,
+
+	.vop_read = vopfail_uio_inval,
+	.vop_readlink = vopfail_uio_inval,
+	.vop_getdirentry = vopfail_uio_notdir,
+	.vop_write = pipe_write,
+	.vop_ioctl = pipe_ioctl,
+	.vop_stat = pipe_stat,
+	.vop_gettype = pipe_gettype,
+	.vop_isseekable = pipe_isseekable,
+	.vop_fsync = pipe_fsync,
+	.vop_mmap = vopfail_mmap_perm,
+	.vop_truncate = pipe_truncate,
+	.vop_namefile = vopfail_uio_notdir,
+
+	.vop_creat = vopfail_creat_notdir,
+	.vop_symlink = vopfail_symlink_notdir,
+	.vop_mkdir = vopfail_mkdir_notdir,
+	.vop_link = vopfail_link_notdir,
+	.vop_remove = vopfail_string_notdir,
+	.vop_rmdir = vopfail_string_notdir,
+	.vop_rename = vopfail_rename_notdir,
+	.vop_lookup = vopfail_lookup_notdir,
+	.vop_lookparent = vopfail_lookparent_notdir,
+};
+
+/*
+ * Constructor: make a pipe and return its two ends.
+ */
+int
+pipe_create(struct vnode **readvn, struct vnode **writevn)
+{
+	struct pipe *pp;
+	int result;
+
+	pp = kmalloc(sizeof(*pp));
+	if (pp == NULL) {
+		goto fail_return;
+	}
+	pp->pp_buf = kmalloc(PIPE_SIZE);
+	if (pp->pp_buf == NULL) {
+		goto fail_pipe;
+	}
+	pp->pp_lock = lock_create("pipe");
+	if (pp->pp_lock == NULL) {
+		goto fail_buf;
+	}
+	pp->pp_readcv = cv_create("pipe:r");
+	if (pp->pp_readcv == NULL) {
+		goto fail_lock;
+	}
+	pp->pp_writecv = cv_create("pipe:w");
+	if (pp->pp_writecv == NULL) {
+		goto fail_readcv;
+	}
+	pp->pp_head = 0;
+	pp->pp_len = 0;
+	pp->pp_reading = true;
+	pp->pp_writing = true;
+	pp->pp_reader = NULL;
+
+	/* vnode_init doesn't actually fail */
+	result = vnode_init(&pp->pp_readvn, &pipe_readops, NULL, pp);
+	KASSERT(result == 0);
+	result = vnode_init(&pp->pp_writevn, &pipe_writeops, NULL, pp);
+	KASSERT(result == 0);
+
+	*readvn = &pp->pp_readvn;
+	*writevn = &pp->pp_writevn;
+	return 0;
+
+ fail_readcv:
+	cv_destroy(pp->pp_readcv);
+ fail_lock:
+	lock_destroy(pp->pp_lock);
+ fail_buf:
+	kfree(pp->pp_buf);
+ fail_pipe:
+	kfree(pp);
+ fail_return:
+	return ENOMEM;
+}
@@ -180,3 +180,73 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+
+int
+as_map_file(struct addrspace *as, size_t len, int prot, int flags,
+	    struct vnode *vn, off_t offset, vaddr_t *ret)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)len;
+	(void)prot;
+	(void)flags;
+	(void)vn;
+	(void)offset;
+	(void)ret;
+	return ENOSYS;
+}
+
+int
+as_unmap(struct addrspace *as, vaddr_t vaddr, size_t len)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)vaddr;
+	(void)len;
+	return ENOSYS;
+}
+
+int
+as_sync(struct addrspace *as, vaddr_t vaddr, size_t len)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)vaddr;
+	(void)len;
+	return ENOSYS;
+}
+
+int
+as_sbrk(struct addrspace *as, intptr_t amount, vaddr_t *oldbreak)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)amount;
+	(void)oldbreak;
+	return ENOSYS;
+}
+
+int
+as_translate(struct addrspace *as, vaddr_t vaddr, paddr_t *ret)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)vaddr;
+	(void)ret;
+	return EFAULT;
+}
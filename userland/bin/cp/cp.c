@@ -28,6 +28,7 @@
  */
 
 #include <unistd.h>
+#include <errno.h>
 #include <err.h>
 
 /*
@@ -36,28 +37,17 @@
  */
 
 
-/* Copy one file to another. */
+/*
+ * Copy the rest of fromfd to tofd by reading and writing through a
+ * user buffer. Used if the kernel doesn't do copy_file_range.
+ */
 static
 void
-copy(const char *from, const char *to)
+copyloop(int fromfd, int tofd, const char *from, const char *to)
 {
-	int fromfd;
-	int tofd;
 	char buf[1024];
 	int len, wr, wrtot;
 
-	/*
-	 * Open the files, and give up if they won't open
-	 */
-	fromfd = open(from, O_RDONLY);
-	if (fromfd<0) {
-		err(1, "%s", from);
-	}
-	tofd = open(to, O_WRONLY|O_CREAT|O_TRUNC);
-	if (tofd<0) {
-		err(1, "%s", to);
-	}
-
 	/*
 	 * As long as we get more than zero bytes, we haven't hit EOF.
 	 * Zero means EOF. Less than zero means an error occurred.
@@ -84,6 +74,43 @@ copy(const char *from, const char *to)
 	if (len<0) {
 		err(1, "%s", from);
 	}
+}
+
+/* Copy one file to another. */
+static
+void
+copy(const char *from, const char *to)
+{
+	int fromfd;
+	int tofd;
+	ssize_t len;
+
+	/*
+	 * Open the files, and give up if they won't open
+	 */
+	fromfd = open(from, O_RDONLY);
+	if (fromfd<0) {
+		err(1, "%s", from);
+	}
+	tofd = open(to, O_WRONLY|O_CREAT|O_TRUNC);
+	if (tofd<0) {
+		err(1, "%s", to);
+	}
+
+	/*
+	 * Have the kernel move the data file to file. Zero means EOF.
+	 * (We can't tell whether a failure came from the source or the
+	 * destination, so name both.)
+	 */
+	while ((len = copy_file_range(fromfd, tofd, 1024*1024))>0) {
+		/* nothing */
+	}
+	if (len<0) {
+		if (errno != ENOSYS) {
+			err(1, "%s to %s", from, to);
+		}
+		copyloop(fromfd, tofd, from, to);
+	}
 
 	if (close(fromfd) < 0) {
 		err(1, "%s: close", from);
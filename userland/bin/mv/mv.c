@@ -28,6 +28,7 @@
  */
 
 #include <unistd.h>
+#include <errno.h>
 #include <err.h>
 
 /*
@@ -37,18 +38,57 @@
  * Just calls rename() on them. If it fails, we don't attempt to
  * figure out which filename was wrong or what happened.
  *
- * In certain circumstances, Unix mv will fall back to copying and
- * deleting the old copy. We don't do that.
+ * Like Unix mv, if the files are on different volumes (EXDEV) we fall
+ * back to copying the file, in the kernel with copy_file_range, and
+ * removing the old one.
  *
  * We also don't allow the Unix form of
  *     mv file1 file2 file3 destination-dir
  */
 
+static
+void
+docopy(const char *oldfile, const char *newfile)
+{
+	int fromfd, tofd;
+	ssize_t len;
+
+	fromfd = open(oldfile, O_RDONLY);
+	if (fromfd<0) {
+		err(1, "%s", oldfile);
+	}
+	tofd = open(newfile, O_WRONLY|O_CREAT|O_TRUNC);
+	if (tofd<0) {
+		err(1, "%s", newfile);
+	}
+
+	while ((len = copy_file_range(fromfd, tofd, 1024*1024))>0) {
+		/* nothing */
+	}
+	if (len<0) {
+		err(1, "%s to %s", oldfile, newfile);
+	}
+
+	if (close(fromfd) < 0) {
+		err(1, "%s: close", oldfile);
+	}
+	if (close(tofd) < 0) {
+		err(1, "%s: close", newfile);
+	}
+	if (remove(oldfile)) {
+		err(1, "%s", oldfile);
+	}
+}
+
 static
 void
 dorename(const char *oldfile, const char *newfile)
 {
 	if (rename(oldfile, newfile)) {
+		if (errno == EXDEV) {
+			docopy(oldfile, newfile);
+			return;
+		}
 		err(1, "%s or %s", oldfile, newfile);
 	}
 }
@@ -355,12 +355,129 @@ static struct {
 	{ NULL, NULL }
 };
 
+/*
+ * reporttime
+ * prints how long a subprocess (or pipeline) took, if timing is on.
+ */
+static
+void
+reporttime(time_t startsecs, unsigned long startnsecs)
+{
+	time_t endsecs;
+	unsigned long endnsecs;
+
+	if (!timing) {
+		return;
+	}
+	__time(&endsecs, &endnsecs);
+	if (endnsecs < startnsecs) {
+		endnsecs += 1000000000;
+		endsecs--;
+	}
+	endnsecs -= startnsecs;
+	endsecs -= startsecs;
+	warnx("subprocess time: %lu.%09lu seconds",
+	      (unsigned long) endsecs, (unsigned long) endnsecs);
+}
+
+/*
+ * dopipeline
+ * runs "cmd1 | cmd2 | ..." with each command's standard output
+ * connected to the next one's standard input, then waits for all of
+ * them. The exit status is that of the last command. args is split
+ * in place at each "|".
+ */
+static
+void
+dopipeline(char **args, int nargs, struct exitinfo *ei)
+{
+	pid_t pids[NARG_MAX / 2 + 1];
+	int nprocs = 0;
+	int fds[2];
+	int infd = -1;
+	int start, i, status;
+	pid_t pid;
+
+	exitinfo_exit(ei, 255);
+
+	start = 0;
+	for (i=0; i<=nargs; i++) {
+		if (i < nargs && strcmp(args[i], "|") != 0) {
+			continue;
+		}
+		args[i] = NULL;
+		if (i == start) {
+			printf("sh: Missing command in pipeline\n");
+			exitinfo_exit(ei, 1);
+			break;
+		}
+
+		fds[0] = fds[1] = -1;
+		if (i < nargs && pipe(fds) < 0) {
+			warn("pipe");
+			break;
+		}
+
+		pid = fork();
+		if (pid < 0) {
+			warn("fork");
+			if (fds[0] >= 0) {
+				close(fds[0]);
+				close(fds[1]);
+			}
+			break;
+		}
+		if (pid == 0) {
+			/* child */
+			if (infd >= 0) {
+				dup2(infd, 0);
+				close(infd);
+			}
+			if (fds[1] >= 0) {
+				dup2(fds[1], 1);
+				close(fds[1]);
+				close(fds[0]);
+			}
+			execvp(args[start], &args[start]);
+			warn("%s", args[start]);
+			_exit(1);
+		}
+
+		/* parent: the children have their own copies of the ends */
+		pids[nprocs++] = pid;
+		if (infd >= 0) {
+			close(infd);
+		}
+		if (fds[1] >= 0) {
+			close(fds[1]);
+		}
+		infd = fds[0];
+		start = i + 1;
+	}
+
+	if (infd >= 0) {
+		/* stopped early; let the last command see EOF */
+		close(infd);
+	}
+
+	for (i=0; i<nprocs; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			warn("waitpid");
+			exitinfo_exit(ei, 255);
+		}
+		else if (i == nprocs - 1 && start > nargs) {
+			readstatus(status, ei);
+		}
+	}
+}
+
 /*
  * docommand
  * tokenizes the command line using strtok.  if there aren't any commands,
  * simply returns.  checks to see if it's a builtin, running it if it is.
  * otherwise, it's a standard command.  check for the '&', try to background
- * the job if possible, otherwise just run it and wait on it.
+ * the job if possible, otherwise just run it and wait on it.  a command
+ * containing '|' is run as a pipeline instead.
  */
 static
 void
@@ -372,8 +489,9 @@ docommand(char *buf, struct exitinfo *ei)
 	pid_t pid;
 	int status;
 	int bg=0;
-	time_t startsecs, endsecs;
-	unsigned long startnsecs, endnsecs;
+	int pipeline=0;
+	time_t startsecs = 0;
+	unsigned long startnsecs = 0;
 
 	nargs = 0;
 	for (s = strtok(buf, " \t\r\n"); s; s = strtok(NULL, " \t\r\n")) {
@@ -417,10 +535,27 @@ docommand(char *buf, struct exitinfo *ei)
 		bg = 1;
 	}
 
+	for (i=0; i<nargs; i++) {
+		if (!strcmp(args[i], "|")) {
+			pipeline = 1;
+		}
+	}
+	if (pipeline && bg) {
+		printf("sh: Pipelines cannot be run in the background\n");
+		exitinfo_exit(ei, 1);
+		return;
+	}
+
 	if (timing) {
 		__time(&startsecs, &startnsecs);
 	}
 
+	if (pipeline) {
+		dopipeline(args, nargs, ei);
+		reporttime(startsecs, startnsecs);
+		return;
+	}
+
 	pid = fork();
 	switch (pid) {
 		case -1:
@@ -461,17 +596,7 @@ docommand(char *buf, struct exitinfo *ei)
 		readstatus(status, ei);
 	}
 
-	if (timing) {
-		__time(&endsecs, &endnsecs);
-		if (endnsecs < startnsecs) {
-			endnsecs += 1000000000;
-			endsecs--;
-		}
-		endnsecs -= startnsecs;
-		endsecs -= startsecs;
-		warnx("subprocess time: %lu.%09lu seconds",
-		      (unsigned long) endsecs, (unsigned long) endnsecs);
-	}
+	reporttime(startsecs, startnsecs);
 }
 
 /*
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+
+/*
+ * time - run a command and report the time and resources it used.
+ * Usage: time command [args...]
+ *
+ * Elapsed time comes from __time; everything else is the child's
+ * getrusage(RUSAGE_CHILDREN) totals once it has been waited for.
+ */
+
+static
+void
+subtime(time_t *secs, unsigned long *nsecs, time_t ssecs, unsigned long snsecs)
+{
+	if (*nsecs < snsecs) {
+		*nsecs += 1000000000;
+		(*secs)--;
+	}
+	*nsecs -= snsecs;
+	*secs -= ssecs;
+}
+
+int
+main(int argc, char *argv[])
+{
+	time_t startsecs, endsecs;
+	unsigned long startnsecs, endnsecs;
+	struct rusage ru;
+	pid_t pid;
+	int status;
+
+	if (argc < 2) {
+		errx(1, "Usage: time command [args...]");
+	}
+
+	__time(&startsecs, &startnsecs);
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		execvp(argv[1], &argv[1]);
+		warn("%s", argv[1]);
+		_exit(127);
+	}
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	__time(&endsecs, &endnsecs);
+	subtime(&endsecs, &endnsecs, startsecs, startnsecs);
+
+	if (getrusage(RUSAGE_CHILDREN, &ru) < 0) {
+		err(1, "getrusage");
+	}
+
+	fprintf(stderr, "%10lu.%03lu real %6lu.%03lu user %6lu.%03lu sys\n",
+		(unsigned long)endsecs, endnsecs / 1000000,
+		(unsigned long)ru.ru_utime.tv_sec,
+		(unsigned long)ru.ru_utime.tv_usec / 1000,
+		(unsigned long)ru.ru_stime.tv_sec,
+		(unsigned long)ru.ru_stime.tv_usec / 1000);
+	fprintf(stderr, "%10llu faults %llu+%llu csw (vol+invol)\n",
+		(unsigned long long)ru.ru_minflt,
+		(unsigned long long)ru.ru_nvcsw,
+		(unsigned long long)ru.ru_nivcsw);
+	fprintf(stderr, "%10llu bytes read %llu bytes written\n",
+		(unsigned long long)ru.ru_inbytes,
+		(unsigned long long)ru.ru_outbytes);
+
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
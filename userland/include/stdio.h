@@ -41,6 +41,70 @@
 /* Constant returned by a bunch of stdio functions on error */
 #define EOF (-1)
 
+/* Buffering modes for setvbuf */
+#define _IOFBF 0		/* fully buffered */
+#define _IOLBF 1		/* line buffered */
+#define _IONBF 2		/* unbuffered */
+
+#define BUFSIZ 1024		/* default buffer size */
+#define FOPEN_MAX 16		/* streams fopen can have open at once */
+
+/*
+ * A stdio stream.
+ *
+ * f_buf holds either pending output (__SWR set, f_len bytes) or
+ * input that hasn't been consumed yet (__SRD set, bytes f_pos through
+ * f_len-1), never both.
+ *
+ * An unbuffered stream still collects the output of a single call
+ * (one printf, say) in f_buf and writes it with one write(), so
+ * unbuffered only means nothing is held back between calls. stdout
+ * starts out line buffered and stdin and stderr unbuffered; use
+ * setvbuf to change that. Streams from fopen are fully buffered.
+ * fork() flushes every stream first, so a child doesn't inherit (and
+ * print again) its parent's pending output; _exit() does not flush.
+ *
+ * The fields are for libc internal use only.
+ */
+typedef struct __file {
+	int f_fd;		/* file handle */
+	unsigned f_flags;	/* __S* flags below; 0 if not in use */
+	int f_mode;		/* _IOFBF, _IOLBF, or _IONBF */
+	char *f_buf;		/* buffer */
+	size_t f_bufsize;	/* size of buffer */
+	size_t f_pos;		/* next input byte in f_buf */
+	size_t f_len;		/* end of data in f_buf */
+	char f_onebuf;		/* fallback if a buffer can't be malloc'd */
+} FILE;
+
+#define __SRD     0x01		/* f_buf holds input */
+#define __SWR     0x02		/* f_buf holds output */
+#define __SEOF    0x04		/* hit end of file */
+#define __SERR    0x08		/* got an I/O error */
+#define __SNL     0x10		/* newline written during this call */
+#define __SMALLOC 0x20		/* f_buf came from malloc */
+#define __SCANRD  0x40		/* opened for reading */
+#define __SCANWR  0x80		/* opened for writing */
+
+extern FILE *stdin;
+extern FILE *stdout;
+extern FILE *stderr;
+
+/*
+ * Stream buffer management
+ * (for libc internal use only)
+ *
+ * __stdio_put adds output to the buffer, writing it out as it fills.
+ * __stdio_endcall is called at the end of each output function and
+ * flushes if the buffering mode says so. __stdio_fill refills the
+ * input buffer; __stdio_flush writes pending output or discards
+ * buffered input.
+ */
+int __stdio_put(FILE *f, const char *data, size_t len);
+int __stdio_endcall(FILE *f);
+int __stdio_fill(FILE *f);
+int __stdio_flush(FILE *f);
+
 /*
  * The actual guts of printf
  * (for libc internal use only)
@@ -53,6 +117,8 @@ int __vprintf(void (*sendfunc)(void *clientdata, const char *, size_t len),
 /* Printf calls for user programs */
 int printf(const char *fmt, ...);
 int vprintf(const char *fmt, __va_list ap);
+int fprintf(FILE *f, const char *fmt, ...);
+int vfprintf(FILE *f, const char *fmt, __va_list ap);
 int snprintf(char *buf, size_t len, const char *fmt, ...);
 int vsnprintf(char *buf, size_t len, const char *fmt, __va_list ap);
 
@@ -74,4 +140,19 @@ int putchar(int);
 /* Reads one character (0-255) or returns EOF on error. */
 int getchar(void);
 
+/* Streams */
+FILE *fopen(const char *path, const char *mode);
+int fclose(FILE *f);
+int fflush(FILE *f);		/* fflush(NULL) flushes every stream */
+int setvbuf(FILE *f, char *buf, int mode, size_t size);
+size_t fread(void *buf, size_t size, size_t nitems, FILE *f);
+size_t fwrite(const void *buf, size_t size, size_t nitems, FILE *f);
+int fgetc(FILE *f);
+int fputc(int ch, FILE *f);
+int fputs(const char *str, FILE *f);
+int feof(FILE *f);
+int ferror(FILE *f);
+void clearerr(FILE *f);
+int fileno(FILE *f);
+
 #endif /* _STDIO_H_ */
@@ -0,0 +1,24 @@
+#ifndef _SYS_MMAN_H_
+#define _SYS_MMAN_H_
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*
+ * Get the PROT_*, MAP_* and MS_* flags from the kernel.
+ */
+#include <kern/mman.h>
+
+/* Returned by mmap on failure. */
+#define MAP_FAILED ((void *)-1)
+
+/*
+ * mmap only supports regular files (not anonymous memory). The address
+ * argument is a hint and is currently ignored. munmap may unmap part of
+ * a mapping.
+ */
+void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset);
+int munmap(void *addr, size_t len);
+int msync(void *addr, size_t len, int flags);
+
+#endif /* _SYS_MMAN_H_ */
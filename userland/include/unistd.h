@@ -43,6 +43,7 @@
 #include <kern/reboot.h>
 #include <kern/seek.h>
 #include <kern/time.h>
+#include <kern/resource.h>	/* after kern/time.h */
 #include <kern/unistd.h>
 #include <kern/wait.h>
 
@@ -111,7 +112,7 @@
 /* Required. */
 __DEAD void _exit(int code);
 int execv(const char *prog, char *const *args);
-pid_t fork(void);
+pid_t __fork(void);
 pid_t waitpid(pid_t pid, int *returncode, int flags);
 /*
  * Open actually takes either two or three args: the optional third
@@ -147,7 +148,15 @@ ssize_t readlink(const char *path, char *buf, size_t buflen);
 int dup2(int filehandle, int newhandle);
 int pipe(int filehandles[2]);
 int __time(time_t *seconds, unsigned long *nanoseconds);
+int nanosleep(const struct timespec *req, struct timespec *rem);
 ssize_t __getcwd(char *buf, size_t buflen);
+
+/* OS/161 additions. */
+ssize_t copy_file_range(int fromhandle, int tohandle, size_t len);
+int futex_wait(volatile int *addr, int val);	/* sleep if *addr == val */
+int futex_wake(volatile int *addr, int count);	/* wake up to count */
+int sem_op(int semfd, int delta);	/* P if delta < 0, V if delta > 0 */
+int getrusage(int who, struct rusage *usage);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
 
@@ -158,5 +167,6 @@ ssize_t __getcwd(char *buf, size_t buflen);
 int execvp(const char *prog, char *const *args); /* calls execv */
 char *getcwd(char *buf, size_t buflen);		/* calls __getcwd */
 time_t time(time_t *seconds);			/* calls __time */
+pid_t fork(void);				/* calls __fork */
 
 #endif /* _UNISTD_H_ */
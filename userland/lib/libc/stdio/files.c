@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/*
+ * Stream setup and buffer management for stdio.
+ */
+
+static char stdin_buf[BUFSIZ];
+static char stdout_buf[BUFSIZ];
+static char stderr_buf[BUFSIZ];
+
+static FILE stdfiles[3] = {
+	{ STDIN_FILENO, __SCANRD, _IONBF, stdin_buf, BUFSIZ, 0, 0, 0 },
+	{ STDOUT_FILENO, __SCANWR, _IOLBF, stdout_buf, BUFSIZ, 0, 0, 0 },
+	{ STDERR_FILENO, __SCANWR, _IONBF, stderr_buf, BUFSIZ, 0, 0, 0 },
+};
+
+FILE *stdin = &stdfiles[0];
+FILE *stdout = &stdfiles[1];
+FILE *stderr = &stdfiles[2];
+
+/* Streams handed out by fopen. A slot is free if f_flags is 0. */
+static FILE openfiles[FOPEN_MAX];
+
+/*
+ * Write out pending output, or give back input that was read ahead
+ * but not consumed by seeking backwards over it. (The seek fails on
+ * the console, in which case that input is just dropped.)
+ */
+int
+__stdio_flush(FILE *f)
+{
+	size_t pos;
+	ssize_t r;
+
+	if (f->f_flags & __SWR) {
+		pos = 0;
+		while (pos < f->f_len) {
+			r = write(f->f_fd, f->f_buf + pos, f->f_len - pos);
+			if (r <= 0) {
+				/* drop the rest rather than retrying forever */
+				f->f_flags |= __SERR;
+				f->f_flags &= ~__SWR;
+				f->f_len = 0;
+				return EOF;
+			}
+			pos += r;
+		}
+		f->f_flags &= ~__SWR;
+		f->f_len = 0;
+	}
+	else if (f->f_flags & __SRD) {
+		if (f->f_len > f->f_pos) {
+			lseek(f->f_fd, -(off_t)(f->f_len - f->f_pos), SEEK_CUR);
+		}
+		f->f_flags &= ~__SRD;
+		f->f_pos = f->f_len = 0;
+	}
+	return 0;
+}
+
+/*
+ * Append output to the buffer. A request at least as big as the
+ * buffer that finds it empty is written straight through.
+ */
+int
+__stdio_put(FILE *f, const char *data, size_t len)
+{
+	size_t n, i;
+	ssize_t r;
+
+	if ((f->f_flags & __SCANWR) == 0) {
+		f->f_flags |= __SERR;
+		errno = EBADF;
+		return EOF;
+	}
+	if (f->f_flags & __SRD) {
+		__stdio_flush(f);
+	}
+
+	while (len > 0) {
+		if (f->f_len == 0 && len >= f->f_bufsize) {
+			r = write(f->f_fd, data, len);
+			if (r <= 0) {
+				f->f_flags |= __SERR;
+				return EOF;
+			}
+			data += r;
+			len -= r;
+			continue;
+		}
+
+		n = f->f_bufsize - f->f_len;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(f->f_buf + f->f_len, data, n);
+		if (f->f_mode == _IOLBF) {
+			for (i=0; i<n; i++) {
+				if (data[i] == '\n') {
+					f->f_flags |= __SNL;
+					break;
+				}
+			}
+		}
+		f->f_len += n;
+		f->f_flags |= __SWR;
+		data += n;
+		len -= n;
+
+		if (f->f_len == f->f_bufsize) {
+			if (__stdio_flush(f)) {
+				return EOF;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * End of one output call: push the buffer out if the stream is
+ * unbuffered, or line buffered and a newline went by.
+ */
+int
+__stdio_endcall(FILE *f)
+{
+	int flush;
+
+	flush = f->f_mode == _IONBF ||
+		(f->f_mode == _IOLBF && (f->f_flags & __SNL));
+	f->f_flags &= ~__SNL;
+
+	if (flush && (f->f_flags & __SWR)) {
+		return __stdio_flush(f);
+	}
+	return 0;
+}
+
+/*
+ * Refill the input buffer. Returns EOF at end of file or on error.
+ *
+ * An unbuffered stream reads one byte at a time, so that input meant
+ * for whoever else shares the file handle (e.g. a child process on
+ * the console) isn't swallowed.
+ */
+int
+__stdio_fill(FILE *f)
+{
+	size_t want;
+	ssize_t r;
+
+	if ((f->f_flags & __SCANRD) == 0) {
+		f->f_flags |= __SERR;
+		errno = EBADF;
+		return EOF;
+	}
+	if (f->f_flags & __SWR) {
+		if (__stdio_flush(f)) {
+			return EOF;
+		}
+	}
+
+	/* Make sure any prompt is visible before waiting for input. */
+	if (f != stdout && (stdout->f_flags & __SWR)) {
+		__stdio_flush(stdout);
+	}
+
+	want = f->f_mode == _IONBF ? 1 : f->f_bufsize;
+	r = read(f->f_fd, f->f_buf, want);
+	if (r < 0) {
+		f->f_flags |= __SERR;
+		return EOF;
+	}
+	if (r == 0) {
+		f->f_flags |= __SEOF;
+		return EOF;
+	}
+	f->f_flags |= __SRD;
+	f->f_pos = 0;
+	f->f_len = r;
+	return 0;
+}
+
+/*
+ * C standard I/O function - open a stream.
+ */
+FILE *
+fopen(const char *path, const char *mode)
+{
+	FILE *f;
+	int oflags, fd, i;
+	unsigned sflags;
+
+	switch (mode[0]) {
+	    case 'r':
+		oflags = O_RDONLY;
+		sflags = __SCANRD;
+		break;
+	    case 'w':
+		oflags = O_WRONLY|O_CREAT|O_TRUNC;
+		sflags = __SCANWR;
+		break;
+	    case 'a':
+		oflags = O_WRONLY|O_CREAT|O_APPEND;
+		sflags = __SCANWR;
+		break;
+	    default:
+		errno = EINVAL;
+		return NULL;
+	}
+	for (i=1; mode[i]; i++) {
+		if (mode[i] == '+') {
+			oflags = (oflags & ~O_ACCMODE) | O_RDWR;
+			sflags = __SCANRD|__SCANWR;
+		}
+	}
+
+	f = NULL;
+	for (i=0; i<FOPEN_MAX; i++) {
+		if (openfiles[i].f_flags == 0) {
+			f = &openfiles[i];
+			break;
+		}
+	}
+	if (f == NULL) {
+		errno = EMFILE;
+		return NULL;
+	}
+
+	fd = open(path, oflags, 0664);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	f->f_fd = fd;
+	f->f_flags = sflags;
+	f->f_mode = _IOFBF;
+	f->f_pos = f->f_len = 0;
+	f->f_buf = malloc(BUFSIZ);
+	if (f->f_buf != NULL) {
+		f->f_bufsize = BUFSIZ;
+		f->f_flags |= __SMALLOC;
+	}
+	else {
+		f->f_buf = &f->f_onebuf;
+		f->f_bufsize = 1;
+		f->f_mode = _IONBF;
+	}
+	return f;
+}
+
+/*
+ * C standard I/O function - flush and close a stream.
+ */
+int
+fclose(FILE *f)
+{
+	int result;
+
+	result = __stdio_flush(f);
+	if (close(f->f_fd) < 0) {
+		result = EOF;
+	}
+	if (f->f_flags & __SMALLOC) {
+		free(f->f_buf);
+	}
+	f->f_buf = NULL;
+	f->f_flags = 0;
+	return result;
+}
+
+/*
+ * C standard I/O function - flush one stream, or with NULL, every
+ * stream that has output pending.
+ */
+int
+fflush(FILE *f)
+{
+	int i, result;
+
+	if (f != NULL) {
+		return __stdio_flush(f);
+	}
+
+	result = 0;
+	for (i=0; i<3; i++) {
+		if ((stdfiles[i].f_flags & __SWR) && __stdio_flush(&stdfiles[i])) {
+			result = EOF;
+		}
+	}
+	for (i=0; i<FOPEN_MAX; i++) {
+		if ((openfiles[i].f_flags & __SWR) &&
+		    __stdio_flush(&openfiles[i])) {
+			result = EOF;
+		}
+	}
+	return result;
+}
+
+/*
+ * C standard I/O function - set buffering mode and optionally
+ * supply a buffer. With buf NULL the current buffer is kept; an
+ * unbuffered stream still uses it to batch each call.
+ */
+int
+setvbuf(FILE *f, char *buf, int mode, size_t size)
+{
+	if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF) {
+		errno = EINVAL;
+		return EOF;
+	}
+	if (__stdio_flush(f)) {
+		return EOF;
+	}
+	if (buf != NULL && size > 0) {
+		if (f->f_flags & __SMALLOC) {
+			free(f->f_buf);
+			f->f_flags &= ~__SMALLOC;
+		}
+		f->f_buf = buf;
+		f->f_bufsize = size;
+	}
+	f->f_mode = mode;
+	return 0;
+}
+
+int
+feof(FILE *f)
+{
+	return (f->f_flags & __SEOF) != 0;
+}
+
+int
+ferror(FILE *f)
+{
+	return (f->f_flags & __SERR) != 0;
+}
+
+void
+clearerr(FILE *f)
+{
+	f->f_flags &= ~(__SEOF|__SERR);
+}
+
+int
+fileno(FILE *f)
+{
+	return f->f_fd;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * C standard I/O functions - buffered input.
+ */
+
+size_t
+fread(void *buf, size_t size, size_t nitems, FILE *f)
+{
+	char *dst = buf;
+	size_t total, done, n;
+	ssize_t r;
+
+	total = size * nitems;
+	if (total == 0) {
+		return 0;
+	}
+
+	done = 0;
+	while (done < total) {
+		if ((f->f_flags & __SRD) && f->f_pos < f->f_len) {
+			n = f->f_len - f->f_pos;
+			if (n > total - done) {
+				n = total - done;
+			}
+			memcpy(dst + done, f->f_buf + f->f_pos, n);
+			f->f_pos += n;
+			done += n;
+			continue;
+		}
+
+		/* Large reads skip the buffer once it's drained. */
+		if (f->f_mode != _IONBF && total - done >= f->f_bufsize &&
+		    (f->f_flags & (__SWR|__SCANRD)) == __SCANRD) {
+			r = read(f->f_fd, dst + done, total - done);
+			if (r < 0) {
+				f->f_flags |= __SERR;
+				break;
+			}
+			if (r == 0) {
+				f->f_flags |= __SEOF;
+				break;
+			}
+			done += r;
+			continue;
+		}
+
+		if (__stdio_fill(f)) {
+			break;
+		}
+	}
+	return done / size;
+}
+
+int
+fgetc(FILE *f)
+{
+	unsigned char ch;
+
+	if (!(f->f_flags & __SRD) || f->f_pos >= f->f_len) {
+		if (__stdio_fill(f)) {
+			return EOF;
+		}
+	}
+	ch = f->f_buf[f->f_pos++];
+
+	/*
+	 * Returned as unsigned char so EOF can be distinguished from
+	 * legal input.
+	 */
+	return ch;
+}
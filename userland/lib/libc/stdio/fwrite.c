@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * C standard I/O functions - buffered output. Each call ends with
+ * __stdio_endcall, which decides whether the buffer goes out now.
+ */
+
+size_t
+fwrite(const void *buf, size_t size, size_t nitems, FILE *f)
+{
+	size_t total;
+
+	total = size * nitems;
+	if (total == 0) {
+		return 0;
+	}
+	if (__stdio_put(f, buf, total)) {
+		return 0;
+	}
+	if (__stdio_endcall(f)) {
+		return 0;
+	}
+	return nitems;
+}
+
+int
+fputc(int ch, FILE *f)
+{
+	char c = ch;
+
+	if (__stdio_put(f, &c, 1) || __stdio_endcall(f)) {
+		return EOF;
+	}
+	return (unsigned char)c;
+}
+
+int
+fputs(const char *str, FILE *f)
+{
+	if (__stdio_put(f, str, strlen(str)) || __stdio_endcall(f)) {
+		return EOF;
+	}
+	return 0;
+}
@@ -38,6 +38,10 @@
  * printf - C standard I/O function.
  */
 
+struct printf_state {
+	FILE *f;
+	int err;
+};
 
 /*
  * Function passed to __vprintf to do the actual output.
@@ -46,11 +50,11 @@ static
 void
 __printf_send(void *mydata, const char *data, size_t len)
 {
-	ssize_t ret;
-	int *err = mydata;
+	struct printf_state *ps = mydata;
 
-	ret = write(STDOUT_FILENO, data, len);
-	*err = (ret == -1) ? errno : 0;
+	if (ps->err == 0 && __stdio_put(ps->f, data, len)) {
+		ps->err = errno;
+	}
 }
 
 /* printf: hand off to vprintf */
@@ -66,14 +70,45 @@ printf(const char *fmt, ...)
 	return chars;
 }
 
-/* vprintf: call __vprintf to do the work. */
+/* vprintf: printf to stdout. */
 int
 vprintf(const char *fmt, va_list ap)
 {
-	int chars, err;
-	chars = __vprintf(__printf_send, &err, fmt, ap);
-	if (err) {
-		errno = err;
+	return vfprintf(stdout, fmt, ap);
+}
+
+/* fprintf: hand off to vfprintf */
+int
+fprintf(FILE *f, const char *fmt, ...)
+{
+	int chars;
+	va_list ap;
+
+	va_start(ap, fmt);
+	chars = vfprintf(f, fmt, ap);
+	va_end(ap);
+	return chars;
+}
+
+/*
+ * vfprintf: call __vprintf to do the work. The whole call is
+ * collected in the stream buffer and, on an unbuffered stream,
+ * written out in one go at the end rather than piece by piece.
+ */
+int
+vfprintf(FILE *f, const char *fmt, va_list ap)
+{
+	struct printf_state ps;
+	int chars;
+
+	ps.f = f;
+	ps.err = 0;
+	chars = __vprintf(__printf_send, &ps, fmt, ap);
+	if (__stdio_endcall(f) && ps.err == 0) {
+		ps.err = errno;
+	}
+	if (ps.err) {
+		errno = ps.err;
 		return -1;
 	}
 	return chars;
@@ -28,6 +28,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 /*
  * C standard I/O function - print a string and a newline.
@@ -36,7 +37,11 @@
 int
 puts(const char *s)
 {
-	__puts(s);
-	putchar('\n');
+	/* One call, so the string and newline go out in one write. */
+	if (__stdio_put(stdout, s, strlen(s)) ||
+	    __stdio_put(stdout, "\n", 1) ||
+	    __stdio_endcall(stdout)) {
+		return EOF;
+	}
 	return 0;
 }
@@ -30,10 +30,13 @@
 /*
  * User-level malloc and free implementation.
  *
- * This is a basic first-fit allocator. It's intended to be simple and
- * easy to follow. It performs abysmally if the heap becomes larger than
- * physical memory. To get (much) better out-of-core performance, port
- * the kernel's malloc. :-)
+ * Blocks are laid out end to end in the heap with boundary headers, as
+ * in a simple first-fit allocator, but free blocks are kept on
+ * segregated free lists by size so neither malloc nor free has to walk
+ * the heap. When enough free space collects at the top of the heap it
+ * is handed back with a negative sbrk. It still performs abysmally if
+ * the heap becomes larger than physical memory. To get (much) better
+ * out-of-core performance, port the kernel's malloc. :-)
  */
 
 #include <stdlib.h>
@@ -44,6 +47,18 @@
 
 #undef MALLOCDEBUG
 
+/*
+ * libmtmalloc compiles this file a second time, with MALLOC_CENTRAL
+ * defined, as the shared heap behind its per-thread caches. It does
+ * its own locking; here we just take different names and provide a
+ * way to ask how big a block is.
+ */
+#ifdef MALLOC_CENTRAL
+#define malloc __malloc_central
+#define free __free_central
+size_t __malloc_usable_size(void *ptr);
+#endif
+
 #if defined(__mips__) || defined(__i386__)
 #define MALLOC32
 #elif defined(__alpha__) || defined(__x86_64__)
@@ -134,6 +149,33 @@ struct mheader {
 
 #define M_MKFIELD(off)	((off)>>MBLOCKSHIFT)
 
+/*
+ * Free list links, kept in the data area of a free block. This is
+ * MBLOCKSIZE bytes, so every block has at least MBLOCKSIZE bytes of
+ * data.
+ */
+struct mfreelink {
+	struct mheader *mf_next;
+	struct mheader *mf_prev;
+};
+
+#define M_LINK(mh)	((struct mfreelink *)M_DATA(mh))
+
+/*
+ * Free list bins: MSMALLBINS exact-size bins (MSMALLBINS is
+ * 1<<MSMALLSHIFT) followed by one bin per power of 2 up to the largest
+ * possible block.
+ */
+#define MSMALLSHIFT	6
+#define MSMALLBINS	(1 << MSMALLSHIFT)
+#define MNBINS		(MSMALLBINS + sizeof(size_t)*8 - MSMALLSHIFT)
+
+/*
+ * Once this much free space accumulates at the top of the heap, it
+ * is returned with sbrk.
+ */
+#define MTRIMSIZE	(16 * PAGE_SIZE)
+
 /*
  * System page size. In POSIX you're supposed to call
  * sysconf(_SC_PAGESIZE). If _SC_PAGESIZE isn't defined, as on OS/161,
@@ -154,6 +196,17 @@ static size_t __malloc_pagesize;
  */
 static uintptr_t __heapbase, __heaptop;
 
+/*
+ * The highest block in the heap, or NULL if the heap is empty.
+ */
+static struct mheader *__heaplast;
+
+/*
+ * Free list heads and the bitmap of nonempty bins.
+ */
+static struct mheader *__malloc_bins[MNBINS];
+static unsigned __malloc_binmap[(MNBINS + 31) / 32];
+
 /*
  * Setup function.
  */
@@ -273,6 +326,150 @@ __malloc_dump(void)
 
 ////////////////////////////////////////////////////////////
 
+/*
+ * Free lists.
+ *
+ * Each bin is a doubly linked list of free blocks, threaded through
+ * struct mfreelink at the start of the blocks' data area. There are
+ * MSMALLBINS exact-size bins for small blocks (bin n holds blocks of
+ * exactly (n+1)*MBLOCKSIZE data bytes), then one bin per power of 2
+ * above that. __malloc_binmap has a bit set for each nonempty bin so
+ * the next bin with something in it can be found without looking at
+ * the empty ones.
+ */
+
+static
+unsigned
+__malloc_binof(size_t size)
+{
+	size_t n = size >> MBLOCKSHIFT;
+	unsigned bin;
+
+	if (n <= MSMALLBINS) {
+		return n - 1;
+	}
+	bin = MSMALLBINS;
+	for (n >>= MSMALLSHIFT+1; n > 0; n >>= 1) {
+		bin++;
+	}
+	return bin;
+}
+
+static
+void
+__malloc_link(struct mheader *mh)
+{
+	unsigned bin = __malloc_binof(M_SIZE(mh));
+	struct mheader *head = __malloc_bins[bin];
+
+	M_LINK(mh)->mf_prev = NULL;
+	M_LINK(mh)->mf_next = head;
+	if (head != NULL) {
+		M_LINK(head)->mf_prev = mh;
+	}
+	__malloc_bins[bin] = mh;
+	__malloc_binmap[bin / 32] |= 1U << (bin % 32);
+}
+
+static
+void
+__malloc_unlink(struct mheader *mh)
+{
+	unsigned bin = __malloc_binof(M_SIZE(mh));
+	struct mfreelink *ml = M_LINK(mh);
+
+	if (ml->mf_prev != NULL) {
+		M_LINK(ml->mf_prev)->mf_next = ml->mf_next;
+	}
+	else {
+		if (__malloc_bins[bin] != mh) {
+			errx(1, "malloc: Heap corrupt; free block %p not on "
+			     "its list", M_DATA(mh));
+		}
+		__malloc_bins[bin] = ml->mf_next;
+		if (ml->mf_next == NULL) {
+			__malloc_binmap[bin / 32] &= ~(1U << (bin % 32));
+		}
+	}
+	if (ml->mf_next != NULL) {
+		M_LINK(ml->mf_next)->mf_prev = ml->mf_prev;
+	}
+}
+
+/*
+ * Return the first nonempty bin numbered bin or higher, or MNBINS if
+ * there isn't one.
+ */
+static
+unsigned
+__malloc_nextbin(unsigned bin)
+{
+	unsigned word, bits;
+
+	while (bin < MNBINS) {
+		word = bin / 32;
+		bits = __malloc_binmap[word] >> (bin % 32);
+		if (bits == 0) {
+			bin = (word + 1) * 32;
+			continue;
+		}
+		while ((bits & 1) == 0) {
+			bits >>= 1;
+			bin++;
+		}
+		return bin;
+	}
+	return MNBINS;
+}
+
+/*
+ * Find a free block with at least size bytes of data and take it off
+ * its list. A small bin only holds blocks of one size, and every block
+ * in a higher bin than size's own is big enough, so only size's own
+ * bin ever needs searching; there we take the best fit.
+ */
+static
+struct mheader *
+__malloc_findfree(size_t size)
+{
+	struct mheader *mh, *best;
+	unsigned bin;
+
+	bin = __malloc_binof(size);
+	if (bin >= MSMALLBINS) {
+		best = NULL;
+		for (mh = __malloc_bins[bin]; mh != NULL;
+		     mh = M_LINK(mh)->mf_next) {
+			if (M_SIZE(mh) >= size &&
+			    (best == NULL || M_SIZE(mh) < M_SIZE(best))) {
+				best = mh;
+				if (M_SIZE(mh) == size) {
+					break;
+				}
+			}
+		}
+		if (best != NULL) {
+			__malloc_unlink(best);
+			return best;
+		}
+		bin++;
+	}
+
+	bin = __malloc_nextbin(bin);
+	if (bin == MNBINS) {
+		return NULL;
+	}
+	mh = __malloc_bins[bin];
+	if (!M_OK(mh) || mh->mh_inuse) {
+		errx(1, "malloc: Heap corrupt; bad block %p on free list",
+		     M_DATA(mh));
+	}
+	__malloc_unlink(mh);
+	return mh;
+}
+
+////////////////////////////////////////////////////////////
+
 /*
  * Get more memory (at the top of the heap) using sbrk, and
  * return a pointer to it.
@@ -301,7 +498,7 @@ __malloc_sbrk(size_t size)
 /*
  * Make a new (free) block from the block passed in, leaving size
  * bytes for data in the current block. size must be a multiple of
- * MBLOCKSIZE.
+ * MBLOCKSIZE. The new block goes on the free lists.
  *
  * Only split if the excess space is at least twice the blocksize -
  * one blocksize to hold a header and one for data.
@@ -343,6 +540,11 @@ __malloc_split(struct mheader *mh, size_t size)
 	if (mhnext != (struct mheader *) __heaptop) {
 		mhnext->mh_prevblock = mhnew->mh_nextblock;
 	}
+	else {
+		__heaplast = mhnew;
+	}
+
+	__malloc_link(mhnew);
 }
 
 /*
@@ -352,8 +554,6 @@ void *
 malloc(size_t size)
 {
 	struct mheader *mh;
-	uintptr_t i;
-	size_t rightprevblock;
 	size_t morespace;
 	void *p;
 
@@ -372,48 +572,18 @@ malloc(size_t size)
 	__malloc_dump();
 #endif
 
-	/* Round size up to an integral number of blocks. */
-	size = ((size + MBLOCKSIZE - 1) & ~(size_t)(MBLOCKSIZE-1));
-
 	/*
-	 * First-fit search algorithm for available blocks.
-	 * Check to make sure the next/previous sizes all agree.
+	 * Round size up to an integral number of blocks. Every block
+	 * needs room for the free list links once it's freed.
 	 */
-	rightprevblock = 0;
-	mh = NULL;
-	for (i=__heapbase; i<__heaptop; i += M_NEXTOFF(mh)) {
-		mh = (struct mheader *) i;
-		if (!M_OK(mh)) {
-			errx(1, "malloc: Heap corrupt; header at 0x%lx"
-			     " has bad magic bits",
-			     (unsigned long) i);
-		}
-		if (mh->mh_prevblock != rightprevblock) {
-			errx(1, "malloc: Heap corrupt; header at 0x%lx"
-			     " has bad previous-block size %lu "
-			     "(should be %lu)",
-			     (unsigned long) i,
-			     (unsigned long) mh->mh_prevblock << MBLOCKSHIFT,
-			     (unsigned long) rightprevblock << MBLOCKSHIFT);
-		}
-		rightprevblock = mh->mh_nextblock;
-
-		/* Can't allocate a block that's in use. */
-		if (mh->mh_inuse) {
-			continue;
-		}
-
-		/* Can't allocate a block that isn't big enough. */
-		if (M_SIZE(mh) < size) {
-			continue;
-		}
+	size = ((size + MBLOCKSIZE - 1) & ~(size_t)(MBLOCKSIZE-1));
+	if (size < MBLOCKSIZE) {
+		size = MBLOCKSIZE;
+	}
 
-		/* Try splitting block. */
+	mh = __malloc_findfree(size);
+	if (mh != NULL) {
 		__malloc_split(mh, size);
-
-		/*
-		 * Now, allocate.
-		 */
 		mh->mh_inuse = 1;
 
 #ifdef MALLOCDEBUG
@@ -422,17 +592,14 @@ malloc(size_t size)
 #endif
 		return M_DATA(mh);
 	}
-	if (i!=__heaptop) {
-		errx(1, "malloc: Heap corrupt; ran off end");
-	}
 
 	/*
 	 * Didn't find anything. Expand the heap.
 	 *
-	 * If the heap is nonempty and the top block (the one mh is
-	 * left pointing to after the above loop) is free, we can
-	 * expand it. Otherwise we need a new block.
+	 * If the top block is free, we can expand it. Otherwise we
+	 * need a new block.
 	 */
+	mh = __heaplast;
 	if (mh != NULL && !mh->mh_inuse) {
 		assert(size > M_SIZE(mh));
 		morespace = size - M_SIZE(mh);
@@ -451,18 +618,20 @@ malloc(size_t size)
 
 	if (mh != NULL && !mh->mh_inuse) {
 		/* update old header */
+		__malloc_unlink(mh);
 		mh->mh_nextblock = M_MKFIELD(M_NEXTOFF(mh) + morespace);
 		mh->mh_inuse = 1;
 	}
 	else {
 		/* fill out new header */
 		mh = p;
-		mh->mh_prevblock = rightprevblock;
+		mh->mh_prevblock = __heaplast ? __heaplast->mh_nextblock : 0;
 		mh->mh_magic1 = MMAGIC;
 		mh->mh_magic2 = MMAGIC;
 		mh->mh_pad = 0;
 		mh->mh_inuse = 1;
 		mh->mh_nextblock = M_MKFIELD(morespace);
+		__heaplast = mh;
 	}
 
 	/*
@@ -497,11 +666,12 @@ __malloc_deadbeef(void *ptr, size_t size)
 }
 
 /*
- * Attempt to merge two adjacent blocks (mh below mhnext).
+ * Merge two adjacent free blocks (mh below mhnext). Neither may be
+ * on a free list.
  */
 static
 void
-__malloc_trymerge(struct mheader *mh, struct mheader *mhnext)
+__malloc_merge(struct mheader *mh, struct mheader *mhnext)
 {
 	struct mheader *mhnextnext;
 
@@ -509,10 +679,6 @@ __malloc_trymerge(struct mheader *mh, struct mheader *mhnext)
 		errx(1, "free: Heap corrupt (%p and %p inconsistent)",
 		     mh, mhnext);
 	}
-	if (mh->mh_inuse || mhnext->mh_inuse) {
-		/* can't merge */
-		return;
-	}
 
 	mhnextnext = M_NEXT(mhnext);
 
@@ -522,11 +688,54 @@ __malloc_trymerge(struct mheader *mh, struct mheader *mhnext)
 	if (mhnextnext != (struct mheader *)__heaptop) {
 		mhnextnext->mh_prevblock = mh->mh_nextblock;
 	}
+	else {
+		__heaplast = mh;
+	}
 
 	/* Deadbeef out the memory used by the now-obsolete header */
 	__malloc_deadbeef(mhnext, sizeof(struct mheader));
 }
 
+/*
+ * Give the free block at the top of the heap back to the system if
+ * it has grown past MTRIMSIZE. Whole pages are released; if the block
+ * doesn't start on a page boundary, its header and one block of data
+ * stay behind. The block must not be on a free list.
+ *
+ * Returns the block, or NULL if it went away entirely.
+ */
+static
+struct mheader *
+__malloc_trim(struct mheader *mh)
+{
+	uintptr_t newtop;
+
+	if ((uintptr_t)mh % PAGE_SIZE == 0) {
+		newtop = (uintptr_t)mh;
+	}
+	else {
+		newtop = (uintptr_t)mh + 2*MBLOCKSIZE;
+		newtop = PAGE_SIZE * ((newtop + PAGE_SIZE - 1) / PAGE_SIZE);
+	}
+	if (newtop >= __heaptop || __heaptop - newtop < MTRIMSIZE) {
+		return mh;
+	}
+
+	/* If the system won't take it back, just keep it. */
+	if (sbrk(-(intptr_t)(__heaptop - newtop)) == (void *)-1) {
+		return mh;
+	}
+	__heaptop = newtop;
+
+	if (newtop == (uintptr_t)mh) {
+		__heaplast = (mh == (struct mheader *)__heapbase) ?
+			NULL : M_PREV(mh);
+		return NULL;
+	}
+	mh->mh_nextblock = M_MKFIELD(newtop - (uintptr_t)mh);
+	return mh;
+}
+
 /*
  * The actual free() implementation.
  */
@@ -572,16 +781,28 @@ free(void *x)
 	/* wipe it */
 	__malloc_deadbeef(M_DATA(mh), M_SIZE(mh));
 
-	/* Try merging with the block above (but not if we're at the top) */
+	/* Merge with the block above if it's free (and we're not at the top) */
 	mhnext = M_NEXT(mh);
-	if (mhnext != (struct mheader *)__heaptop) {
-		__malloc_trymerge(mh, mhnext);
+	if (mhnext != (struct mheader *)__heaptop && !mhnext->mh_inuse) {
+		__malloc_unlink(mhnext);
+		__malloc_merge(mh, mhnext);
 	}
 
-	/* Try merging with the block below (but not if we're at the bottom) */
+	/* Merge with the block below if it's free (and we're not at the bottom) */
 	if (mh != (struct mheader *)__heapbase) {
 		mhprev = M_PREV(mh);
-		__malloc_trymerge(mhprev, mh);
+		if (!mhprev->mh_inuse) {
+			__malloc_unlink(mhprev);
+			__malloc_merge(mhprev, mh);
+			mh = mhprev;
+		}
+	}
+
+	if (mh == __heaplast) {
+		mh = __malloc_trim(mh);
+	}
+	if (mh != NULL) {
+		__malloc_link(mh);
 	}
 
 #ifdef MALLOCDEBUG
@@ -589,3 +810,21 @@ free(void *x)
 	__malloc_dump();
 #endif
 }
+
+#ifdef MALLOC_CENTRAL
+/*
+ * Number of data bytes in the block holding ptr. This is at least
+ * what was asked for, and may be a bit more if splitting the block
+ * would have left too little to be worth it.
+ */
+size_t
+__malloc_usable_size(void *ptr)
+{
+	struct mheader *mh = ((struct mheader *)ptr)-1;
+
+	if (!M_OK(mh) || !mh->mh_inuse) {
+		errx(1, "malloc: Invalid pointer %p (corrupt header)", ptr);
+	}
+	return M_SIZE(mh);
+}
+#endif /* MALLOC_CENTRAL */
@@ -53,7 +53,7 @@ __senderr(void *junk, const char *data, size_t len)
 {
 	(void)junk;  /* not needed or used */
 
-	write(STDERR_FILENO, data, len);
+	__stdio_put(stderr, data, len);
 }
 
 /*
@@ -98,6 +98,9 @@ __printerr(int use_errno, const char *fmt, va_list ap)
 		prog = "(program name unknown)";
 	}
 
+	/* get anything already printed to stdout out first */
+	fflush(stdout);
+
 	/* print the program name */
 	__senderrstr(prog);
 	__senderrstr(": ");
@@ -113,6 +116,9 @@ __printerr(int use_errno, const char *fmt, va_list ap)
 
 	/* and always add a newline. */
 	__senderrstr("\n");
+
+	/* the message goes out as a single write */
+	__stdio_endcall(stderr);
 }
 
 /*
@@ -0,0 +1,236 @@
+/*
+ * Thread-safe malloc and free.
+ *
+ * Small blocks are recycled through a set of caches, each with its own
+ * lock; a thread picks its cache by hashing its stack pointer, so as
+ * long as threads have separate stacks they mostly stay out of each
+ * other's way. Everything else goes to libc's allocator (built here as
+ * __malloc_central/__free_central), which is protected by one lock.
+ * The caches refill from and drain to it in batches, so a thread takes
+ * the central lock once per MTBATCH small allocations or frees at most.
+ *
+ * There is no thread-local storage, so "per-thread" is really "per
+ * stack address"; two threads that hash to the same cache are still
+ * correct, they just share a lock.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <err.h>
+
+void *__malloc_central(size_t size);
+void __free_central(void *ptr);
+size_t __malloc_usable_size(void *ptr);
+
+#define MTGRAIN		8	/* size class spacing */
+#define MTNCLASSES	32	/* classes cover 8 through 256 bytes */
+#define MTMAXSMALL	(MTGRAIN * MTNCLASSES)
+#define MTNCACHES	8	/* must be a power of 2 */
+#define MTBATCH		16	/* blocks moved to or from the heap at once */
+#define MTCACHEMAX	(4 * MTBATCH)	/* most blocks a class will hold */
+
+/*
+ * Free blocks in a cache are linked through their first word.
+ */
+struct mtblock {
+	struct mtblock *next;
+};
+
+struct mtcache {
+	volatile unsigned mc_lock;
+	struct mtblock *mc_free[MTNCLASSES];
+	unsigned mc_count[MTNCLASSES];
+};
+
+static struct mtcache mtcaches[MTNCACHES];
+static volatile unsigned mtheaplock;
+
+////////////////////////////////////////////////////////////
+
+/*
+ * Spinlocks. There's no way to sleep waiting for another user thread,
+ * and the critical sections are short.
+ */
+
+static
+unsigned
+mt_testandset(volatile unsigned *lk)
+{
+#ifdef __mips__
+	unsigned x, y;
+
+	/* Same LL/SC sequence as the kernel's spinlock_data_testandset. */
+	y = 1;
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set volatile;"	/* avoid unwanted optimization */
+		"ll %0, 0(%2);"		/*   x = *lk */
+		"sc %1, 0(%2);"		/*   *lk = y; y = success? */
+		".set pop"		/* restore assembler mode */
+		: "=&r" (x), "+r" (y) : "r" (lk) : "memory");
+	if (y == 0) {
+		return 1;
+	}
+	return x;
+#else
+	return __sync_lock_test_and_set(lk, 1);
+#endif
+}
+
+static
+void
+mt_lock(volatile unsigned *lk)
+{
+	while (1) {
+		/* Wait for it to look free before trying the LL/SC. */
+		while (*lk != 0) {
+			/* spin */
+		}
+		if (mt_testandset(lk) == 0) {
+			return;
+		}
+	}
+}
+
+static
+void
+mt_unlock(volatile unsigned *lk)
+{
+#ifdef __mips__
+	__asm volatile(".set push; .set mips32; sync; .set pop" ::: "memory");
+	*lk = 0;
+#else
+	__sync_lock_release(lk);
+#endif
+}
+
+////////////////////////////////////////////////////////////
+
+static
+struct mtcache *
+mt_mycache(void)
+{
+	uintptr_t sp = (uintptr_t)&sp;
+
+	/* Stacks are at least this far apart, so mix in the bits above. */
+	sp >>= 16;
+	return &mtcaches[(sp ^ (sp >> 3)) & (MTNCACHES - 1)];
+}
+
+/*
+ * Move up to MTBATCH blocks of class CLASS from the heap into MC.
+ * Called with mc locked.
+ */
+static
+void
+mt_refill(struct mtcache *mc, unsigned class)
+{
+	struct mtblock *b;
+	unsigned i;
+
+	mt_lock(&mtheaplock);
+	for (i=0; i<MTBATCH; i++) {
+		b = __malloc_central((class + 1) * MTGRAIN);
+		if (b == NULL) {
+			break;
+		}
+		b->next = mc->mc_free[class];
+		mc->mc_free[class] = b;
+		mc->mc_count[class]++;
+	}
+	mt_unlock(&mtheaplock);
+}
+
+/*
+ * Give MTBATCH blocks of class CLASS back to the heap. Called with mc
+ * locked.
+ */
+static
+void
+mt_drain(struct mtcache *mc, unsigned class)
+{
+	struct mtblock *b;
+	unsigned i;
+
+	mt_lock(&mtheaplock);
+	for (i=0; i<MTBATCH && mc->mc_free[class] != NULL; i++) {
+		b = mc->mc_free[class];
+		mc->mc_free[class] = b->next;
+		mc->mc_count[class]--;
+		__free_central(b);
+	}
+	mt_unlock(&mtheaplock);
+}
+
+void *
+malloc(size_t size)
+{
+	struct mtcache *mc;
+	struct mtblock *b;
+	unsigned class;
+	void *p;
+
+	if (size > MTMAXSMALL) {
+		mt_lock(&mtheaplock);
+		p = __malloc_central(size);
+		mt_unlock(&mtheaplock);
+		return p;
+	}
+
+	class = size == 0 ? 0 : (size - 1) / MTGRAIN;
+	mc = mt_mycache();
+
+	mt_lock(&mc->mc_lock);
+	if (mc->mc_free[class] == NULL) {
+		mt_refill(mc, class);
+	}
+	b = mc->mc_free[class];
+	if (b != NULL) {
+		mc->mc_free[class] = b->next;
+		mc->mc_count[class]--;
+	}
+	mt_unlock(&mc->mc_lock);
+
+	return b;
+}
+
+void
+free(void *ptr)
+{
+	struct mtcache *mc;
+	struct mtblock *b;
+	unsigned class;
+	size_t size;
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	/*
+	 * The header isn't touched by anyone else while the block is
+	 * allocated, so this doesn't need the heap lock. A block may be
+	 * a little bigger than its class; it can go back in any class it
+	 * is big enough for.
+	 */
+	size = __malloc_usable_size(ptr);
+	if (size > MTMAXSMALL) {
+		mt_lock(&mtheaplock);
+		__free_central(ptr);
+		mt_unlock(&mtheaplock);
+		return;
+	}
+
+	class = size / MTGRAIN - 1;
+	mc = mt_mycache();
+	b = ptr;
+
+	mt_lock(&mc->mc_lock);
+	b->next = mc->mc_free[class];
+	mc->mc_free[class] = b;
+	mc->mc_count[class]++;
+	if (mc->mc_count[class] > MTCACHEMAX) {
+		mt_drain(mc, class);
+	}
+	mt_unlock(&mc->mc_lock);
+}
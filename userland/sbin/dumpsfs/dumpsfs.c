@@ -163,6 +163,14 @@ dumpsb(void)
 		 SFS_FREEMAPBLOCKS(SWAP32(sb.sb_nblocks)));
 	dumpvalf("Block size", "%u bytes", SFS_BLOCKSIZE);
 	dumplval("Volume name", sb.sb_volname);
+	if (sb.sb_journalblocks != 0) {
+		dumpvalf("Journal", "%u blocks at block %u",
+			 SWAP32(sb.sb_journalblocks),
+			 SWAP32(sb.sb_journalstart));
+	}
+	else {
+		dumplval("Journal", "none");
+	}
 
 	for (i=0; i<ARRAYCOUNT(sb.reserved); i++) {
 		if (sb.reserved[i] != 0) {
@@ -296,22 +304,19 @@ traverse(const struct sfs_dinode *sfi, void (*doblock)(uint32_t, uint32_t))
 	assert(fileblock == numblocks);
 }
 
+static
+int
+isinline(const struct sfs_dinode *sfi)
+{
+	return (SWAP32(sfi->sfi_flags) & SFS_DINODE_INLINE) != 0;
+}
+
 static
 void
-dumpdirblock(uint32_t fileblock, uint32_t diskblock)
+dumpdirents(struct sfs_direntry *sds, int nsds)
 {
-	struct sfs_direntry sds[SFS_BLOCKSIZE/sizeof(struct sfs_direntry)];
-	int nsds = SFS_BLOCKSIZE/sizeof(struct sfs_direntry);
 	int i;
 
-	(void)fileblock;
-	if (diskblock == 0) {
-		printf("    [block %u - empty]\n", diskblock);
-		return;
-	}
-	diskread(&sds, diskblock);
-
-	printf("    [block %u]\n", diskblock);
 	for (i=0; i<nsds; i++) {
 		uint32_t ino = SWAP32(sds[i].sfd_ino);
 		if (ino==SFS_NOINO) {
@@ -324,6 +329,23 @@ dumpdirblock(uint32_t fileblock, uint32_t diskblock)
 	}
 }
 
+static
+void
+dumpdirblock(uint32_t fileblock, uint32_t diskblock)
+{
+	struct sfs_direntry sds[SFS_BLOCKSIZE/sizeof(struct sfs_direntry)];
+
+	(void)fileblock;
+	if (diskblock == 0) {
+		printf("    [block %u - empty]\n", diskblock);
+		return;
+	}
+	diskread(&sds, diskblock);
+
+	printf("    [block %u]\n", diskblock);
+	dumpdirents(sds, ARRAYCOUNT(sds));
+}
+
 static
 void
 dumpdir(uint32_t ino, const struct sfs_dinode *sfi)
@@ -335,33 +357,54 @@ dumpdir(uint32_t ino, const struct sfs_dinode *sfi)
 		warnx("Warning: dir size is not a multiple of dir entry size");
 	}
 	printf("Directory contents for inode %u: %d entries\n", ino, nentries);
+	if (isinline(sfi)) {
+		struct sfs_direntry sds[SFS_INLINESIZE/sizeof(struct sfs_direntry)];
+
+		if (nentries > (int)ARRAYCOUNT(sds)) {
+			nentries = ARRAYCOUNT(sds);
+		}
+		memcpy(sds, SFS_INLINEDATA(sfi), nentries * sizeof(sds[0]));
+		printf("    [inline]\n");
+		dumpdirents(sds, nentries);
+		return;
+	}
 	traverse(sfi, dumpdirblock);
 }
 
 static
 void
-recursedirblock(uint32_t fileblock, uint32_t diskblock)
+recursedirents(struct sfs_direntry *sds, int nsds)
 {
-	struct sfs_direntry sds[SFS_BLOCKSIZE/sizeof(struct sfs_direntry)];
-	int nsds = SFS_BLOCKSIZE/sizeof(struct sfs_direntry);
 	int i;
 
-	(void)fileblock;
-	if (diskblock == 0) {
-		return;
-	}
-	diskread(&sds, diskblock);
-
 	for (i=0; i<nsds; i++) {
 		uint32_t ino = SWAP32(sds[i].sfd_ino);
 		if (ino==SFS_NOINO) {
 			continue;
 		}
 		sds[i].sfd_name[SFS_NAMELEN-1] = 0; /* just in case */
+		if (!strcmp(sds[i].sfd_name, ".") ||
+		    !strcmp(sds[i].sfd_name, "..")) {
+			continue;
+		}
 		dumpinode(ino, sds[i].sfd_name);
 	}
 }
 
+static
+void
+recursedirblock(uint32_t fileblock, uint32_t diskblock)
+{
+	struct sfs_direntry sds[SFS_BLOCKSIZE/sizeof(struct sfs_direntry)];
+
+	(void)fileblock;
+	if (diskblock == 0) {
+		return;
+	}
+	diskread(&sds, diskblock);
+	recursedirents(sds, ARRAYCOUNT(sds));
+}
+
 static
 void
 recursedir(uint32_t ino, const struct sfs_dinode *sfi)
@@ -370,24 +413,32 @@ recursedir(uint32_t ino, const struct sfs_dinode *sfi)
 
 	nentries = SWAP32(sfi->sfi_size) / sizeof(struct sfs_direntry);
 	printf("Reading files in directory %u: %d entries\n", ino, nentries);
-	traverse(sfi, recursedirblock);
+	if (isinline(sfi)) {
+		struct sfs_direntry sds[SFS_INLINESIZE/sizeof(struct sfs_direntry)];
+
+		if (nentries > (int)ARRAYCOUNT(sds)) {
+			nentries = ARRAYCOUNT(sds);
+		}
+		memcpy(sds, SFS_INLINEDATA(sfi), nentries * sizeof(sds[0]));
+		recursedirents(sds, nentries);
+	}
+	else {
+		traverse(sfi, recursedirblock);
+	}
 	printf("Done with directory %u\n", ino);
 }
 
+/*
+ * Hex dump LEN bytes of file data (LEN a multiple of 16).
+ */
 static
-void dumpfileblock(uint32_t fileblock, uint32_t diskblock)
+void
+dumpfiledata(uint32_t fileblock, const uint8_t *data, unsigned len)
 {
-	uint8_t data[SFS_BLOCKSIZE];
 	unsigned i, j;
 	char tmp[128];
 
-	if (diskblock == 0) {
-		printf("    0x%6x  [sparse]\n", fileblock * SFS_BLOCKSIZE);
-		return;
-	}
-
-	diskread(data, diskblock);
-	for (i=0; i<SFS_BLOCKSIZE; i++) {
+	for (i=0; i<len; i++) {
 		if (i % 16 == 0) {
 			snprintf(tmp, sizeof(tmp), "0x%x",
 				 fileblock * SFS_BLOCKSIZE + i);
@@ -415,11 +466,38 @@ void dumpfileblock(uint32_t fileblock, uint32_t diskblock)
 	}
 }
 
+static
+void
+dumpfileblock(uint32_t fileblock, uint32_t diskblock)
+{
+	uint8_t data[SFS_BLOCKSIZE];
+
+	if (diskblock == 0) {
+		printf("    0x%6x  [sparse]\n", fileblock * SFS_BLOCKSIZE);
+		return;
+	}
+
+	diskread(data, diskblock);
+	dumpfiledata(fileblock, data, SFS_BLOCKSIZE);
+}
+
 static
 void
 dumpfile(uint32_t ino, const struct sfs_dinode *sfi)
 {
 	printf("File contents for inode %u:\n", ino);
+	if (isinline(sfi)) {
+		uint8_t data[SFS_BLOCKSIZE];
+		uint32_t size = SWAP32(sfi->sfi_size);
+
+		if (size > SFS_INLINESIZE) {
+			size = SFS_INLINESIZE;
+		}
+		bzero(data, sizeof(data));
+		memcpy(data, SFS_INLINEDATA(sfi), size);
+		dumpfiledata(0, data, SFS_ROUNDUP(size, 16));
+		return;
+	}
 	traverse(sfi, dumpfileblock);
 }
 
@@ -449,8 +527,16 @@ dumpinode(uint32_t ino, const char *name)
 	dumpvalf("Type", "%u (%s)", SWAP16(sfi.sfi_type), typename);
 	dumpvalf("Size", "%u", SWAP32(sfi.sfi_size));
 	dumpvalf("Link count", "%u", SWAP16(sfi.sfi_linkcount));
+	dumpvalf("Flags", "0x%x%s", SWAP32(sfi.sfi_flags),
+		 isinline(&sfi) ? " (inline)" : "");
 	printf("\n");
 
+	if (isinline(&sfi)) {
+		printf("    Inline data: %u of %u bytes\n",
+		       SWAP32(sfi.sfi_size), SFS_INLINESIZE);
+		goto contents;
+	}
+
         printf("    Direct blocks:\n");
         for (i=0; i<SFS_NDIRECT; i++) {
 		if (i % 4 == 0) {
@@ -487,6 +573,7 @@ dumpinode(uint32_t ino, const char *name)
 		dumpindirect(SWAP32(sfi.sfi_indirect));
 	}
 
+ contents:
 	if (SWAP16(sfi.sfi_type) == SFS_TYPE_DIR && dodirs) {
 		dumpdir(ino, &sfi);
 	}
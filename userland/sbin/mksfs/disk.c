@@ -186,6 +186,40 @@ diskread(void *data, uint32_t block)
 	}
 }
 
+#ifdef HOST
+/*
+ * Read a block without touching the file offset, so it can be called
+ * from several threads at once (and alongside diskread/diskwrite).
+ */
+void
+diskpread(void *data, uint32_t block)
+{
+	char *cdata = data;
+	uint32_t tot=0;
+	int len;
+
+	assert(fd>=0);
+
+	// skip over disk file header
+	block++;
+
+	while (tot < BLOCKSIZE) {
+		len = pread(fd, cdata + tot, BLOCKSIZE - tot,
+			    (off_t)block*BLOCKSIZE + tot);
+		if (len < 0) {
+			if (errno==EINTR || errno==EAGAIN) {
+				continue;
+			}
+			err(1, "pread");
+		}
+		if (len==0) {
+			err(1, "unexpected EOF in mid-sector");
+		}
+		tot += len;
+	}
+}
+#endif
+
 /*
  * Close the disk.
  */
@@ -34,5 +34,8 @@ uint32_t diskblocks(void);
 
 void diskwrite(const void *data, uint32_t block);
 void diskread(void *data, uint32_t block);
+#ifdef HOST
+void diskpread(void *data, uint32_t block);	/* thread-safe */
+#endif
 
 void closedisk(void);
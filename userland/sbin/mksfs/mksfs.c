@@ -60,6 +60,14 @@
 /* Maximum size of freemap we support */
 #define MAXFREEMAPBLOCKS 32
 
+/*
+ * Journal size: a header, a commit block, and a full (128-block)
+ * transaction with its two descriptor blocks. Volumes too small to
+ * spare this many blocks many times over don't get a journal.
+ */
+#define JOURNALBLOCKS 132
+#define MINJOURNALVOL (JOURNALBLOCKS * 8)
+
 /* Free block bitmap */
 static char freemapbuf[MAXFREEMAPBLOCKS * SFS_BLOCKSIZE];
 
@@ -94,7 +102,7 @@ allocblock(uint32_t block)
  */
 static
 void
-initfreemap(uint32_t fsblocks)
+initfreemap(uint32_t fsblocks, uint32_t jstart, uint32_t jblocks)
 {
 	uint32_t freemapbits = SFS_FREEMAPBITS(fsblocks);
 	uint32_t freemapblocks = SFS_FREEMAPBLOCKS(fsblocks);
@@ -114,6 +122,11 @@ initfreemap(uint32_t fsblocks)
 		allocblock(SFS_FREEMAP_START + i);
 	}
 
+	/* so must the journal */
+	for (i=0; i<jblocks; i++) {
+		allocblock(jstart + i);
+	}
+
 	/* all blocks in the freemap but past the volume end are "in use" */
 	for (i=fsblocks; i<freemapbits; i++) {
 		allocblock(i);
@@ -125,7 +138,8 @@ initfreemap(uint32_t fsblocks)
  */
 static
 void
-writesuper(const char *volname, uint32_t nblocks)
+writesuper(const char *volname, uint32_t nblocks,
+	   uint32_t jstart, uint32_t jblocks)
 {
 	struct sfs_superblock sb;
 
@@ -140,6 +154,8 @@ writesuper(const char *volname, uint32_t nblocks)
 	sb.sb_magic = SWAP32(SFS_MAGIC);
 	sb.sb_nblocks = SWAP32(nblocks);
 	strcpy(sb.sb_volname, volname);
+	sb.sb_journalstart = SWAP32(jstart);
+	sb.sb_journalblocks = SWAP32(jblocks);
 
 	/* and write it out. */
 	diskwrite(&sb, SFS_SUPER_BLOCK);
@@ -164,6 +180,25 @@ writefreemap(uint32_t fsblocks)
 	}
 }
 
+/*
+ * Write out an empty journal: just the header.
+ */
+static
+void
+writejournal(uint32_t jstart, uint32_t jblocks)
+{
+	struct sfs_jheader jh;
+
+	if (jblocks == 0) {
+		return;
+	}
+
+	bzero((void *)&jh, sizeof(jh));
+	jh.jh_magic = SWAP32(SFS_JMAGIC_HEADER);
+	jh.jh_seq = SWAP32(1);
+	diskwrite(&jh, jstart);
+}
+
 /*
  * Write out the root directory inode.
  */
@@ -178,6 +213,7 @@ writerootdir(void)
 	sfi.sfi_size = SWAP32(0);
 	sfi.sfi_type = SWAP16(SFS_TYPE_DIR);
 	sfi.sfi_linkcount = SWAP16(1);
+	sfi.sfi_flags = SWAP32(SFS_DINODE_INLINE);
 
 	/* Write it out */
 	diskwrite(&sfi, SFS_ROOTDIR_INO);
@@ -190,6 +226,7 @@ int
 main(int argc, char **argv)
 {
 	uint32_t size, blocksize;
+	uint32_t jstart, jblocks;
 	char *volname, *s;
 
 #ifdef HOST
@@ -228,10 +265,20 @@ main(int argc, char **argv)
 	}
 	size = diskblocks();
 
+	/* The journal goes right after the freemap. */
+	if (size >= MINJOURNALVOL) {
+		jstart = SFS_FREEMAP_START + SFS_FREEMAPBLOCKS(size);
+		jblocks = JOURNALBLOCKS;
+	}
+	else {
+		jstart = jblocks = 0;
+	}
+
 	/* Write out the on-disk structures */
-	initfreemap(size);
-	writesuper(volname, size);
+	initfreemap(size, jstart, jblocks);
+	writesuper(volname, size, jstart, jblocks);
 	writefreemap(size);
+	writejournal(jstart, jblocks);
 	writerootdir();
 
 	closedisk();
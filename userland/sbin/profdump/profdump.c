@@ -0,0 +1,350 @@
+/*
+ * profdump - symbolize a kernel profiler dump.
+ *
+ * Usage: profdump [-u program] kernel dumpfile
+ *
+ * Reads samples written by the kernel menu's "prof dump" command,
+ * looks the pcs up in the kernel's symbol table (and user pcs in
+ * PROGRAM's, if given), and prints a flat profile by function and a
+ * profile of call sites (caller -> function, from the sampled ra).
+ *
+ * Percentages are of clock ticks rather than samples: an idle cpu
+ * turns its clock off, and the kernel records the ticks it slept
+ * through as a single idle-span sample.
+ */
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#include <kern/profile.h>
+
+#include "dumpfile.h"
+
+/* The few ELF32 bits we need. */
+#define SHT_SYMTAB	2
+#define SHF_EXECINSTR	0x4
+#define SHN_UNDEF	0
+#define SHN_LORESERVE	0xff00
+#define STT_NOTYPE	0
+#define STT_FUNC	2
+
+struct symbol {
+	uint32_t addr;
+	const char *name;
+};
+
+struct symtab {
+	struct symbol *syms;
+	unsigned nsyms;
+};
+
+struct count {
+	const char *name;
+	const char *caller;		/* NULL in the flat profile */
+	unsigned samples;		/* really ticks; see above */
+};
+
+static struct symtab kernsyms, usersyms;
+
+static struct count *flat, *sites;
+static unsigned nflat, maxflat, nsites, maxsites;
+
+////////////////////////////////////////////////////////////
+// file and ELF handling
+
+static
+void *
+domalloc(size_t len)
+{
+	void *p;
+
+	p = malloc(len ? len : 1);
+	if (p == NULL) {
+		errx(1, "Out of memory");
+	}
+	return p;
+}
+
+/* ELF fields are big-endian; fetch them a byte at a time. */
+static
+uint32_t
+get32(const unsigned char *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+		((uint32_t)p[2] << 8) | p[3];
+}
+
+static
+uint16_t
+get16(const unsigned char *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static
+int
+symcompare(const void *av, const void *bv)
+{
+	const struct symbol *a = av;
+	const struct symbol *b = bv;
+
+	return a->addr < b->addr ? -1 : a->addr > b->addr ? 1 : 0;
+}
+
+/*
+ * Load the function symbols of an ELF file. Untyped symbols in code
+ * sections are taken too, to catch assembly-language entry points.
+ * The file's contents are kept, since the names point into them.
+ */
+static
+void
+loadsyms(const char *file, struct symtab *st)
+{
+	const unsigned char *elf, *sh, *sym, *symsh, *strsh;
+	uint32_t shoff, symoff, symsize, stroff, strsize, name;
+	unsigned shentsize, shnum, shndx, type, i;
+	size_t len;
+
+	elf = readfile(file, &len);
+	if (len < 52 || memcmp(elf, "\177ELF", 4) != 0 ||
+	    elf[4] != 1 /* 32-bit */ || elf[5] != 2 /* big-endian */) {
+		errx(1, "%s: Not a 32-bit big-endian ELF file", file);
+	}
+	shoff = get32(elf + 32);
+	shentsize = get16(elf + 46);
+	shnum = get16(elf + 48);
+	if (shentsize < 40 || shoff + (uint64_t)shnum * shentsize > len) {
+		errx(1, "%s: Bad section headers", file);
+	}
+
+	symsh = NULL;
+	for (i=0; i<shnum; i++) {
+		sh = elf + shoff + i * shentsize;
+		if (get32(sh + 4) == SHT_SYMTAB) {
+			symsh = sh;
+			break;
+		}
+	}
+	if (symsh == NULL || get32(symsh + 24) >= shnum) {
+		errx(1, "%s: No symbol table", file);
+	}
+	strsh = elf + shoff + get32(symsh + 24) * shentsize;
+	symoff = get32(symsh + 16);
+	symsize = get32(symsh + 20);
+	stroff = get32(strsh + 16);
+	strsize = get32(strsh + 20);
+	if ((uint64_t)symoff + symsize > len ||
+	    (uint64_t)stroff + strsize > len || strsize == 0 ||
+	    elf[stroff + strsize - 1] != 0) {
+		errx(1, "%s: Bad symbol table", file);
+	}
+
+	st->syms = domalloc((symsize / 16) * sizeof(st->syms[0]));
+	st->nsyms = 0;
+	for (i=0; i < symsize / 16; i++) {
+		sym = elf + symoff + i * 16;
+		name = get32(sym);
+		type = sym[12] & 0xf;
+		shndx = get16(sym + 14);
+		if (name == 0 || name >= strsize ||
+		    shndx == SHN_UNDEF || shndx >= SHN_LORESERVE ||
+		    shndx >= shnum) {
+			continue;
+		}
+		if (type != STT_FUNC &&
+		    !(type == STT_NOTYPE &&
+		      (get32(elf + shoff + shndx * shentsize + 8)
+		       & SHF_EXECINSTR))) {
+			continue;
+		}
+		st->syms[st->nsyms].addr = get32(sym + 4);
+		st->syms[st->nsyms].name = (const char *)elf + stroff + name;
+		st->nsyms++;
+	}
+	qsort(st->syms, st->nsyms, sizeof(st->syms[0]), symcompare);
+}
+
+/*
+ * Find the function containing ADDR: the last symbol at or below it.
+ */
+static
+const char *
+lookup(const struct symtab *st, uint32_t addr, const char *dflt)
+{
+	unsigned lo = 0, hi = st->nsyms, mid;
+
+	if (st->nsyms == 0 || addr < st->syms[0].addr) {
+		return dflt;
+	}
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (st->syms[mid].addr <= addr) {
+			lo = mid;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return st->syms[lo].name;
+}
+
+////////////////////////////////////////////////////////////
+// counting
+
+static
+void
+addcount(struct count **tab, unsigned *num, unsigned *max,
+	 const char *name, const char *caller, unsigned n)
+{
+	unsigned i;
+
+	/* names are unique pointers into the symbol tables */
+	for (i=0; i<*num; i++) {
+		if ((*tab)[i].name == name && (*tab)[i].caller == caller) {
+			(*tab)[i].samples += n;
+			return;
+		}
+	}
+	if (*num == *max) {
+		*max = *max ? *max * 2 : 256;
+		*tab = growbuf(*tab, *num * sizeof((*tab)[0]),
+			       *max * sizeof((*tab)[0]));
+	}
+	(*tab)[*num].name = name;
+	(*tab)[*num].caller = caller;
+	(*tab)[*num].samples = n;
+	(*num)++;
+}
+
+static
+int
+countcompare(const void *av, const void *bv)
+{
+	const struct count *a = av;
+	const struct count *b = bv;
+
+	if (a->samples != b->samples) {
+		return a->samples > b->samples ? -1 : 1;
+	}
+	return strcmp(a->name, b->name);
+}
+
+/* Print N as a percentage of TOTAL, without floating point. */
+static
+void
+printpercent(unsigned n, unsigned total)
+{
+	unsigned tenths = (unsigned)((uint64_t)n * 1000 / total);
+
+	printf("  %4u.%u", tenths / 10, tenths % 10);
+}
+
+static
+void
+profile(const char *file, bool haveuser)
+{
+	const struct prof_header *ph;
+	struct prof_sample *samples, *ps;
+	const struct symtab *st;
+	const char *name, *caller;
+	unsigned nsamples, nticks, idleticks, i, nidle = 0, nuser = 0;
+	size_t len;
+
+	ph = readdump(file, "profiler", PROF_MAGIC, PROF_VERSION,
+		      sizeof(*ph), &len);
+	nsamples = SWAP32(ph->ph_nsamples);
+	samples = dumprecords(file, (void *)ph, len, sizeof(*ph), nsamples,
+			      sizeof(*samples));
+
+	nticks = 0;
+	for (i=0; i<nsamples; i++) {
+		ps = &samples[i];
+		if (SWAP16(ps->ps_flags) & PROF_IDLE) {
+			idleticks = (SWAP16(ps->ps_flags) & PROF_IDLESPAN) ?
+				SWAP32(ps->ps_pc) : 1;
+			nidle += idleticks;
+			nticks += idleticks;
+			addcount(&flat, &nflat, &maxflat, "[idle]", NULL,
+				 idleticks);
+			continue;
+		}
+		nticks++;
+		if (SWAP16(ps->ps_flags) & PROF_USER) {
+			nuser++;
+			if (!haveuser) {
+				addcount(&flat, &nflat, &maxflat,
+					 "[user]", NULL, 1);
+				continue;
+			}
+			st = &usersyms;
+		}
+		else {
+			st = &kernsyms;
+		}
+		name = lookup(st, SWAP32(ps->ps_pc), "[unknown]");
+		caller = lookup(st, SWAP32(ps->ps_ra), "[unknown]");
+		addcount(&flat, &nflat, &maxflat, name, NULL, 1);
+		if (caller != name) {
+			addcount(&sites, &nsites, &maxsites, name, caller, 1);
+		}
+	}
+
+	printf("%u ticks at %u Hz on %u cpus (%u samples dropped): "
+	       "%u kernel, %u user, %u idle\n",
+	       nticks, SWAP32(ph->ph_hz), SWAP32(ph->ph_ncpus),
+	       SWAP32(ph->ph_dropped),
+	       nticks - nuser - nidle, nuser, nidle);
+	if (nticks == 0) {
+		return;
+	}
+
+	qsort(flat, nflat, sizeof(flat[0]), countcompare);
+	printf("\nFlat profile:\n");
+	printf("  %%time    ticks  function\n");
+	for (i=0; i<nflat; i++) {
+		printpercent(flat[i].samples, nticks);
+		printf(" %8u  %s\n", flat[i].samples, flat[i].name);
+	}
+
+	qsort(sites, nsites, sizeof(sites[0]), countcompare);
+	printf("\nCall sites (approximate):\n");
+	printf("  %%time    ticks  caller -> function\n");
+	for (i=0; i<nsites; i++) {
+		printpercent(sites[i].samples, nticks);
+		printf(" %8u  %s -> %s\n",
+		       sites[i].samples, sites[i].caller, sites[i].name);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *userprog = NULL;
+
+#ifdef HOST
+	hostcompat_init(argc, argv);
+#endif
+
+	if (argc == 5 && !strcmp(argv[1], "-u")) {
+		userprog = argv[2];
+		argv += 2;
+		argc -= 2;
+	}
+	if (argc != 3) {
+		errx(1, "Usage: profdump [-u program] kernel dumpfile");
+	}
+
+	loadsyms(argv[1], &kernsyms);
+	if (userprog != NULL) {
+		loadsyms(userprog, &usersyms);
+	}
+	profile(argv[2], userprog != NULL);
+	return 0;
+}
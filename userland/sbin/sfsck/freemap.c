@@ -42,6 +42,7 @@
 #include "sb.h"
 #include "freemap.h"
 #include "main.h"
+#include "readahead.h"
 
 static unsigned long blocksinuse = 0;
 static uint8_t *freemapdata;
@@ -78,6 +79,11 @@ freemap_setup(void)
 	for (i=0; i < mapblocks; i++) {
 		freemap_blockinuse(SFS_FREEMAP_START+i, B_FREEMAPBLOCK, i);
 	}
+
+	/* And the journal */
+	for (i=0; i < sb_journalblocks(); i++) {
+		freemap_blockinuse(sb_journalstart()+i, B_JOURNAL, i);
+	}
 }
 
 /*
@@ -95,6 +101,10 @@ blockusagestr(blockusage_t how, uint32_t howdesc)
 		snprintf(rv, sizeof(rv), "freemap block %lu",
 			 (unsigned long) howdesc);
 		break;
+	    case B_JOURNAL:
+		snprintf(rv, sizeof(rv), "journal block %lu",
+			 (unsigned long) howdesc);
+		break;
 	    case B_INODE:
 		snprintf(rv, sizeof(rv), "inode %lu",
 			 (unsigned long) howdesc);
@@ -232,6 +242,14 @@ freemap_check(void)
 	bitblocks = sb_freemapblocks();
 
 	for (i=0; i<bitblocks; i++) {
+		if (i % RA_BATCH == 0) {
+			uint32_t batch[RA_BATCH];
+
+			for (j=0; j<RA_BATCH && i+j<bitblocks; j++) {
+				batch[j] = SFS_FREEMAP_START + i + j;
+			}
+			ra_prefetch(batch, j);
+		}
 		sfs_readfreemapblock(i, actual);
 		expected = freemapdata + i*SFS_BLOCKSIZE;
 		tofree = tofreedata + i*SFS_BLOCKSIZE;
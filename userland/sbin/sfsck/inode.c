@@ -40,6 +40,7 @@
 #include "sfs.h"
 #include "freemap.h"
 #include "inode.h"
+#include "readahead.h"
 #include "main.h"
 
 /*
@@ -57,12 +58,82 @@ struct inodeinfo {
 static struct inodeinfo *inodes = NULL;
 static unsigned ninodes = 0, maxinodes = 0;
 
-/* Whether the table is sorted and can be looked up with binary search. */
-static int inodes_sorted = 0;
+/*
+ * Hash index into the table, by inode number, with linear probing.
+ * Entries are table index + 1; 0 means empty. The size is a power of
+ * two and is kept at least twice the number of inodes.
+ */
+static unsigned *inodehash = NULL;
+static unsigned inodehashsize = 0;
 
 ////////////////////////////////////////////////////////////
 // inode table ops
 
+static
+unsigned
+inode_hashslot(uint32_t ino)
+{
+	/* Fibonacci hashing; inode numbers are dense and clustered */
+	return (ino * 2654435761U) & (inodehashsize - 1);
+}
+
+/*
+ * Enter table slot INDEX in the hash.
+ */
+static
+void
+inode_hashinsert(unsigned index)
+{
+	unsigned h;
+
+	h = inode_hashslot(inodes[index].ino);
+	while (inodehash[h] != 0) {
+		h = (h + 1) & (inodehashsize - 1);
+	}
+	inodehash[h] = index + 1;
+}
+
+/*
+ * (Re)build the hash from the table, with NEWSIZE buckets.
+ */
+static
+void
+inode_rehash(unsigned newsize)
+{
+	unsigned i;
+
+	free(inodehash);
+	inodehash = domalloc(newsize * sizeof(inodehash[0]));
+	memset(inodehash, 0, newsize * sizeof(inodehash[0]));
+	inodehashsize = newsize;
+
+	for (i=0; i<ninodes; i++) {
+		inode_hashinsert(i);
+	}
+}
+
+/*
+ * Look up an inode in the hash. Returns NULL if it isn't there.
+ */
+static
+struct inodeinfo *
+inode_lookup(uint32_t ino)
+{
+	unsigned h;
+
+	if (inodehashsize == 0) {
+		return NULL;
+	}
+	h = inode_hashslot(ino);
+	while (inodehash[h] != 0) {
+		if (inodes[inodehash[h] - 1].ino == ino) {
+			return &inodes[inodehash[h] - 1];
+		}
+		h = (h + 1) & (inodehashsize - 1);
+	}
+	return NULL;
+}
+
 /*
  * Add an entry to the inode table, realloc'ing it if needed.
  */
@@ -84,7 +155,13 @@ inode_addtable(uint32_t ino, int type)
 	inodes[ninodes].visited = 0;
 	inodes[ninodes].type = type;
 	ninodes++;
-	inodes_sorted = 0;
+
+	if (ninodes * 2 > inodehashsize) {
+		inode_rehash(inodehashsize ? inodehashsize * 2 : 64);
+	}
+	else {
+		inode_hashinsert(ninodes - 1);
+	}
 }
 
 /*
@@ -114,17 +191,19 @@ inode_compare(const void *av, const void *bv)
 }
 
 /*
- * After pass1, we sort the inode table for faster access.
+ * Sort the table by inode number, which is also disk order. This
+ * moves entries around, so the hash has to be rebuilt.
  */
+static
 void
 inode_sorttable(void)
 {
 	qsort(inodes, ninodes, sizeof(inodes[0]), inode_compare);
-	inodes_sorted = 1;
+	inode_rehash(inodehashsize);
 }
 
 /*
- * Find an inode by binary search.
+ * Find an inode.
  *
  * This will error out if asked for an inode not in the table; that's
  * not supposed to happen. (This might need to change; if we improve
@@ -136,31 +215,13 @@ static
 struct inodeinfo *
 inode_find(uint32_t ino)
 {
-	unsigned min, max, i;
-
-	assert(inodes_sorted);
-	assert(ninodes > 0);
+	struct inodeinfo *inf;
 
-	min = 0;
-	max = ninodes;
-	while (1) {
-		assert(min <= max);
-		if (min == max) {
-			errx(EXIT_UNRECOV, "FATAL: inode %u wasn't found in my inode table", ino);
-		}
-		i = min + (max - min)/2;
-		if (inodes[i].ino < ino) {
-			min = i + 1;
-		}
-		else if (inodes[i].ino > ino) {
-			max = i;
-		}
-		else {
-			assert(inodes[i].ino == ino);
-			return &inodes[i];
-		}
+	inf = inode_lookup(ino);
+	if (inf == NULL) {
+		errx(EXIT_UNRECOV, "FATAL: inode %u wasn't found in my inode table", ino);
 	}
-	/* NOTREACHED */
+	return inf;
 }
 
 ////////////////////////////////////////////////////////////
@@ -168,22 +229,17 @@ inode_find(uint32_t ino)
 
 /*
  * Add an inode; returns 1 if we've already seen it.
- *
- * Uses linear search because we only sort the table for faster access
- * after all inodes have been added. In the FUTURE this could be
- * changed to a better data structure.
  */
 int
 inode_add(uint32_t ino, int type)
 {
-	unsigned i;
+	struct inodeinfo *inf;
 
-	for (i=0; i<ninodes; i++) {
-		if (inodes[i].ino==ino) {
-			assert(inodes[i].linkcount == 0);
-			assert(inodes[i].type == type);
-			return 1;
-		}
+	inf = inode_lookup(ino);
+	if (inf != NULL) {
+		assert(inf->linkcount == 0);
+		assert(inf->type == type);
+		return 1;
 	}
 
 	inode_addtable(ino, type);
@@ -237,9 +293,23 @@ void
 inode_adjust_filelinks(void)
 {
 	struct sfs_dinode sfi;
-	unsigned i;
+	uint32_t batch[RA_BATCH];
+	unsigned i, j, nbatch;
+
+	/* go in disk order, and read ahead of ourselves */
+	inode_sorttable();
 
 	for (i=0; i<ninodes; i++) {
+		if (i % RA_BATCH == 0) {
+			nbatch = 0;
+			for (j=i; j<ninodes && j<i+RA_BATCH; j++) {
+				if (inodes[j].type == SFS_TYPE_FILE) {
+					batch[nbatch++] = inodes[j].ino;
+				}
+			}
+			ra_prefetch(batch, nbatch);
+		}
+
 		if (inodes[i].type == SFS_TYPE_DIR) {
 			/* directory */
 			continue;
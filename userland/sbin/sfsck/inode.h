@@ -39,20 +39,14 @@
 /* Add an inode. Returns 1 if we've seen this inode before. */
 int inode_add(uint32_t ino, int type);
 
-/* Sort the inode table for faster lookup once all inode_add() done. */
-void inode_sorttable(void);
-
 /*
  * Remember that we've seen a particular directory. Returns nonzero if
  * we've seen this directory before, which means the directory is
- * crosslinked. Requires inode_sorttable() first.
+ * crosslinked.
  */
 int inode_visitdir(uint32_t ino);
 
-/*
- * Count a link to a regular file. (Not called for directories.)
- * Requires inode_sorttable() first.
- */
+/* Count a link to a regular file. (Not called for directories.) */
 void inode_addlink(uint32_t ino);
 
 /*
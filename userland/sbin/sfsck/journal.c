@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include "compat.h"
+#include <kern/sfs.h>
+
+#include "utils.h"
+#include "sfs.h"
+#include "sb.h"
+#include "journal.h"
+#include "main.h"
+
+/* must match sfs_jcksum in the kernel */
+static
+uint32_t
+journal_cksum(uint32_t h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		h ^= p[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+void
+journal_replay(void)
+{
+	struct sfs_jheader jh;
+	struct sfs_jdesc jd;
+	struct sfs_jcommit jc;
+	uint32_t start, end, pos, seq, cksum;
+	uint32_t *tags, *where;
+	unsigned ntags, i, n;
+
+	if (sb_journalblocks() == 0) {
+		return;
+	}
+	start = sb_journalstart();
+	end = start + sb_journalblocks();
+
+	sfs_readrawblock(start, &jh);
+	if (SWAP32(jh.jh_magic) != SFS_JMAGIC_HEADER) {
+		/* the kernel will write a fresh header at mount */
+		warnx("Journal header invalid (ignored)");
+		setbadness(EXIT_RECOV);
+		return;
+	}
+	seq = SWAP32(jh.jh_seq);
+
+	/*
+	 * Walk the log, remembering where each logged block lives in
+	 * the journal and where it goes. Stop at anything that isn't
+	 * part of a complete transaction with this sequence number.
+	 */
+	tags = domalloc(sb_journalblocks() * sizeof(tags[0]));
+	where = domalloc(sb_journalblocks() * sizeof(where[0]));
+	ntags = 0;
+	cksum = 2166136261U;
+	pos = start + 1;
+	while (1) {
+		if (pos >= end) {
+			goto done;
+		}
+		sfs_readrawblock(pos++, &jd);
+		if (SWAP32(jd.jd_seq) != seq) {
+			goto done;
+		}
+		if (SWAP32(jd.jd_magic) == SFS_JMAGIC_COMMIT) {
+			break;
+		}
+		n = SWAP32(jd.jd_ntags);
+		if (SWAP32(jd.jd_magic) != SFS_JMAGIC_DESC || n == 0 ||
+		    n > SFS_JTAGS || pos + n >= end) {
+			goto done;
+		}
+		cksum = journal_cksum(cksum, &jd, sizeof(jd));
+		for (i=0; i<n; i++) {
+			char buf[SFS_BLOCKSIZE];
+
+			tags[ntags] = SWAP32(jd.jd_tags[i]);
+			if (tags[ntags] >= sb_totalblocks()) {
+				goto done;
+			}
+			where[ntags++] = pos;
+			sfs_readrawblock(pos++, buf);
+			cksum = journal_cksum(cksum, buf, sizeof(buf));
+		}
+	}
+
+	memcpy(&jc, &jd, sizeof(jc));
+	if (ntags == 0 || SWAP32(jc.jc_nblocks) != ntags ||
+	    SWAP32(jc.jc_cksum) != cksum) {
+		goto done;
+	}
+
+	warnx("Journal has %u uncheckpointed blocks (replayed)", ntags);
+	setbadness(EXIT_RECOV);
+	for (i=0; i<ntags; i++) {
+		char buf[SFS_BLOCKSIZE];
+
+		sfs_readrawblock(where[i], buf);
+		sfs_writerawblock(tags[i], buf);
+	}
+
+	/* retire it so the kernel doesn't replay it again */
+	memset(&jh, 0, sizeof(jh));
+	jh.jh_magic = SWAP32(SFS_JMAGIC_HEADER);
+	jh.jh_seq = SWAP32(seq + 1);
+	sfs_writerawblock(start, &jh);
+
+ done:
+	free(tags);
+	free(where);
+}
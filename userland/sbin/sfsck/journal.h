@@ -0,0 +1,12 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/*
+ * If the volume has a journal holding a committed transaction that
+ * the kernel didn't get to checkpoint, copy its blocks home and
+ * retire it, the same as mounting would. Call after sb_check and
+ * before anything else looks at the volume.
+ */
+void journal_replay(void);
+
+#endif /* JOURNAL_H */
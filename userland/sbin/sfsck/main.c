@@ -39,8 +39,10 @@
 #include "sb.h"
 #include "freemap.h"
 #include "inode.h"
+#include "journal.h"
 #include "passes.h"
 #include "main.h"
+#include "readahead.h"
 
 static int badness=0;
 
@@ -74,10 +76,12 @@ main(int argc, char **argv)
 	}
 
 	opendisk(argv[1]);
+	ra_init();
 
 	sfs_setup();
 	sb_load();
 	sb_check();
+	journal_replay();
 	freemap_setup();
 
 	printf("Phase 1 -- check blocks and sizes\n");
@@ -85,12 +89,12 @@ main(int argc, char **argv)
 	freemap_check();
 
 	printf("Phase 2 -- check directory tree\n");
-	inode_sorttable();
 	pass2();
 
 	printf("Phase 3 -- check reference counts\n");
 	inode_adjust_filelinks();
 
+	ra_shutdown();
 	closedisk();
 
 	warnx("%lu blocks used (of %lu); %lu directories; %lu files",
@@ -46,6 +46,7 @@
 #include "inode.h"
 #include "passes.h"
 #include "main.h"
+#include "readahead.h"
 
 static unsigned long count_dirs=0, count_files=0;
 
@@ -112,6 +113,7 @@ check_indirect_block(struct ibstate *ibs, uint32_t *ientry, int *iechangedp,
 	}
 
 	if (indirection > 1) {
+		ra_prefetch(entries, SFS_DBPERIDB);
 		for (i=0; i<SFS_DBPERIDB; i++) {
 			check_indirect_block(ibs, &entries[i], &localchanged,
 					     indirection-1);
@@ -247,6 +249,43 @@ check_inode_blocks(uint32_t ino, struct sfs_dinode *sfi, int isdir)
 	return changed;
 }
 
+/*
+ * Check an inline inode: there are no blocks, so all we can do is make
+ * sure the size fits and the unused space is zero. Directories also
+ * need to stay a whole number of entries.
+ *
+ * Returns nonzero if SFI has been modified and needs to be written
+ * back.
+ */
+static
+int
+check_inode_inline(uint32_t ino, struct sfs_dinode *sfi, int isdir)
+{
+	char *data = SFS_INLINEDATA(sfi);
+	uint32_t max;
+	int changed = 0;
+
+	max = SFS_INLINESIZE;
+	if (isdir) {
+		max -= max % sizeof(struct sfs_direntry);
+	}
+	if (sfi->sfi_size > max) {
+		warnx("Inode %lu: inline size %lu too large (truncated)",
+		      (unsigned long) ino, (unsigned long) sfi->sfi_size);
+		setbadness(EXIT_RECOV);
+		sfi->sfi_size = max;
+		changed = 1;
+	}
+	if (checkzeroed(data + sfi->sfi_size,
+			SFS_INLINESIZE - sfi->sfi_size)) {
+		warnx("Inode %lu: inline data past EOF not zeroed (fixed)",
+		      (unsigned long) ino);
+		setbadness(EXIT_RECOV);
+		changed = 1;
+	}
+	return changed;
+}
+
 /*
  * Do the pass1 inode-level checks on inode INO, which has already
  * been loaded into SFI. Note that sfi_type has already been
@@ -270,6 +309,22 @@ pass1_inode(uint32_t ino, struct sfs_dinode *sfi, int alreadychanged)
 
 	freemap_blockinuse(ino, B_INODE, ino);
 
+	if (sfi->sfi_flags & ~SFS_DINODE_INLINE) {
+		warnx("Inode %lu: unknown flags 0x%lx (cleared)",
+		      (unsigned long) ino,
+		      (unsigned long) sfi->sfi_flags & ~SFS_DINODE_INLINE);
+		setbadness(EXIT_RECOV);
+		sfi->sfi_flags &= SFS_DINODE_INLINE;
+		changed = 1;
+	}
+
+	if (sfi->sfi_flags & SFS_DINODE_INLINE) {
+		if (check_inode_inline(ino, sfi, isdir)) {
+			changed = 1;
+		}
+		goto done;
+	}
+
 	if (checkzeroed(sfi->sfi_waste, sizeof(sfi->sfi_waste))) {
 		warnx("Inode %lu: sfi_waste section not zeroed (fixed)",
 		      (unsigned long) ino);
@@ -281,6 +336,7 @@ pass1_inode(uint32_t ino, struct sfs_dinode *sfi, int alreadychanged)
 		changed = 1;
 	}
 
+ done:
 	if (changed) {
 		sfs_writeinode(ino, sfi);
 	}
@@ -392,6 +448,8 @@ pass1_dir(uint32_t ino, const char *pathsofar)
 		}
 	}
 
+	sfsdir_prefetch(direntries, ndirentries);
+
 	for (i=0; i<ndirentries; i++) {
 		if (direntries[i].sfd_ino == SFS_NOINO) {
 			/* nothing */
@@ -436,7 +494,7 @@ pass1_dir(uint32_t ino, const char *pathsofar)
 	}
 
 	if (dchanged) {
-		sfs_writedir(&sfi, direntries, ndirentries);
+		sfs_writedir(ino, &sfi, direntries, ndirentries);
 	}
 
 	free(direntries);
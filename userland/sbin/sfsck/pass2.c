@@ -78,13 +78,18 @@ pass2_dir(uint32_t ino, uint32_t parentino, const char *pathsofar)
 
 	/*
 	 * Load the directory. If there is any leftover room in the
-	 * last block, allocate space for it in case we want to insert
-	 * entries.
+	 * last block (or the inode, if inline), allocate space for it
+	 * in case we want to insert entries.
 	 */
 
 	ndirentries = sfi.sfi_size/sizeof(struct sfs_direntry);
-	maxdirentries = SFS_ROUNDUP(ndirentries,
-				    SFS_BLOCKSIZE/sizeof(struct sfs_direntry));
+	if (sfi.sfi_flags & SFS_DINODE_INLINE) {
+		maxdirentries = SFS_INLINESIZE/sizeof(struct sfs_direntry);
+	}
+	else {
+		maxdirentries = SFS_ROUNDUP(ndirentries,
+				SFS_BLOCKSIZE/sizeof(struct sfs_direntry));
+	}
 	dirsize = maxdirentries * sizeof(struct sfs_direntry);
 	direntries = domalloc(dirsize);
 
@@ -233,6 +238,8 @@ pass2_dir(uint32_t ino, uint32_t parentino, const char *pathsofar)
 	 * so we can correct our own link count if necessary.
 	 */
 
+	sfsdir_prefetch(direntries, ndirentries);
+
 	subdircount=0;
 	for (i=0; i<ndirentries; i++) {
 		if (direntries[i].sfd_ino == SFS_NOINO) {
@@ -302,7 +309,7 @@ pass2_dir(uint32_t ino, uint32_t parentino, const char *pathsofar)
 	 */
 
 	if (dchanged) {
-		sfs_writedir(&sfi, direntries, ndirentries);
+		sfs_writedir(ino, &sfi, direntries, ndirentries);
 	}
 
 	if (ichanged) {
@@ -0,0 +1,290 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <err.h>
+
+#include "compat.h"
+#include <kern/sfs.h>
+
+#include "disk.h"
+#include "utils.h"
+#include "readahead.h"
+#include "main.h"
+
+#ifdef HOST
+
+#include <pthread.h>
+
+/*
+ * The cache is direct-mapped by block number. A slot is QUEUED while
+ * its block waits for a reader thread, LOADING while one is reading
+ * it, and READY once the data is there. Blocks are taken out of the
+ * cache when read (in a check they're almost never wanted twice), and
+ * a QUEUED block that gets asked for before a thread reaches it is
+ * simply read by the caller instead.
+ *
+ * The queue can hold stale entries (for slots that have since been
+ * taken over or emptied); the reader threads skip those.
+ */
+
+#define RA_NSLOTS	4096		/* 2M of 512-byte blocks */
+#define RA_QSIZE	(RA_NSLOTS * 2)
+#define RA_NTHREADS	4
+
+#define RA_EMPTY	0
+#define RA_QUEUED	1
+#define RA_LOADING	2
+#define RA_READY	3
+
+struct raslot {
+	uint32_t block;
+	int state;
+	char data[SFS_BLOCKSIZE];
+};
+
+static struct raslot *raslots;
+static uint32_t raqueue[RA_QSIZE];
+static unsigned raqhead, raqlen;
+
+static pthread_mutex_t ralock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rawork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t radone = PTHREAD_COND_INITIALIZER;
+static pthread_t rathreads[RA_NTHREADS];
+static int rarunning, rastopping;
+
+static
+struct raslot *
+ra_slot(uint32_t block)
+{
+	return &raslots[block % RA_NSLOTS];
+}
+
+/*
+ * Reader thread.
+ */
+static
+void *
+ra_thread(void *arg)
+{
+	struct raslot *rs;
+	uint32_t block;
+
+	(void)arg;
+
+	pthread_mutex_lock(&ralock);
+	while (1) {
+		while (raqlen == 0 && !rastopping) {
+			pthread_cond_wait(&rawork, &ralock);
+		}
+		if (rastopping) {
+			break;
+		}
+		block = raqueue[raqhead];
+		raqhead = (raqhead + 1) % RA_QSIZE;
+		raqlen--;
+
+		rs = ra_slot(block);
+		if (rs->block != block || rs->state != RA_QUEUED) {
+			/* stale */
+			continue;
+		}
+
+		/* nobody else touches a LOADING slot's data */
+		rs->state = RA_LOADING;
+		pthread_mutex_unlock(&ralock);
+		diskpread(rs->data, block);
+		pthread_mutex_lock(&ralock);
+		rs->state = RA_READY;
+		pthread_cond_broadcast(&radone);
+	}
+	pthread_mutex_unlock(&ralock);
+	return NULL;
+}
+
+void
+ra_init(void)
+{
+	unsigned i;
+	int result;
+
+	assert(!rarunning);
+	raslots = domalloc(RA_NSLOTS * sizeof(raslots[0]));
+	for (i=0; i<RA_NSLOTS; i++) {
+		raslots[i].block = 0;
+		raslots[i].state = RA_EMPTY;
+	}
+	raqhead = raqlen = 0;
+	rastopping = 0;
+
+	for (i=0; i<RA_NTHREADS; i++) {
+		result = pthread_create(&rathreads[i], NULL, ra_thread, NULL);
+		if (result) {
+			errx(EXIT_FATAL, "pthread_create: %s", strerror(result));
+		}
+	}
+	rarunning = 1;
+}
+
+void
+ra_shutdown(void)
+{
+	unsigned i;
+
+	if (!rarunning) {
+		return;
+	}
+
+	pthread_mutex_lock(&ralock);
+	rastopping = 1;
+	pthread_cond_broadcast(&rawork);
+	pthread_mutex_unlock(&ralock);
+
+	for (i=0; i<RA_NTHREADS; i++) {
+		pthread_join(rathreads[i], NULL);
+	}
+	free(raslots);
+	raslots = NULL;
+	rarunning = 0;
+}
+
+static
+int
+ra_blockcompare(const void *av, const void *bv)
+{
+	uint32_t a = *(const uint32_t *)av;
+	uint32_t b = *(const uint32_t *)bv;
+
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+/*
+ * Queue blocks, sorted so the reader threads sweep the disk in one
+ * direction. Blocks that would evict a slot somebody is still waiting
+ * on (QUEUED or LOADING) are dropped; a READY slot nobody has asked
+ * for yet is fair game.
+ */
+void
+ra_prefetch(const uint32_t *blocks, unsigned nblocks)
+{
+	uint32_t *sorted;
+	struct raslot *rs;
+	unsigned i;
+	int queued = 0;
+
+	if (!rarunning || nblocks == 0) {
+		return;
+	}
+	if (nblocks > RA_NSLOTS / 2) {
+		nblocks = RA_NSLOTS / 2;
+	}
+
+	sorted = domalloc(nblocks * sizeof(sorted[0]));
+	memcpy(sorted, blocks, nblocks * sizeof(sorted[0]));
+	qsort(sorted, nblocks, sizeof(sorted[0]), ra_blockcompare);
+
+	pthread_mutex_lock(&ralock);
+	for (i=0; i<nblocks && raqlen < RA_QSIZE; i++) {
+		if (sorted[i] == 0 || sorted[i] >= diskblocks()) {
+			/* hole or garbage; let the checks complain */
+			continue;
+		}
+		rs = ra_slot(sorted[i]);
+		if (rs->state == RA_QUEUED || rs->state == RA_LOADING) {
+			continue;
+		}
+		if (rs->state == RA_READY && rs->block == sorted[i]) {
+			continue;
+		}
+		rs->block = sorted[i];
+		rs->state = RA_QUEUED;
+		raqueue[(raqhead + raqlen) % RA_QSIZE] = sorted[i];
+		raqlen++;
+		queued = 1;
+	}
+	if (queued) {
+		pthread_cond_broadcast(&rawork);
+	}
+	pthread_mutex_unlock(&ralock);
+
+	free(sorted);
+}
+
+/*
+ * Look up BLOCK. If DATA is not NULL, hand back the data if we have it.
+ * Either way, the block is no longer in the cache afterwards.
+ */
+static
+int
+ra_take(uint32_t block, void *data)
+{
+	struct raslot *rs;
+	int found = 0;
+
+	if (!rarunning) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&ralock);
+	rs = ra_slot(block);
+	while (rs->block == block && rs->state == RA_LOADING) {
+		pthread_cond_wait(&radone, &ralock);
+	}
+	if (rs->block == block && rs->state != RA_EMPTY) {
+		if (rs->state == RA_READY && data != NULL) {
+			memcpy(data, rs->data, SFS_BLOCKSIZE);
+			found = 1;
+		}
+		rs->state = RA_EMPTY;
+	}
+	pthread_mutex_unlock(&ralock);
+
+	return found;
+}
+
+int
+ra_get(uint32_t block, void *data)
+{
+	return ra_take(block, data);
+}
+
+void
+ra_forget(uint32_t block)
+{
+	ra_take(block, NULL);
+}
+
+#else /* not HOST */
+
+void
+ra_init(void)
+{
+}
+
+void
+ra_shutdown(void)
+{
+}
+
+void
+ra_prefetch(const uint32_t *blocks, unsigned nblocks)
+{
+	(void)blocks;
+	(void)nblocks;
+}
+
+int
+ra_get(uint32_t block, void *data)
+{
+	(void)block;
+	(void)data;
+	return 0;
+}
+
+void
+ra_forget(uint32_t block)
+{
+	(void)block;
+}
+
+#endif /* HOST */
@@ -0,0 +1,34 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+/*
+ * Block readahead. Callers that know which blocks they are about to
+ * read hand them to ra_prefetch; on the host a pool of reader threads
+ * fetches them, in disk order, into a small cache that sfs.c checks
+ * before going to the disk. On OS/161 there are no threads, and all
+ * of this does nothing.
+ *
+ * Only the I/O is parallel. The checks themselves still run in one
+ * thread in the same order as always, so the output is deterministic
+ * and the repairs don't race with each other.
+ */
+
+#include <stdint.h>
+
+/* Suggested maximum number of blocks to pass to ra_prefetch at once. */
+#define RA_BATCH 1024
+
+/* Start and stop the reader threads; call after opendisk/before closedisk */
+void ra_init(void);
+void ra_shutdown(void);
+
+/* Queue blocks to be read. The array is not kept. */
+void ra_prefetch(const uint32_t *blocks, unsigned nblocks);
+
+/* If BLOCK has been read ahead, copy it to DATA and return 1. */
+int ra_get(uint32_t block, void *data);
+
+/* Discard any read-ahead copy of BLOCK (because it's being written). */
+void ra_forget(uint32_t block);
+
+#endif /* READAHEAD_H */
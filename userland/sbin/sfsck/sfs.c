@@ -41,6 +41,7 @@
 #include "ibmacros.h"
 #include "sfs.h"
 #include "main.h"
+#include "readahead.h"
 
 ////////////////////////////////////////////////////////////
 // global setup
@@ -62,6 +63,8 @@ swapsb(struct sfs_superblock *sb)
 {
 	sb->sb_magic = SWAP32(sb->sb_magic);
 	sb->sb_nblocks = SWAP32(sb->sb_nblocks);
+	sb->sb_journalstart = SWAP32(sb->sb_journalstart);
+	sb->sb_journalblocks = SWAP32(sb->sb_journalblocks);
 }
 
 static
@@ -72,16 +75,32 @@ swapbits(uint8_t *bits)
 	(void)bits;
 }
 
+/*
+ * Inline data isn't swapped, so we need to know which way we're
+ * going in order to look at the flags: TODISK says SFI is currently
+ * in host order.
+ */
 static
 void
-swapinode(struct sfs_dinode *sfi)
+swapinode(struct sfs_dinode *sfi, int todisk)
 {
-	int i;
+	int i, isinline;
 
 	sfi->sfi_size = SWAP32(sfi->sfi_size);
 	sfi->sfi_type = SWAP16(sfi->sfi_type);
 	sfi->sfi_linkcount = SWAP16(sfi->sfi_linkcount);
 
+	if (todisk) {
+		isinline = sfi->sfi_flags & SFS_DINODE_INLINE;
+	}
+	sfi->sfi_flags = SWAP32(sfi->sfi_flags);
+	if (!todisk) {
+		isinline = sfi->sfi_flags & SFS_DINODE_INLINE;
+	}
+	if (isinline) {
+		return;
+	}
+
 	for (i=0; i<NUM_D; i++) {
 		SET_D(sfi, i) = SWAP32(GET_D(sfi, i));
 	}
@@ -116,6 +135,31 @@ swapindir(uint32_t *entries)
 	}
 }
 
+////////////////////////////////////////////////////////////
+// block I/O
+
+/*
+ * All reads go through the readahead cache first, and all writes
+ * drop the block from it so we never see stale data.
+ */
+
+static
+void
+sfs_diskread(void *data, uint32_t block)
+{
+	if (!ra_get(block, data)) {
+		diskread(data, block);
+	}
+}
+
+static
+void
+sfs_diskwrite(const void *data, uint32_t block)
+{
+	ra_forget(block);
+	diskwrite(data, block);
+}
+
 ////////////////////////////////////////////////////////////
 // bmap()
 
@@ -138,7 +182,7 @@ ibmap(uint32_t iblock, uint32_t offset, uint32_t entrysize)
 		return 0;
 	}
 
-	diskread(entries, iblock);
+	sfs_diskread(entries, iblock);
 	swapindir(entries);
 
 	if (entrysize > 1) {
@@ -194,7 +238,7 @@ bmap(const struct sfs_dinode *sfi, uint32_t fileblock)
 void
 sfs_readsb(uint32_t blocknum, struct sfs_superblock *sb)
 {
-	diskread(sb, blocknum);
+	sfs_diskread(sb, blocknum);
 	swapsb(sb);
 }
 
@@ -202,7 +246,7 @@ void
 sfs_writesb(uint32_t blocknum, struct sfs_superblock *sb)
 {
 	swapsb(sb);
-	diskwrite(sb, blocknum);
+	sfs_diskwrite(sb, blocknum);
 	swapsb(sb);
 }
 
@@ -214,7 +258,7 @@ sfs_writesb(uint32_t blocknum, struct sfs_superblock *sb)
 void
 sfs_readfreemapblock(uint32_t whichblock, uint8_t *bits)
 {
-	diskread(bits, SFS_FREEMAP_START + whichblock);
+	sfs_diskread(bits, SFS_FREEMAP_START + whichblock);
 	swapbits(bits);
 }
 
@@ -222,10 +266,26 @@ void
 sfs_writefreemapblock(uint32_t whichblock, uint8_t *bits)
 {
 	swapbits(bits);
-	diskwrite(bits, SFS_FREEMAP_START + whichblock);
+	sfs_diskwrite(bits, SFS_FREEMAP_START + whichblock);
 	swapbits(bits);
 }
 
+/*
+ * raw blocks (no byte-swapping) - blocknum is a disk block number.
+ */
+
+void
+sfs_readrawblock(uint32_t blocknum, void *data)
+{
+	sfs_diskread(data, blocknum);
+}
+
+void
+sfs_writerawblock(uint32_t blocknum, void *data)
+{
+	sfs_diskwrite(data, blocknum);
+}
+
 /*
  *  inodes - ino is an inode number, which is a disk block number.
  */
@@ -233,16 +293,16 @@ sfs_writefreemapblock(uint32_t whichblock, uint8_t *bits)
 void
 sfs_readinode(uint32_t ino, struct sfs_dinode *sfi)
 {
-	diskread(sfi, ino);
-	swapinode(sfi);
+	sfs_diskread(sfi, ino);
+	swapinode(sfi, 0);
 }
 
 void
 sfs_writeinode(uint32_t ino, struct sfs_dinode *sfi)
 {
-	swapinode(sfi);
-	diskwrite(sfi, ino);
-	swapinode(sfi);
+	swapinode(sfi, 1);
+	sfs_diskwrite(sfi, ino);
+	swapinode(sfi, 0);
 }
 
 /*
@@ -252,7 +312,7 @@ sfs_writeinode(uint32_t ino, struct sfs_dinode *sfi)
 void
 sfs_readindirect(uint32_t blocknum, uint32_t *entries)
 {
-	diskread(entries, blocknum);
+	sfs_diskread(entries, blocknum);
 	swapindir(entries);
 }
 
@@ -260,7 +320,7 @@ void
 sfs_writeindirect(uint32_t blocknum, uint32_t *entries)
 {
 	swapindir(entries);
-	diskwrite(entries, blocknum);
+	sfs_diskwrite(entries, blocknum);
 	swapindir(entries);
 }
 
@@ -278,7 +338,7 @@ sfs_readdirblock(struct sfs_direntry *d, uint32_t diskblock)
 	unsigned j;
 
 	if (diskblock != 0) {
-		diskread(d, diskblock);
+		sfs_diskread(d, diskblock);
 		for (j=0; j<atonce; j++) {
 			swapdir(&d[j]);
 		}
@@ -302,11 +362,31 @@ sfs_readdir(struct sfs_dinode *sfi, struct sfs_direntry *d, unsigned nd)
 	unsigned i, j;
 	unsigned left, thismany;
 	struct sfs_direntry buffer[atonce];
-	uint32_t diskblock;
+	uint32_t *diskblocks, diskblock;
+
+	if (sfi->sfi_flags & SFS_DINODE_INLINE) {
+		assert(nd * sizeof(*d) <= SFS_INLINESIZE);
+		memcpy(d, SFS_INLINEDATA(sfi), nd * sizeof(*d));
+		for (i=0; i<nd; i++) {
+			swapdir(&d[i]);
+		}
+		return;
+	}
+
+	if (nblocks == 0) {
+		return;
+	}
+
+	/* map the whole directory first so we can read ahead */
+	diskblocks = domalloc(nblocks * sizeof(diskblocks[0]));
+	for (i=0; i<nblocks; i++) {
+		diskblocks[i] = bmap(sfi, i);
+	}
+	ra_prefetch(diskblocks, nblocks);
 
 	left = nd;
 	for (i=0; i<nblocks; i++) {
-		diskblock = bmap(sfi, i);
+		diskblock = diskblocks[i];
 		if (left < atonce) {
 			thismany = left;
 			sfs_readdirblock(buffer, diskblock);
@@ -321,6 +401,7 @@ sfs_readdir(struct sfs_dinode *sfi, struct sfs_direntry *d, unsigned nd)
 		left -= thismany;
 	}
 	assert(left == 0);
+	free(diskblocks);
 }
 
 /*
@@ -337,7 +418,7 @@ sfs_writedirblock(struct sfs_direntry *d, uint32_t diskblock)
 		for (j=0; j<atonce; j++) {
 			swapdir(&d[j]);
 		}
-		diskwrite(d, diskblock);
+		sfs_diskwrite(d, diskblock);
 	}
 	else {
 		for (j=bad=0; j<atonce; j++) {
@@ -360,7 +441,8 @@ sfs_writedirblock(struct sfs_direntry *d, uint32_t diskblock)
  * size accordingly.
  */
 void
-sfs_writedir(const struct sfs_dinode *sfi, struct sfs_direntry *d, unsigned nd)
+sfs_writedir(uint32_t ino, struct sfs_dinode *sfi,
+	     struct sfs_direntry *d, unsigned nd)
 {
 	const unsigned atonce = SFS_BLOCKSIZE/sizeof(struct sfs_direntry);
 	unsigned nblocks = SFS_ROUNDUP(nd, atonce) / atonce;
@@ -369,6 +451,20 @@ sfs_writedir(const struct sfs_dinode *sfi, struct sfs_direntry *d, unsigned nd)
 	struct sfs_direntry buffer[atonce];
 	uint32_t diskblock;
 
+	if (sfi->sfi_flags & SFS_DINODE_INLINE) {
+		char *inl = SFS_INLINEDATA(sfi);
+
+		assert(nd * sizeof(*d) <= SFS_INLINESIZE);
+		bzero(inl, SFS_INLINESIZE);
+		for (i=0; i<nd; i++) {
+			buffer[0] = d[i];
+			swapdir(&buffer[0]);
+			memcpy(inl + i*sizeof(*d), &buffer[0], sizeof(*d));
+		}
+		sfs_writeinode(ino, sfi);
+		return;
+	}
+
 	left = nd;
 	for (i=0; i<nblocks; i++) {
 		diskblock = bmap(sfi, i);
@@ -462,3 +558,30 @@ sfsdir_tryadd(struct sfs_direntry *d, int nd, const char *name, uint32_t ino)
 	}
 	return -1;
 }
+
+/*
+ * Start reading the inodes named in D (which has ND entries), other
+ * than . and .., since the caller is about to visit them in turn.
+ */
+void
+sfsdir_prefetch(const struct sfs_direntry *d, unsigned nd)
+{
+	uint32_t *inos;
+	unsigned i, n;
+
+	if (nd == 0) {
+		return;
+	}
+
+	inos = domalloc(nd * sizeof(inos[0]));
+	for (i=n=0; i<nd; i++) {
+		if (d[i].sfd_ino == SFS_NOINO ||
+		    !strcmp(d[i].sfd_name, ".") ||
+		    !strcmp(d[i].sfd_name, "..")) {
+			continue;
+		}
+		inos[n++] = d[i].sfd_ino;
+	}
+	ra_prefetch(inos, n);
+	free(inos);
+}
@@ -57,6 +57,10 @@ void sfs_writesb(uint32_t blocknum, struct sfs_superblock *sb);
 void sfs_readfreemapblock(uint32_t whichblock, uint8_t *bits);
 void sfs_writefreemapblock(uint32_t whichblock, uint8_t *bits);
 
+/* any block, without byte-swapping */
+void sfs_readrawblock(uint32_t blocknum, void *data);
+void sfs_writerawblock(uint32_t blocknum, void *data);
+
 /* inode */
 void sfs_readinode(uint32_t inum, struct sfs_dinode *sfi);
 void sfs_writeinode(uint32_t inum, struct sfs_dinode *sfi);
@@ -65,9 +69,13 @@ void sfs_writeinode(uint32_t inum, struct sfs_dinode *sfi);
 void sfs_readindirect(uint32_t blocknum, uint32_t *entries);
 void sfs_writeindirect(uint32_t blocknum, uint32_t *entries);
 
-/* directory - ND should be the number of directory entries D points to */
+/*
+ * directory - ND should be the number of directory entries D points to.
+ * INO is the directory's inode number; sfs_writedir writes the inode
+ * too if the directory is inline.
+ */
 void sfs_readdir(struct sfs_dinode *sfi, struct sfs_direntry *d, unsigned nd);
-void sfs_writedir(const struct sfs_dinode *sfi,
+void sfs_writedir(uint32_t ino, struct sfs_dinode *sfi,
 		  struct sfs_direntry *d, unsigned nd);
 
 /* Try to add an entry to a directory. */
@@ -77,5 +85,8 @@ int sfsdir_tryadd(struct sfs_direntry *d, int nd,
 /* Sort a directory by creating a permutation vector. */
 void sfsdir_sort(struct sfs_direntry *d, unsigned nd, int *vector);
 
+/* Read ahead the inodes a directory refers to. */
+void sfsdir_prefetch(const struct sfs_direntry *d, unsigned nd);
+
 
 #endif /* SFS_H */
@@ -0,0 +1,109 @@
+/*
+ * Reading kernel dump files; see dumpfile.h.
+ */
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#include "dumpfile.h"
+
+/*
+ * Grow BUF, which holds OLDLEN bytes, to NEWLEN bytes. (There's no
+ * realloc in OS/161's libc.)
+ */
+void *
+growbuf(void *buf, size_t oldlen, size_t newlen)
+{
+	void *p;
+
+	p = malloc(newlen);
+	if (p == NULL) {
+		errx(1, "Out of memory");
+	}
+	if (buf != NULL) {
+		memcpy(p, buf, oldlen);
+		free(buf);
+	}
+	return p;
+}
+
+/*
+ * Read all of FILE into memory.
+ */
+void *
+readfile(const char *file, size_t *lenret)
+{
+	char *buf = NULL;
+	size_t len = 0, max = 0;
+	ssize_t r;
+	int fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s", file);
+	}
+	while (1) {
+		if (len == max) {
+			max = max ? max * 2 : 65536;
+			buf = growbuf(buf, len, max);
+		}
+		r = read(fd, buf + len, max - len);
+		if (r < 0) {
+			err(1, "%s", file);
+		}
+		if (r == 0) {
+			break;
+		}
+		len += r;
+	}
+	close(fd);
+	*lenret = len;
+	return buf;
+}
+
+/*
+ * Read a dump file, whose header starts with MAGIC and VERSION, and
+ * check those. Returns the whole file. WHAT names the kind of dump
+ * for messages.
+ */
+void *
+readdump(const char *file, const char *what, uint32_t magic,
+	 uint32_t version, size_t headersize, size_t *lenret)
+{
+	uint32_t val;
+	char *buf;
+
+	buf = readfile(file, lenret);
+	if (*lenret < headersize) {
+		errx(1, "%s: Not a %s dump", file, what);
+	}
+	memcpy(&val, buf, sizeof(val));
+	if (SWAP32(val) != magic) {
+		errx(1, "%s: Not a %s dump", file, what);
+	}
+	memcpy(&val, buf + sizeof(val), sizeof(val));
+	if (SWAP32(val) != version) {
+		errx(1, "%s: Unsupported %s dump version %u", file, what,
+		     SWAP32(val));
+	}
+	return buf;
+}
+
+/*
+ * Find the COUNT records that follow the header in a dump file read
+ * by readdump, checking that they're all there.
+ */
+void *
+dumprecords(const char *file, void *buf, size_t len, size_t headersize,
+	    unsigned count, size_t recordsize)
+{
+	if (len < headersize + (uint64_t)count * recordsize) {
+		errx(1, "%s: Short file", file);
+	}
+	return (char *)buf + headersize;
+}
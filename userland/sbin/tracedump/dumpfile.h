@@ -0,0 +1,28 @@
+/*
+ * Reading the dump files the kernel's trace and prof commands write.
+ * Shared by tracedump and profdump.
+ */
+
+#ifndef DUMPFILE_H
+#define DUMPFILE_H
+
+#ifdef HOST
+/* The kernel is big-endian, so the network byte order functions fit. */
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "hostcompat.h"
+#define SWAP32(x) ntohl(x)
+#define SWAP16(x) ntohs(x)
+#else
+#define SWAP32(x) (x)
+#define SWAP16(x) (x)
+#endif
+
+void *growbuf(void *buf, size_t oldlen, size_t newlen);
+void *readfile(const char *file, size_t *lenret);
+void *readdump(const char *file, const char *what, uint32_t magic,
+	       uint32_t version, size_t headersize, size_t *lenret);
+void *dumprecords(const char *file, void *buf, size_t len,
+		  size_t headersize, unsigned count, size_t recordsize);
+
+#endif /* DUMPFILE_H */
@@ -0,0 +1,297 @@
+/*
+ * tracedump - print a kernel event trace as a timeline.
+ *
+ * Reads a file written by the kernel menu's "trace dump" command,
+ * merges the per-cpu records by time, and prints one line per event.
+ * Syscalls, disk I/O, and SFS I/O also get their duration printed on
+ * the line where they finish, and a thread's switch-in line shows how
+ * long it was off the cpu.
+ */
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#include <kern/trace.h>
+
+#include "dumpfile.h"
+
+/* Kinds of interval we time, per thread. */
+#define K_SYSCALL	0
+#define K_DISK		1
+#define K_SFS		2
+#define K_OFFCPU	3
+#define NKINDS		4
+
+struct threadinfo {
+	uint32_t thread;
+	bool started[NKINDS];
+	uint64_t start[NKINDS];
+};
+
+static struct threadinfo *threads;
+static unsigned nthreads, maxthreads;
+
+static struct trace_record *records;
+static unsigned nrecords, ncpus;
+
+static const char *const typenames[TRACE_NTYPES] = {
+	[TRACE_NONE] = "none",
+	[TRACE_SWITCH] = "switch",
+	[TRACE_SLEEP] = "sleep",
+	[TRACE_WAKE] = "wake",
+	[TRACE_FAULT] = "fault",
+	[TRACE_SYSCALL] = "syscall",
+	[TRACE_SYSRET] = "sysret",
+	[TRACE_DISKIO] = "disk",
+	[TRACE_DISKDONE] = "diskdone",
+	[TRACE_SFSIO] = "sfs",
+	[TRACE_SFSDONE] = "sfsdone",
+};
+
+/* Matches threadstate_t in the kernel's thread.h. */
+static const char *const statenames[] = {
+	"run", "ready", "sleep", "zombie",
+};
+
+static const char *const faultnames[] = {
+	"read", "write", "readonly",
+};
+
+////////////////////////////////////////////////////////////
+
+static
+void
+load(const char *file)
+{
+	struct trace_header *th;
+	struct trace_record *r;
+	unsigned i;
+	size_t len;
+
+	th = readdump(file, "kernel trace", TRACE_MAGIC, TRACE_VERSION,
+		      sizeof(*th), &len);
+	nrecords = SWAP32(th->th_nrecords);
+	records = dumprecords(file, th, len, sizeof(*th), nrecords,
+			      sizeof(*r));
+
+	for (i=0; i<nrecords; i++) {
+		r = &records[i];
+		r->tr_sec = SWAP32(r->tr_sec);
+		r->tr_nsec = SWAP32(r->tr_nsec);
+		r->tr_cpu = SWAP16(r->tr_cpu);
+		r->tr_type = SWAP16(r->tr_type);
+		r->tr_thread = SWAP32(r->tr_thread);
+		r->tr_arg0 = SWAP32(r->tr_arg0);
+		r->tr_arg1 = SWAP32(r->tr_arg1);
+	}
+
+	ncpus = SWAP32(th->th_ncpus);
+	printf("%u records from %u cpus\n", nrecords, ncpus);
+}
+
+static
+uint64_t
+timeof(const struct trace_record *r)
+{
+	return (uint64_t)r->tr_sec * 1000000000ULL + r->tr_nsec;
+}
+
+/*
+ * Find the record to print next: each cpu's records are in time order
+ * in the dump, so take the earliest of the cpus' next records. Ties go
+ * to the lower-numbered cpu. Returns NULL when all are used up.
+ */
+static
+struct trace_record *
+nextrecord(unsigned *pos, const unsigned *end)
+{
+	struct trace_record *best = NULL;
+	unsigned i, bestcpu = 0;
+
+	for (i=0; i<ncpus; i++) {
+		if (pos[i] == end[i]) {
+			continue;
+		}
+		if (best == NULL || timeof(&records[pos[i]]) < timeof(best)) {
+			best = &records[pos[i]];
+			bestcpu = i;
+		}
+	}
+	if (best != NULL) {
+		pos[bestcpu]++;
+	}
+	return best;
+}
+
+static
+struct threadinfo *
+getthread(uint32_t thread)
+{
+	unsigned i;
+
+	for (i=0; i<nthreads; i++) {
+		if (threads[i].thread == thread) {
+			return &threads[i];
+		}
+	}
+	if (nthreads == maxthreads) {
+		maxthreads = maxthreads ? maxthreads * 2 : 64;
+		threads = growbuf(threads, nthreads * sizeof(threads[0]),
+				  maxthreads * sizeof(threads[0]));
+	}
+	memset(&threads[nthreads], 0, sizeof(threads[0]));
+	threads[nthreads].thread = thread;
+	return &threads[nthreads++];
+}
+
+static
+void
+start(uint32_t thread, int kind, uint64_t now)
+{
+	struct threadinfo *ti = getthread(thread);
+
+	ti->started[kind] = true;
+	ti->start[kind] = now;
+}
+
+/*
+ * Print the time since START for THREAD and KIND, if there was one.
+ */
+static
+void
+finish(uint32_t thread, int kind, uint64_t now)
+{
+	struct threadinfo *ti = getthread(thread);
+
+	if (ti->started[kind]) {
+		printf("  [%llu us]",
+		       (unsigned long long)(now - ti->start[kind]) / 1000);
+		ti->started[kind] = false;
+	}
+}
+
+static
+void
+printsize(uint32_t arg, const char *unit)
+{
+	printf("%s %u %s", (arg & TRACE_WRITE) ? "write" : "read",
+	       arg & ~TRACE_WRITE, unit);
+}
+
+static
+void
+timeline(void)
+{
+	struct trace_record *r;
+	uint64_t t0 = 0, now;
+	unsigned *pos, *end;
+	unsigned i, cpu;
+	bool first = true;
+
+	/* Split the dump into each cpu's run of records. */
+	pos = malloc(ncpus * sizeof(pos[0]));
+	end = malloc(ncpus * sizeof(end[0]));
+	if (pos == NULL || end == NULL) {
+		errx(1, "Out of memory");
+	}
+	for (cpu=0, i=0; cpu<ncpus; cpu++) {
+		pos[cpu] = i;
+		while (i < nrecords && records[i].tr_cpu == cpu) {
+			i++;
+		}
+		end[cpu] = i;
+	}
+	if (i != nrecords) {
+		warnx("Records out of cpu order; ignoring %u of them",
+		      nrecords - i);
+	}
+
+	while ((r = nextrecord(pos, end)) != NULL) {
+		if (r->tr_type == TRACE_NONE || r->tr_type >= TRACE_NTYPES) {
+			continue;
+		}
+		now = timeof(r);
+		if (first) {
+			t0 = now;
+			first = false;
+		}
+		printf("%4llu.%09llu cpu%-2u %08x %-8s ",
+		       (unsigned long long)(now - t0) / 1000000000ULL,
+		       (unsigned long long)(now - t0) % 1000000000ULL,
+		       r->tr_cpu, r->tr_thread, typenames[r->tr_type]);
+
+		switch (r->tr_type) {
+		    case TRACE_SWITCH:
+			printf("%s -> %08x",
+			       r->tr_arg0 < 4 ? statenames[r->tr_arg0] : "?",
+			       r->tr_arg1);
+			start(r->tr_thread, K_OFFCPU, now);
+			finish(r->tr_arg1, K_OFFCPU, now);
+			break;
+		    case TRACE_SLEEP:
+			printf("on %08x", r->tr_arg0);
+			break;
+		    case TRACE_WAKE:
+			printf("%08x from %08x", r->tr_arg1, r->tr_arg0);
+			break;
+		    case TRACE_FAULT:
+			printf("%s 0x%08x",
+			       r->tr_arg0 < 3 ? faultnames[r->tr_arg0] : "?",
+			       r->tr_arg1);
+			break;
+		    case TRACE_SYSCALL:
+			printf("%u (0x%x)", r->tr_arg0, r->tr_arg1);
+			start(r->tr_thread, K_SYSCALL, now);
+			break;
+		    case TRACE_SYSRET:
+			printf("%u error %u", r->tr_arg0, r->tr_arg1);
+			finish(r->tr_thread, K_SYSCALL, now);
+			break;
+		    case TRACE_DISKIO:
+			printsize(r->tr_arg1, "sectors");
+			printf(" at %u", r->tr_arg0);
+			start(r->tr_thread, K_DISK, now);
+			break;
+		    case TRACE_DISKDONE:
+			printf("at %u error %u", r->tr_arg0, r->tr_arg1);
+			finish(r->tr_thread, K_DISK, now);
+			break;
+		    case TRACE_SFSIO:
+			printsize(r->tr_arg1, "bytes");
+			printf(" inode %u", r->tr_arg0);
+			start(r->tr_thread, K_SFS, now);
+			break;
+		    case TRACE_SFSDONE:
+			printf("inode %u error %u", r->tr_arg0, r->tr_arg1);
+			finish(r->tr_thread, K_SFS, now);
+			break;
+		}
+		printf("\n");
+	}
+
+	free(pos);
+	free(end);
+}
+
+int
+main(int argc, char **argv)
+{
+#ifdef HOST
+	hostcompat_init(argc, argv);
+#endif
+
+	if (argc != 2) {
+		errx(1, "Usage: tracedump dumpfile");
+	}
+
+	load(argv[1]);
+	timeline();
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * copyrangetest - check copy_file_range's count and file offsets.
+ *
+ * Copies from the middle of a file, then asks for more than is left
+ * so the copy comes up short at EOF, then copies at EOF. After each
+ * call both offsets must have moved by exactly the count returned,
+ * and the copied bytes must match the source.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+#include <test161/test161.h>
+
+#define SRCFILE "copyrange.src"
+#define DSTFILE "copyrange.dst"
+#define SIZE 20000
+
+static char buf[SIZE], check[SIZE];
+
+static
+off_t
+where(int fd)
+{
+	off_t pos;
+
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos == -1) {
+		err(1, "lseek");
+	}
+	return pos;
+}
+
+/*
+ * Copy LEN bytes and check that EXPECT were copied and that the
+ * offsets moved accordingly.
+ */
+static
+void
+copy(int in, int out, size_t len, ssize_t expect)
+{
+	off_t inpos, outpos;
+	ssize_t r;
+
+	inpos = where(in);
+	outpos = where(out);
+	r = copy_file_range(in, out, len);
+	if (r < 0) {
+		err(1, "copy_file_range");
+	}
+	if (r != expect) {
+		errx(1, "copy_file_range of %zu at %lld: copied %zd, "
+		     "expected %zd", len, inpos, r, expect);
+	}
+	if (where(in) != inpos + r) {
+		errx(1, "Source offset %lld after copying %zd from %lld",
+		     where(in), r, inpos);
+	}
+	if (where(out) != outpos + r) {
+		errx(1, "Destination offset %lld after copying %zd to %lld",
+		     where(out), r, outpos);
+	}
+	nprintf(".");
+}
+
+int
+main(void)
+{
+	int in, out, i;
+	ssize_t r;
+
+	for (i=0; i<SIZE; i++) {
+		buf[i] = 'a' + i % 23;
+	}
+
+	in = open(SRCFILE, O_RDWR|O_CREAT|O_TRUNC);
+	if (in < 0) {
+		err(1, "%s", SRCFILE);
+	}
+	r = write(in, buf, SIZE);
+	if (r != SIZE) {
+		err(1, "%s: write", SRCFILE);
+	}
+	out = open(DSTFILE, O_RDWR|O_CREAT|O_TRUNC);
+	if (out < 0) {
+		err(1, "%s", DSTFILE);
+	}
+
+	tprintf("Testing copy_file_range...\n");
+
+	/* from the middle */
+	if (lseek(in, 1000, SEEK_SET) == -1) {
+		err(1, "lseek");
+	}
+	copy(in, out, 5000, 5000);
+
+	/* more than is left: short, stopping at EOF */
+	copy(in, out, SIZE, SIZE - 6000);
+
+	/* at EOF */
+	copy(in, out, 100, 0);
+
+	if (lseek(out, 0, SEEK_SET) == -1) {
+		err(1, "lseek");
+	}
+	r = read(out, check, SIZE);
+	if (r != SIZE - 1000) {
+		errx(1, "%s: read %zd bytes, expected %d", DSTFILE, r,
+		     SIZE - 1000);
+	}
+	if (memcmp(check, buf + 1000, SIZE - 1000) != 0) {
+		errx(1, "%s: contents don't match", DSTFILE);
+	}
+	nprintf(".");
+
+	close(in);
+	close(out);
+	remove(SRCFILE);
+	remove(DSTFILE);
+
+	nprintf("\n");
+	success(TEST161_SUCCESS, SECRET, "/testbin/copyrangetest");
+	return 0;
+}
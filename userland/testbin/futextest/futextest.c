@@ -0,0 +1,83 @@
+/*
+ * futextest - futex_wait and futex_wake from a single thread.
+ *
+ * Checks the paths one thread can reach by itself: futex_wait on a
+ * value that has already changed returns EAGAIN without sleeping,
+ * futex_wake with nobody waiting wakes nobody, and bad arguments are
+ * rejected. Waking an actual sleeper needs a second thread sharing
+ * the address space, which the base system can't create.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <test161/test161.h>
+
+static volatile int word;
+
+/*
+ * Check that a call returned -1 with errno ERR.
+ */
+static
+void
+expect_err(const char *what, int r, int err)
+{
+	if (r != -1) {
+		errx(1, "%s: returned %d, expected an error", what, r);
+	}
+	if (errno != err) {
+		errx(1, "%s: got error %d (%s), expected %d (%s)", what,
+		     errno, strerror(errno), err, strerror(err));
+	}
+	nprintf(".");
+}
+
+int
+main(void)
+{
+	volatile int *misaligned;
+	int r;
+
+	tprintf("Testing futex_wait and futex_wake...\n");
+
+	/* The value has changed: don't sleep. */
+	word = 1;
+	r = futex_wait(&word, 0);
+	expect_err("futex_wait on a changed value", r, EAGAIN);
+	word = 2;
+	r = futex_wait(&word, 1);
+	expect_err("futex_wait on a changed value", r, EAGAIN);
+
+	/* Nobody is waiting: nobody is woken. */
+	r = futex_wake(&word, 1);
+	if (r != 0) {
+		errx(1, "futex_wake with no waiters: returned %d", r);
+	}
+	r = futex_wake(&word, 0);
+	if (r != 0) {
+		errx(1, "futex_wake of none: returned %d", r);
+	}
+	nprintf(".");
+
+	/* Bad arguments. */
+	misaligned = (volatile int *)((volatile char *)&word + 1);
+	r = futex_wait(misaligned, 2);
+	expect_err("futex_wait on a misaligned address", r, EINVAL);
+	r = futex_wake(misaligned, 1);
+	expect_err("futex_wake on a misaligned address", r, EINVAL);
+	r = futex_wake(&word, -1);
+	expect_err("futex_wake with a negative count", r, EINVAL);
+	r = futex_wait(NULL, 0);
+	expect_err("futex_wait on NULL", r, EFAULT);
+
+	/* The word itself is untouched. */
+	if (word != 2) {
+		errx(1, "futex calls changed the word to %d", word);
+	}
+
+	nprintf("\n");
+	success(TEST161_SUCCESS, SECRET, "/testbin/futextest");
+	return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * mtmalloctest - malloc and free from several user threads at once.
+ *
+ * Links with libmtmalloc. Each thread keeps a table of live blocks of
+ * assorted sizes, small ones that go through the per-thread caches
+ * and larger ones that go to the central heap, and replaces random
+ * entries over and over. Every block is filled with a byte unique to
+ * its thread and slot and checked before it is freed. A block handed
+ * out twice, or a free list broken by a race, shows up as a mismatch.
+ *
+ * Like userthreads, this needs user-level threads, created with
+ * threadfork(); the base system doesn't have them, so it isn't built
+ * by default.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <err.h>
+
+/* The user-level thread call userthreads assumes; see there. */
+void threadfork(void (*func)(void));
+
+#define NTHREADS	4
+#define NSLOTS		64
+#define NROUNDS		20000
+
+struct slot {
+	unsigned char *ptr;
+	size_t size;
+};
+
+static struct slot slots[NTHREADS][NSLOTS];
+static volatile int done[NTHREADS];
+
+static
+unsigned long
+nextrand(unsigned long *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 16) & 0x7fff;
+}
+
+static
+void
+check(unsigned me, unsigned i)
+{
+	struct slot *s = &slots[me][i];
+	unsigned char pat = me * NSLOTS + i;
+	size_t j;
+
+	for (j=0; j<s->size; j++) {
+		if (s->ptr[j] != pat) {
+			errx(1, "Thread %u: block %p (%zu bytes) clobbered "
+			     "at offset %zu", me, s->ptr, s->size, j);
+		}
+	}
+}
+
+static
+void
+worker(unsigned me)
+{
+	unsigned long seed = me + 1;
+	unsigned round, i;
+	struct slot *s;
+	size_t j;
+
+	for (round=0; round<NROUNDS; round++) {
+		i = nextrand(&seed) % NSLOTS;
+		s = &slots[me][i];
+		if (s->ptr != NULL) {
+			check(me, i);
+			free(s->ptr);
+			s->ptr = NULL;
+			continue;
+		}
+
+		/* mostly small blocks, some past the caches' range */
+		s->size = nextrand(&seed) % 16 == 0 ?
+			300 + nextrand(&seed) % 4000 :
+			1 + nextrand(&seed) % 256;
+		s->ptr = malloc(s->size);
+		if (s->ptr == NULL) {
+			errx(1, "Thread %u: malloc of %zu failed", me, s->size);
+		}
+		for (j=0; j<s->size; j++) {
+			s->ptr[j] = me * NSLOTS + i;
+		}
+	}
+
+	for (i=0; i<NSLOTS; i++) {
+		if (slots[me][i].ptr != NULL) {
+			check(me, i);
+			free(slots[me][i].ptr);
+		}
+	}
+	done[me] = 1;
+}
+
+/* threadfork takes no argument, so one entry point per thread */
+static void worker1(void) { worker(1); }
+static void worker2(void) { worker(2); }
+static void worker3(void) { worker(3); }
+
+int
+main(void)
+{
+	unsigned i;
+
+	threadfork(worker1);
+	threadfork(worker2);
+	threadfork(worker3);
+	worker(0);
+
+	for (i=0; i<NTHREADS; i++) {
+		while (!done[i]) {
+			/* spin */
+		}
+	}
+	tprintf("mtmalloctest: %d threads, %d rounds each: passed.\n",
+		NTHREADS, NROUNDS);
+	return 0;
+}
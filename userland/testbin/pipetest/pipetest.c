@@ -0,0 +1,136 @@
+/*
+ * pipetest - a pipe used from a single process.
+ *
+ * Writes through a pipe and reads the data back, enough times that
+ * the kernel's ring buffer wraps around; checks that each end refuses
+ * the other end's operation and that neither can seek; and checks EOF
+ * once the write end is closed and EPIPE once the read end is. Nothing
+ * here needs a second process, so each write is read back before the
+ * pipe could fill up.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <err.h>
+#include <test161/test161.h>
+
+#define CHUNK 300	/* not a divisor of the pipe size, so it wraps */
+#define ROUNDS 50
+
+static char wbuf[PIPE_BUF], rbuf[PIPE_BUF];
+
+/*
+ * Check that a call returned -1 with errno ERR.
+ */
+static
+void
+expect_err(const char *what, int r, int err)
+{
+	if (r != -1) {
+		errx(1, "%s: returned %d, expected an error", what, r);
+	}
+	if (errno != err) {
+		errx(1, "%s: got error %d (%s), expected %d (%s)", what,
+		     errno, strerror(errno), err, strerror(err));
+	}
+	nprintf(".");
+}
+
+static
+void
+makepipe(int fds[2])
+{
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+	if (fds[0] == fds[1]) {
+		errx(1, "pipe: both ends are fd %d", fds[0]);
+	}
+}
+
+/*
+ * Write LEN bytes of pattern SEED and read them back.
+ */
+static
+void
+roundtrip(int fds[2], size_t len, unsigned seed)
+{
+	ssize_t r;
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		wbuf[i] = (char)(seed + i * 7);
+	}
+	r = write(fds[1], wbuf, len);
+	if (r < 0) {
+		err(1, "write");
+	}
+	if ((size_t)r != len) {
+		errx(1, "write of %zu: wrote %zd", len, r);
+	}
+
+	/* ask for more than is there: a pipe read returns what it has */
+	r = read(fds[0], rbuf, sizeof(rbuf));
+	if (r < 0) {
+		err(1, "read");
+	}
+	if ((size_t)r != len) {
+		errx(1, "read after writing %zu: got %zd", len, r);
+	}
+	if (memcmp(wbuf, rbuf, len) != 0) {
+		errx(1, "read back different data");
+	}
+}
+
+int
+main(void)
+{
+	int fds[2];
+	unsigned i;
+	char c;
+
+	tprintf("Testing pipes...\n");
+
+	makepipe(fds);
+	roundtrip(fds, 5, 'a');
+	for (i=0; i<ROUNDS; i++) {
+		roundtrip(fds, CHUNK, i);
+	}
+	roundtrip(fds, PIPE_BUF, 0);
+	nprintf(".");
+
+	/* Each end is one-way, and neither seeks. */
+	expect_err("write on the read end", write(fds[0], "x", 1), EBADF);
+	expect_err("read on the write end", read(fds[1], &c, 1), EBADF);
+	expect_err("lseek on the read end",
+		   (int)lseek(fds[0], 0, SEEK_SET), ESPIPE);
+	expect_err("lseek on the write end",
+		   (int)lseek(fds[1], 0, SEEK_SET), ESPIPE);
+
+	/* With the write end gone, what's left is read, then EOF. */
+	if (write(fds[1], "xy", 2) != 2) {
+		err(1, "write");
+	}
+	close(fds[1]);
+	if (read(fds[0], rbuf, sizeof(rbuf)) != 2) {
+		errx(1, "read after close of the write end: data lost");
+	}
+	if (read(fds[0], rbuf, sizeof(rbuf)) != 0) {
+		errx(1, "read after close of the write end: no EOF");
+	}
+	close(fds[0]);
+	nprintf(".");
+
+	/* With the read end gone, writes fail. */
+	makepipe(fds);
+	close(fds[0]);
+	expect_err("write with no reader", write(fds[1], "x", 1), EPIPE);
+	close(fds[1]);
+
+	nprintf("\n");
+	success(TEST161_SUCCESS, SECRET, "/testbin/pipetest");
+	return 0;
+}
@@ -382,6 +382,9 @@ conctest(void)
 int
 main(void)
 {
+	/* say() wants each character written as it goes */
+	setvbuf(stdout, NULL, _IONBF, 0);
+
 	basetest();
 	conctest();
 	say("Passed.\n");